@@ -27,12 +27,14 @@
 #include "config.h"
 #endif
 #include "gstsctpdec.h"
+#include "gstsctpstats.h"
 
 #include <gst/sctp/sctpreceivemeta.h>
 #include <gst/base/gstdataqueue.h>
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 GST_DEBUG_CATEGORY_STATIC(gst_sctp_dec_debug_category);
 #define GST_CAT_DEFAULT gst_sctp_dec_debug_category
@@ -58,6 +60,13 @@ enum {
 
     PROP_GST_SCTP_ASSOCIATION_ID,
     PROP_LOCAL_SCTP_PORT,
+    PROP_MAX_SIZE_BYTES,
+    PROP_MAX_SIZE_BUFFERS,
+    PROP_WORKER_THREADS,
+    PROP_PARTIAL_DELIVERY,
+    PROP_VERIFY_CHECKSUM,
+    PROP_STATS,
+    PROP_STATS_INTERVAL,
 
     NUM_PROPERTIES
 };
@@ -69,6 +78,15 @@ static GParamSpec *properties[NUM_PROPERTIES];
 #define MAX_SCTP_PORT 65535
 #define MAX_GST_SCTP_ASSOCIATION_ID 65535
 #define MAX_STREAM_ID 65535
+#define DEFAULT_MAX_SIZE_BYTES (2 * 1024 * 1024)
+#define DEFAULT_MAX_SIZE_BUFFERS 0
+#define DEFAULT_WORKER_THREADS 0
+#define DEFAULT_PARTIAL_DELIVERY FALSE
+#define DEFAULT_VERIFY_CHECKSUM TRUE
+#define MAX_WORKER_THREADS 1024
+/* Items a worker pushes from one pad before moving on to the next scheduled pad */
+#define WORKER_BATCH_SIZE 16
+#define SRC_PADS_CHUNK_SIZE 256
 
 GType gst_sctp_dec_pad_get_type(void);
 
@@ -84,7 +102,21 @@ typedef GstPadClass GstSctpDecPadClass;
 struct _GstSctpDecPad {
     GstPad parent;
 
+    guint16 stream_id;
     GstDataQueue *packet_queue;
+    /* Set while the queue is above the limits and reading from the association is paused
+     * on its behalf, protected by the pad's object lock */
+    gboolean full;
+
+    /* Not owned, NULL when the pad runs its own streaming task */
+    GThreadPool *worker_pool;
+    /* Set while the pad is queued on or serviced by the worker pool, protected by the
+     * pad's object lock */
+    gboolean scheduled;
+
+    /* Statistics, protected by the pad's object lock */
+    guint64 bytes_received;
+    guint64 messages_received;
 };
 
 G_DEFINE_TYPE(GstSctpDecPad, gst_sctp_dec_pad, GST_TYPE_PAD);
@@ -100,7 +132,8 @@ static void gst_sctp_dec_pad_finalize(GObject *object)
 
 static gboolean data_queue_check_full_cb(GstDataQueue *queue, guint visible, guint bytes, guint64 time, gpointer user_data)
 {
-    /* FIXME: Are we full at some point and block? */
+    /* Pushing happens on the usrsctp thread and must never block. The limits are enforced
+     * by pausing the association instead, see update_queue_full_state() */
     return FALSE;
 }
 
@@ -125,8 +158,12 @@ static void gst_sctp_dec_pad_init(GstSctpDecPad *self)
 {
     self->packet_queue = gst_data_queue_new(data_queue_check_full_cb,
         data_queue_full_cb, data_queue_empty_cb, NULL);
+    self->full = FALSE;
+    self->worker_pool = NULL;
+    self->scheduled = FALSE;
 }
 
+static void gst_sctp_dec_finalize(GObject *object);
 static void gst_sctp_dec_set_property(GObject *object, guint prop_id, const GValue *value,
     GParamSpec *pspec);
 static void gst_sctp_dec_get_property(GObject *object, guint prop_id, GValue *value,
@@ -136,18 +173,29 @@ static GstStateChangeReturn gst_sctp_dec_change_state(GstElement *element,
 static GstFlowReturn gst_sctp_dec_packet_chain(GstPad *pad, GstSctpDec *self, GstBuffer *buf);
 static gboolean gst_sctp_dec_packet_event(GstPad *pad, GstSctpDec *self, GstEvent *event);
 static void gst_sctp_data_srcpad_loop(GstPad *pad);
+static gboolean push_queued_item(GstSctpDec *self, GstSctpDecPad *sctpdec_pad);
+static void start_srcpad_task(GstPad *pad);
+static void schedule_srcpad(GstSctpDecPad *sctpdec_pad);
+static void srcpad_worker_func(GstSctpDecPad *sctpdec_pad, GstSctpDec *self);
 
 static gboolean configure_association(GstSctpDec *self);
 static void on_gst_sctp_association_stream_reset(GstSctpAssociation *gst_sctp_association, guint16 stream_id,
     GstSctpDec *self);
 static void on_receive(GstSctpAssociation *gst_sctp_association, guint8 *buf, gsize length,
-    guint16 stream_id, guint ppid, gpointer user_data);
-static void stop_srcpad_task(GstPad *pad);
+    guint16 stream_id, guint ppid, GstSctpAssociationMessageFlags flags, gpointer user_data);
+static void stop_srcpad_task(GstPad *pad, GstSctpDec *self);
 static void stop_all_srcpad_tasks(GstSctpDec *self);
 static void sctpdec_cleanup(GstSctpDec *self);
 static GstPad *get_pad_for_stream_id(GstSctpDec *self, guint16 stream_id);
+static GstPad *lookup_src_pad(GstSctpDec *self, guint16 stream_id);
+static void store_src_pad(GstSctpDec *self, guint16 stream_id, GstPad *pad);
+static void clear_src_pads(GstSctpDec *self);
+static void free_retired_src_pads(GstSctpDec *self);
 static void remove_pad(GstElement *element, GstPad *pad);
 static void on_reset_stream(GstSctpDec *self, guint stream_id);
+static void update_queue_full_state(GstSctpDec *self, GstSctpDecPad *sctpdec_pad);
+static void update_worker_pool_size(GstSctpDec *self);
+static GstStructure *get_stats(GstSctpDec *self);
 
 static void gst_sctp_dec_class_init(GstSctpDecClass *klass)
 {
@@ -163,6 +211,7 @@ static void gst_sctp_dec_class_init(GstSctpDecClass *klass)
     gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&src_template));
     gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&sink_template));
 
+    gobject_class->finalize = gst_sctp_dec_finalize;
     gobject_class->set_property = gst_sctp_dec_set_property;
     gobject_class->get_property = gst_sctp_dec_get_property;
 
@@ -186,6 +235,71 @@ static void gst_sctp_dec_class_init(GstSctpDecClass *klass)
             0, MAX_SCTP_PORT, DEFAULT_LOCAL_SCTP_PORT,
             G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
+    properties[PROP_MAX_SIZE_BYTES] =
+        g_param_spec_uint("max-size-bytes",
+            "Max size bytes",
+            "Max number of bytes queued per source pad before reading from the SCTP association "
+            "is paused, letting the receive window close (0 = unlimited). Reading is paused for "
+            "the whole association, so one full pad also holds back the other streams and "
+            "association notifications until it drains.",
+            0, G_MAXUINT, DEFAULT_MAX_SIZE_BYTES,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_MAX_SIZE_BUFFERS] =
+        g_param_spec_uint("max-size-buffers",
+            "Max size buffers",
+            "Max number of messages queued per source pad before reading from the SCTP association "
+            "is paused, letting the receive window close (0 = unlimited). Reading is paused for "
+            "the whole association, so one full pad also holds back the other streams and "
+            "association notifications until it drains.",
+            0, G_MAXUINT, DEFAULT_MAX_SIZE_BUFFERS,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_WORKER_THREADS] =
+        g_param_spec_uint("worker-threads",
+            "Worker threads",
+            "Number of threads shared by all source pads for pushing data downstream in "
+            "PLAYING. 0 gives every source pad its own streaming thread. Until PLAYING there "
+            "is a thread per source pad so that every stream can preroll. A push that blocks "
+            "downstream, on a full queue or a sink waiting for the clock, holds its thread "
+            "and delays the other pads until it returns. Takes effect on the next READY to "
+            "PAUSED transition.",
+            0, MAX_WORKER_THREADS, DEFAULT_WORKER_THREADS,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_PARTIAL_DELIVERY] =
+        g_param_spec_boolean("partial-delivery",
+            "Partial delivery",
+            "Push large messages downstream in parts as they arrive instead of reassembling "
+            "them first. The begin and end of each message are flagged in the GstSctpReceiveMeta. "
+            "This value must be set before any pads are requested.",
+            DEFAULT_PARTIAL_DELIVERY,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_VERIFY_CHECKSUM] =
+        g_param_spec_boolean("verify-checksum",
+            "Verify checksum",
+            "Drop incoming packets with a bad CRC32c checksum. Can be disabled when a secure "
+            "transport upstream, such as DTLS, already checks their integrity.",
+            DEFAULT_VERIFY_CHECKSUM,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_STATS] =
+        g_param_spec_boxed("stats",
+            "Statistics",
+            "Transport statistics of the association, with the per stream statistics of the "
+            "source pads in its \"streams\" array.",
+            GST_TYPE_STRUCTURE,
+            G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_STATS_INTERVAL] =
+        g_param_spec_uint("stats-interval",
+            "Statistics interval",
+            "Post the statistics as an element message this often, in milliseconds "
+            "(0 = never). Applied when the element starts.",
+            0, G_MAXUINT, 0,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
     g_object_class_install_properties(gobject_class, NUM_PROPERTIES, properties);
 
     signals[SIGNAL_RESET_STREAM] = g_signal_new("reset-stream",
@@ -204,6 +318,20 @@ static void gst_sctp_dec_init(GstSctpDec *self)
 {
     self->sctp_association_id = DEFAULT_GST_SCTP_ASSOCIATION_ID;
     self->local_sctp_port = DEFAULT_LOCAL_SCTP_PORT;
+    self->max_size_bytes = DEFAULT_MAX_SIZE_BYTES;
+    self->max_size_buffers = DEFAULT_MAX_SIZE_BUFFERS;
+    self->worker_threads = DEFAULT_WORKER_THREADS;
+    self->partial_delivery = DEFAULT_PARTIAL_DELIVERY;
+    self->verify_checksum = DEFAULT_VERIFY_CHECKSUM;
+    self->stats_interval = 0;
+    self->stats_clock_id = NULL;
+    self->worker_pool = NULL;
+    self->worker_pool_size = 0;
+    self->playing = FALSE;
+
+    g_mutex_init(&self->src_pads_lock);
+    memset(self->src_pads, 0, sizeof(self->src_pads));
+    self->retired_src_pads = gst_atomic_queue_new(16);
 
     self->sink_pad = gst_pad_new_from_static_template(&sink_template, "sink");
     gst_pad_set_chain_function(self->sink_pad,
@@ -214,6 +342,21 @@ static void gst_sctp_dec_init(GstSctpDec *self)
     gst_element_add_pad(GST_ELEMENT(self), self->sink_pad);
 }
 
+static void gst_sctp_dec_finalize(GObject *object)
+{
+    GstSctpDec *self = GST_SCTP_DEC(object);
+    guint i;
+
+    clear_src_pads(self);
+    free_retired_src_pads(self);
+    for (i = 0; i < G_N_ELEMENTS(self->src_pads); i++)
+        g_free(self->src_pads[i]);
+    gst_atomic_queue_unref(self->retired_src_pads);
+    g_mutex_clear(&self->src_pads_lock);
+
+    G_OBJECT_CLASS(parent_class)->finalize(object);
+}
+
 static void gst_sctp_dec_set_property(GObject *object, guint prop_id, const GValue *value,
     GParamSpec *pspec)
 {
@@ -226,6 +369,24 @@ static void gst_sctp_dec_set_property(GObject *object, guint prop_id, const GVal
     case PROP_LOCAL_SCTP_PORT:
         self->local_sctp_port = g_value_get_uint(value);
         break;
+    case PROP_MAX_SIZE_BYTES:
+        self->max_size_bytes = g_value_get_uint(value);
+        break;
+    case PROP_MAX_SIZE_BUFFERS:
+        self->max_size_buffers = g_value_get_uint(value);
+        break;
+    case PROP_WORKER_THREADS:
+        self->worker_threads = g_value_get_uint(value);
+        break;
+    case PROP_PARTIAL_DELIVERY:
+        self->partial_delivery = g_value_get_boolean(value);
+        break;
+    case PROP_VERIFY_CHECKSUM:
+        self->verify_checksum = g_value_get_boolean(value);
+        break;
+    case PROP_STATS_INTERVAL:
+        self->stats_interval = g_value_get_uint(value);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(self, prop_id, pspec);
         break;
@@ -244,6 +405,27 @@ static void gst_sctp_dec_get_property(GObject *object, guint prop_id, GValue *va
     case PROP_LOCAL_SCTP_PORT:
         g_value_set_uint(value, self->local_sctp_port);
         break;
+    case PROP_MAX_SIZE_BYTES:
+        g_value_set_uint(value, self->max_size_bytes);
+        break;
+    case PROP_MAX_SIZE_BUFFERS:
+        g_value_set_uint(value, self->max_size_buffers);
+        break;
+    case PROP_WORKER_THREADS:
+        g_value_set_uint(value, self->worker_threads);
+        break;
+    case PROP_PARTIAL_DELIVERY:
+        g_value_set_boolean(value, self->partial_delivery);
+        break;
+    case PROP_VERIFY_CHECKSUM:
+        g_value_set_boolean(value, self->verify_checksum);
+        break;
+    case PROP_STATS:
+        g_value_take_boxed(value, get_stats(self));
+        break;
+    case PROP_STATS_INTERVAL:
+        g_value_set_uint(value, self->stats_interval);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(self, prop_id, pspec);
         break;
@@ -261,6 +443,13 @@ static GstStateChangeReturn gst_sctp_dec_change_state(GstElement *element,
         if (!configure_association(self))
             return GST_STATE_CHANGE_FAILURE;
         break;
+    case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
+        /* Sinks preroll again, so every pad needs a worker of its own again */
+        GST_OBJECT_LOCK(self);
+        self->playing = FALSE;
+        GST_OBJECT_UNLOCK(self);
+        update_worker_pool_size(self);
+        break;
     default:
         break;
     }
@@ -270,6 +459,12 @@ static GstStateChangeReturn gst_sctp_dec_change_state(GstElement *element,
         return ret;
 
     switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
+        GST_OBJECT_LOCK(self);
+        self->playing = TRUE;
+        GST_OBJECT_UNLOCK(self);
+        update_worker_pool_size(self);
+        break;
     case GST_STATE_CHANGE_PAUSED_TO_READY:
         sctpdec_cleanup(self);
         break;
@@ -298,18 +493,18 @@ static GstFlowReturn gst_sctp_dec_packet_chain(GstPad * pad, GstSctpDec *self, G
     return GST_FLOW_OK;
 }
 
-static void flush_srcpad(const GValue *item, gpointer user_data)
+static void flush_srcpad_start(const GValue *item, gpointer user_data)
 {
     GstSctpDecPad *sctpdec_pad = g_value_get_object(item);
-    gboolean flush = GPOINTER_TO_INT(user_data);
 
-    if (flush) {
-        gst_data_queue_set_flushing(sctpdec_pad->packet_queue, TRUE);
-        gst_data_queue_flush(sctpdec_pad->packet_queue);
-    } else {
-        gst_data_queue_set_flushing(sctpdec_pad->packet_queue, FALSE);
-        gst_pad_start_task(GST_PAD(sctpdec_pad), (GstTaskFunction)gst_sctp_data_srcpad_loop, sctpdec_pad, NULL);
-    }
+    gst_data_queue_set_flushing(sctpdec_pad->packet_queue, TRUE);
+    gst_data_queue_flush(sctpdec_pad->packet_queue);
+    update_queue_full_state(GST_SCTP_DEC(user_data), sctpdec_pad);
+}
+
+static void flush_srcpad_stop(const GValue *item, gpointer user_data)
+{
+    start_srcpad_task(g_value_get_object(item));
 }
 
 static gboolean gst_sctp_dec_packet_event(GstPad *pad, GstSctpDec *self, GstEvent *event)
@@ -329,7 +524,7 @@ static gboolean gst_sctp_dec_packet_event(GstPad *pad, GstSctpDec *self, GstEven
         GstIterator *it;
 
         it = gst_element_iterate_src_pads(GST_ELEMENT(self));
-        while (gst_iterator_foreach(it, flush_srcpad, GINT_TO_POINTER(TRUE)) == GST_ITERATOR_RESYNC)
+        while (gst_iterator_foreach(it, flush_srcpad_start, self) == GST_ITERATOR_RESYNC)
             gst_iterator_resync(it);
         gst_iterator_free(it);
 
@@ -339,7 +534,7 @@ static gboolean gst_sctp_dec_packet_event(GstPad *pad, GstSctpDec *self, GstEven
         GstIterator *it;
 
         it = gst_element_iterate_src_pads(GST_ELEMENT(self));
-        while (gst_iterator_foreach(it, flush_srcpad, GINT_TO_POINTER(FALSE)) == GST_ITERATOR_RESYNC)
+        while (gst_iterator_foreach(it, flush_srcpad_stop, self) == GST_ITERATOR_RESYNC)
             gst_iterator_resync(it);
         gst_iterator_free(it);
 
@@ -352,32 +547,110 @@ static gboolean gst_sctp_dec_packet_event(GstPad *pad, GstSctpDec *self, GstEven
 
 static void gst_sctp_data_srcpad_loop(GstPad *pad)
 {
-    GstSctpDecPad *sctpdec_pad = GST_SCTP_DEC_PAD(pad);
+    if (!push_queued_item(GST_SCTP_DEC(GST_PAD_PARENT(pad)), GST_SCTP_DEC_PAD(pad)))
+        gst_pad_pause_task(pad);
+}
+
+/* Pops one item off the pad's queue and pushes it downstream. Returns FALSE when the
+ * queue is flushing or the push failed, in which case the queue has been flushed. */
+static gboolean push_queued_item(GstSctpDec *self, GstSctpDecPad *sctpdec_pad)
+{
+    GstPad *pad = GST_PAD(sctpdec_pad);
     GstDataQueueItem *item;
+    GstFlowReturn flow_ret;
+
+    if (!gst_data_queue_pop(sctpdec_pad->packet_queue, &item)) {
+        GST_DEBUG_OBJECT(pad, "Stopping because we're flushing");
+        return FALSE;
+    }
 
-    if (gst_data_queue_pop(sctpdec_pad->packet_queue, &item)) {
-        GstFlowReturn flow_ret;
+    update_queue_full_state(self, sctpdec_pad);
 
-        flow_ret = gst_pad_push(pad, GST_BUFFER(item->object));
-        item->object = NULL;
-        if (G_UNLIKELY(flow_ret == GST_FLOW_FLUSHING || flow_ret == GST_FLOW_NOT_LINKED)) {
-            GST_DEBUG_OBJECT(pad, "Push failed on packet source pad. Error: %s", gst_flow_get_name(flow_ret));
-        } else if (G_UNLIKELY(flow_ret != GST_FLOW_OK)) {
-            GST_ERROR_OBJECT(pad, "Push failed on packet source pad. Error: %s", gst_flow_get_name(flow_ret));
-        }
+    flow_ret = gst_pad_push(pad, GST_BUFFER(item->object));
+    item->object = NULL;
+    if (G_UNLIKELY(flow_ret == GST_FLOW_FLUSHING || flow_ret == GST_FLOW_NOT_LINKED)) {
+        GST_DEBUG_OBJECT(pad, "Push failed on packet source pad. Error: %s", gst_flow_get_name(flow_ret));
+    } else if (G_UNLIKELY(flow_ret != GST_FLOW_OK)) {
+        GST_ERROR_OBJECT(pad, "Push failed on packet source pad. Error: %s", gst_flow_get_name(flow_ret));
+    }
 
-        if (G_UNLIKELY(flow_ret != GST_FLOW_OK)) {
-            GST_DEBUG_OBJECT(pad, "Pausing task because of an error");
-            gst_data_queue_set_flushing(sctpdec_pad->packet_queue, TRUE);
-            gst_data_queue_flush(sctpdec_pad->packet_queue);
-            gst_pad_pause_task(pad);
-        }
+    item->destroy(item);
 
-        item->destroy(item);
-    } else {
-        GST_DEBUG_OBJECT(pad, "Pausing task because we're flushing");
-        gst_pad_pause_task(pad);
+    if (G_UNLIKELY(flow_ret != GST_FLOW_OK)) {
+        GST_DEBUG_OBJECT(pad, "Stopping because of an error");
+        gst_data_queue_set_flushing(sctpdec_pad->packet_queue, TRUE);
+        gst_data_queue_flush(sctpdec_pad->packet_queue);
+        update_queue_full_state(self, sctpdec_pad);
+        return FALSE;
     }
+
+    return TRUE;
+}
+
+static void start_srcpad_task(GstPad *pad)
+{
+    GstSctpDecPad *sctpdec_pad = GST_SCTP_DEC_PAD(pad);
+
+    gst_data_queue_set_flushing(sctpdec_pad->packet_queue, FALSE);
+    if (sctpdec_pad->worker_pool)
+        schedule_srcpad(sctpdec_pad);
+    else
+        gst_pad_start_task(pad, (GstTaskFunction)gst_sctp_data_srcpad_loop, pad, NULL);
+}
+
+/* Hands the pad to the worker pool if it has queued data and is not already scheduled.
+ * A pad is serviced by one worker at a time, which keeps the order within the stream. */
+static void schedule_srcpad(GstSctpDecPad *sctpdec_pad)
+{
+    gboolean schedule = FALSE;
+
+    GST_OBJECT_LOCK(sctpdec_pad);
+    if (!sctpdec_pad->scheduled && !gst_data_queue_is_empty(sctpdec_pad->packet_queue)) {
+        sctpdec_pad->scheduled = TRUE;
+        schedule = TRUE;
+    }
+    GST_OBJECT_UNLOCK(sctpdec_pad);
+
+    if (schedule)
+        g_thread_pool_push(sctpdec_pad->worker_pool, gst_object_ref(sctpdec_pad), NULL);
+}
+
+static void srcpad_worker_func(GstSctpDecPad *sctpdec_pad, GstSctpDec *self)
+{
+    guint i;
+
+    for (i = 0; i < WORKER_BATCH_SIZE && !gst_data_queue_is_empty(sctpdec_pad->packet_queue); i++) {
+        if (!push_queued_item(self, sctpdec_pad))
+            break;
+    }
+
+    /* Go to the back of the line if there is more, so that busy streams do not starve
+     * the others */
+    GST_OBJECT_LOCK(sctpdec_pad);
+    sctpdec_pad->scheduled = FALSE;
+    GST_OBJECT_UNLOCK(sctpdec_pad);
+    schedule_srcpad(sctpdec_pad);
+
+    gst_object_unref(sctpdec_pad);
+}
+
+/* A push blocks while its sink prerolls, which would hold a worker for as long as the
+ * pipeline is not PLAYING. Until then every source pad gets a worker, so that all streams
+ * can preroll, and in PLAYING the pool shrinks back to worker-threads. */
+static void update_worker_pool_size(GstSctpDec *self)
+{
+    guint max_threads;
+
+    if (!self->worker_pool)
+        return;
+
+    GST_OBJECT_LOCK(self);
+    max_threads = self->worker_pool_size;
+    if (!self->playing)
+        max_threads = MAX(max_threads, (guint)GST_ELEMENT(self)->numsrcpads);
+    GST_OBJECT_UNLOCK(self);
+
+    g_thread_pool_set_max_threads(self->worker_pool, (gint)max_threads, NULL);
 }
 
 static gboolean configure_association(GstSctpDec *self)
@@ -402,8 +675,25 @@ static gboolean configure_association(GstSctpDec *self)
     g_object_bind_property(self, "local-sctp-port", self->sctp_association, "local-port",
         G_BINDING_SYNC_CREATE);
 
+    g_object_bind_property(self, "partial-delivery", self->sctp_association, "partial-delivery",
+        G_BINDING_SYNC_CREATE);
+
+    g_object_bind_property(self, "verify-checksum", self->sctp_association, "verify-checksum",
+        G_BINDING_SYNC_CREATE);
+
+    if (self->worker_threads > 0) {
+        GST_OBJECT_LOCK(self);
+        self->worker_pool_size = self->worker_threads;
+        GST_OBJECT_UNLOCK(self);
+        self->worker_pool = g_thread_pool_new((GFunc)srcpad_worker_func, self,
+            (gint)self->worker_threads, FALSE, NULL);
+    }
+
     gst_sctp_association_set_on_packet_received(self->sctp_association, on_receive, self);
 
+    if (self->stats_interval > 0)
+        self->stats_clock_id = gst_sctp_stats_start_periodic(GST_ELEMENT(self), self->stats_interval);
+
     return TRUE;
 }
 
@@ -412,11 +702,8 @@ static gboolean gst_sctp_dec_src_event(GstPad *pad, GstSctpDec *self, GstEvent *
     switch (GST_EVENT_TYPE(event)) {
         case GST_EVENT_RECONFIGURE:
         case GST_EVENT_FLUSH_STOP: {
-            GstSctpDecPad *sctpdec_pad = GST_SCTP_DEC_PAD(pad);
-
             /* Unflush and start task again */
-            gst_data_queue_set_flushing(sctpdec_pad->packet_queue, FALSE);
-            gst_pad_start_task(pad, (GstTaskFunction)gst_sctp_data_srcpad_loop, pad, NULL);
+            start_srcpad_task(pad);
 
             return gst_pad_event_default(pad, GST_OBJECT(self), event);
         }
@@ -425,6 +712,7 @@ static gboolean gst_sctp_dec_src_event(GstPad *pad, GstSctpDec *self, GstEvent *
 
             gst_data_queue_set_flushing(sctpdec_pad->packet_queue, TRUE);
             gst_data_queue_flush(sctpdec_pad->packet_queue);
+            update_queue_full_state(self, sctpdec_pad);
 
             return gst_pad_event_default(pad, GST_OBJECT(self), event);
         }
@@ -453,9 +741,9 @@ gst_sctp_dec_src_activate_mode (GstPad * pad, GstObject * parent,
   switch (mode) {
     case GST_PAD_MODE_PUSH:
       if (active) {
-        gst_pad_start_task(pad, (GstTaskFunction)gst_sctp_data_srcpad_loop, pad, NULL);
+        start_srcpad_task(pad);
       } else {
-        stop_srcpad_task (pad);
+        stop_srcpad_task (pad, self);
       }
       ret = TRUE;
       GST_DEBUG_OBJECT (self, "activate_mode: active %d, ret %d", active, ret);
@@ -467,6 +755,62 @@ gst_sctp_dec_src_activate_mode (GstPad * pad, GstObject * parent,
   return ret;
 }
 
+/* The stream id to pad table is two levels of SRC_PADS_CHUNK_SIZE entries. Chunks are
+ * allocated on first use and live as long as the element. Writers hold src_pads_lock,
+ * the receive path reads without locking. The table holds a reference to each pad. */
+static GstPad *lookup_src_pad(GstSctpDec *self, guint16 stream_id)
+{
+    GstPad **chunk;
+
+    chunk = g_atomic_pointer_get(&self->src_pads[stream_id / SRC_PADS_CHUNK_SIZE]);
+    if (!chunk)
+        return NULL;
+    return g_atomic_pointer_get(&chunk[stream_id % SRC_PADS_CHUNK_SIZE]);
+}
+
+/* Must be called with src_pads_lock held */
+static void store_src_pad(GstSctpDec *self, guint16 stream_id, GstPad *pad)
+{
+    GstPad **chunk;
+
+    chunk = self->src_pads[stream_id / SRC_PADS_CHUNK_SIZE];
+    if (!chunk) {
+        chunk = g_new0(GstPad *, SRC_PADS_CHUNK_SIZE);
+        g_atomic_pointer_set(&self->src_pads[stream_id / SRC_PADS_CHUNK_SIZE], chunk);
+    }
+    g_atomic_pointer_set(&chunk[stream_id % SRC_PADS_CHUNK_SIZE], pad);
+}
+
+/* Only called when no data can be received anymore */
+static void clear_src_pads(GstSctpDec *self)
+{
+    guint i, j;
+
+    g_mutex_lock(&self->src_pads_lock);
+    for (i = 0; i < G_N_ELEMENTS(self->src_pads); i++) {
+        if (!self->src_pads[i])
+            continue;
+        for (j = 0; j < SRC_PADS_CHUNK_SIZE; j++) {
+            if (self->src_pads[i][j]) {
+                gst_object_unref(self->src_pads[i][j]);
+                self->src_pads[i][j] = NULL;
+            }
+        }
+    }
+    g_mutex_unlock(&self->src_pads_lock);
+}
+
+/* Pads taken out of the table may still be in use by the receive path, so their table
+ * reference is dropped from there, or once receiving has stopped */
+static void free_retired_src_pads(GstSctpDec *self)
+{
+    GstPad *pad;
+
+    while ((pad = gst_atomic_queue_pop(self->retired_src_pads)))
+        gst_object_unref(pad);
+}
+
+/* Returns a pointer borrowed from the stream id table */
 static GstPad *get_pad_for_stream_id(GstSctpDec *self, guint16 stream_id)
 {
     GstPad *new_pad = NULL;
@@ -474,10 +818,11 @@ static GstPad *get_pad_for_stream_id(GstSctpDec *self, guint16 stream_id)
     gchar *pad_name, *pad_stream_id;
     GstPadTemplate *template;
 
+    new_pad = lookup_src_pad(self, stream_id);
+    if (G_LIKELY(new_pad))
+        return new_pad;
+
     pad_name = g_strdup_printf("src_%hu", stream_id);
-    new_pad = gst_element_get_static_pad(GST_ELEMENT(self), pad_name);
-    if (new_pad)
-        goto out;
 
     g_object_get(self->sctp_association, "state", &state, NULL);
 
@@ -494,6 +839,8 @@ static GstPad *get_pad_for_stream_id(GstSctpDec *self, guint16 stream_id)
         "direction", template->direction, "template", template, NULL);
     gst_object_unref(template);
 
+    GST_SCTP_DEC_PAD(new_pad)->stream_id = stream_id;
+    GST_SCTP_DEC_PAD(new_pad)->worker_pool = self->worker_pool;
     gst_pad_set_event_function(new_pad, GST_DEBUG_FUNCPTR((GstPadEventFunction) gst_sctp_dec_src_event));
     gst_pad_set_activatemode_function (new_pad, GST_DEBUG_FUNCPTR (gst_sctp_dec_src_activate_mode));
 
@@ -509,7 +856,11 @@ static GstPad *get_pad_for_stream_id(GstSctpDec *self, guint16 stream_id)
     if (!gst_element_add_pad(GST_ELEMENT(self), new_pad))
         goto error_cleanup_pad;
 
-    gst_object_ref(new_pad);
+    g_mutex_lock(&self->src_pads_lock);
+    store_src_pad(self, stream_id, gst_object_ref(new_pad));
+    g_mutex_unlock(&self->src_pads_lock);
+
+    update_worker_pool_size(self);
 
     goto out;
 
@@ -523,7 +874,7 @@ out:
 
 static void remove_pad(GstElement *element, GstPad *pad)
 {
-    stop_srcpad_task(pad);
+    stop_srcpad_task(pad, GST_SCTP_DEC(element));
     gst_pad_set_active(pad, FALSE);
     gst_element_remove_pad(element, pad);
 }
@@ -531,18 +882,20 @@ static void remove_pad(GstElement *element, GstPad *pad)
 static void on_gst_sctp_association_stream_reset(GstSctpAssociation *gst_sctp_association, guint16 stream_id,
     GstSctpDec *self)
 {
-    gchar *pad_name;
     GstPad *srcpad;
 
-    pad_name = g_strdup_printf("src_%hu", stream_id);
-    srcpad = gst_element_get_static_pad(GST_ELEMENT(self), pad_name);
-    g_free(pad_name);
+    g_mutex_lock(&self->src_pads_lock);
+    srcpad = lookup_src_pad(self, stream_id);
+    if (srcpad)
+        store_src_pad(self, stream_id, NULL);
+    g_mutex_unlock(&self->src_pads_lock);
+
     if (!srcpad) {
         GST_WARNING_OBJECT(self, "Reset called on stream without a srcpad");
         return;
     }
     remove_pad(GST_ELEMENT(self), srcpad);
-    gst_object_unref(srcpad);
+    gst_atomic_queue_push(self->retired_src_pads, srcpad);
 }
 
 static void data_queue_item_free(GstDataQueueItem *item)
@@ -553,20 +906,36 @@ static void data_queue_item_free(GstDataQueueItem *item)
 }
 
 static void on_receive(GstSctpAssociation *sctp_association, guint8 *buf, gsize length,
-    guint16 stream_id, guint ppid, gpointer user_data)
+    guint16 stream_id, guint ppid, GstSctpAssociationMessageFlags flags, gpointer user_data)
 {
     GstSctpDec *self = user_data;
     GstSctpDecPad *sctpdec_pad;
     GstPad *src_pad;
     GstDataQueueItem *item;
     GstBuffer *gstbuf;
+    GstSctpReceiveMeta *meta;
+
+    /* Receiving is serialized by the association, so no pad retired before this point
+     * is referenced anymore */
+    free_retired_src_pads(self);
 
     src_pad = get_pad_for_stream_id(self, stream_id);
     g_assert(src_pad);
 
     sctpdec_pad = GST_SCTP_DEC_PAD(src_pad);
     gstbuf = gst_buffer_new_wrapped(buf, length);
-    gst_sctp_buffer_add_receive_meta(gstbuf, ppid);
+    meta = gst_sctp_buffer_add_receive_meta(gstbuf, ppid);
+    meta->flags = 0;
+    if (flags & GST_SCTP_ASSOCIATION_MESSAGE_BEGIN)
+        meta->flags |= GST_SCTP_RECEIVE_META_FLAG_BEGIN;
+    if (flags & GST_SCTP_ASSOCIATION_MESSAGE_END)
+        meta->flags |= GST_SCTP_RECEIVE_META_FLAG_END;
+
+    GST_OBJECT_LOCK(sctpdec_pad);
+    sctpdec_pad->bytes_received += length;
+    if (flags & GST_SCTP_ASSOCIATION_MESSAGE_END)
+        sctpdec_pad->messages_received++;
+    GST_OBJECT_UNLOCK(sctpdec_pad);
 
     item = g_new0(GstDataQueueItem, 1);
     item->object = GST_MINI_OBJECT(gstbuf);
@@ -576,17 +945,60 @@ static void on_receive(GstSctpAssociation *sctp_association, guint8 *buf, gsize
     if (!gst_data_queue_push(sctpdec_pad->packet_queue, item)) {
         item->destroy(item);
         GST_DEBUG_OBJECT(src_pad, "Failed to push item because we're flushing");
+    } else {
+        update_queue_full_state(self, sctpdec_pad);
+        if (sctpdec_pad->worker_pool)
+            schedule_srcpad(sctpdec_pad);
+    }
+}
+
+/* Pauses reading from the association while the pad's queue is above the limits, and
+ * resumes once it has drained below them again or was flushed */
+static void update_queue_full_state(GstSctpDec *self, GstSctpDecPad *sctpdec_pad)
+{
+    GstDataQueueSize level;
+    guint max_size_bytes, max_size_buffers;
+    gboolean full, pause = FALSE, resume = FALSE;
+
+    GST_OBJECT_LOCK(self);
+    max_size_bytes = self->max_size_bytes;
+    max_size_buffers = self->max_size_buffers;
+    GST_OBJECT_UNLOCK(self);
+
+    GST_OBJECT_LOCK(sctpdec_pad);
+    gst_data_queue_get_level(sctpdec_pad->packet_queue, &level);
+    full = (max_size_bytes && level.bytes >= max_size_bytes)
+        || (max_size_buffers && level.visible >= max_size_buffers);
+    if (full && !sctpdec_pad->full) {
+        sctpdec_pad->full = TRUE;
+        pause = TRUE;
+    } else if (!full && sctpdec_pad->full) {
+        sctpdec_pad->full = FALSE;
+        resume = TRUE;
     }
+    GST_OBJECT_UNLOCK(sctpdec_pad);
 
-    gst_object_unref(src_pad);
+    if (!self->sctp_association)
+        return;
+
+    if (pause) {
+        GST_DEBUG_OBJECT(sctpdec_pad, "Queue full (%u bytes, %u buffers), pausing receive",
+            level.bytes, level.visible);
+        gst_sctp_association_pause_receive(self->sctp_association);
+    } else if (resume) {
+        GST_DEBUG_OBJECT(sctpdec_pad, "Queue drained, resuming receive");
+        gst_sctp_association_resume_receive(self->sctp_association);
+    }
 }
 
-static void stop_srcpad_task(GstPad *pad)
+static void stop_srcpad_task(GstPad *pad, GstSctpDec *self)
 {
     GstSctpDecPad *sctpdec_pad = GST_SCTP_DEC_PAD(pad);
 
     gst_data_queue_set_flushing(sctpdec_pad->packet_queue, TRUE);
     gst_data_queue_flush(sctpdec_pad->packet_queue);
+    if (self)
+        update_queue_full_state(self, sctpdec_pad);
     gst_pad_stop_task(pad);
 }
 
@@ -610,13 +1022,87 @@ static void stop_all_srcpad_tasks(GstSctpDec *self)
 
 static void sctpdec_cleanup(GstSctpDec *self)
 {
+    GstSctpAssociation *sctp_association;
+
+    if (self->stats_clock_id) {
+        gst_sctp_stats_stop_periodic(self->stats_clock_id);
+        self->stats_clock_id = NULL;
+    }
+
     if (self->sctp_association) {
         g_signal_handler_disconnect(self->sctp_association, self->signal_handler_stream_reset);
         stop_all_srcpad_tasks(self);
         gst_sctp_association_force_close(self->sctp_association);
-        g_object_unref(self->sctp_association);
+
+        /* The stats property may be read from another thread */
+        GST_OBJECT_LOCK(self);
+        sctp_association = self->sctp_association;
         self->sctp_association = NULL;
+        GST_OBJECT_UNLOCK(self);
+        g_object_unref(sctp_association);
     }
+
+    clear_src_pads(self);
+    free_retired_src_pads(self);
+
+    if (self->worker_pool) {
+        /* All queues are flushed by now, so whatever is still scheduled returns at once */
+        g_thread_pool_free(self->worker_pool, FALSE, TRUE);
+        self->worker_pool = NULL;
+    }
+}
+
+static void add_stream_stats(const GValue *item, gpointer user_data)
+{
+    GstSctpDecPad *sctpdec_pad = g_value_get_object(item);
+    GValue *streams = user_data;
+    GstStructure *stream_stats;
+    GstDataQueueSize level;
+    GValue value = G_VALUE_INIT;
+
+    gst_data_queue_get_level(sctpdec_pad->packet_queue, &level);
+
+    GST_OBJECT_LOCK(sctpdec_pad);
+    stream_stats = gst_structure_new("sctp-stream-stats",
+        "stream-id", G_TYPE_UINT, (guint)sctpdec_pad->stream_id,
+        "bytes-received", G_TYPE_UINT64, sctpdec_pad->bytes_received,
+        "messages-received", G_TYPE_UINT64, sctpdec_pad->messages_received,
+        "bytes-queued", G_TYPE_UINT64, (guint64)level.bytes,
+        NULL);
+    GST_OBJECT_UNLOCK(sctpdec_pad);
+
+    g_value_init(&value, GST_TYPE_STRUCTURE);
+    g_value_take_boxed(&value, stream_stats);
+    gst_value_array_append_and_take_value(streams, &value);
+}
+
+static GstStructure *get_stats(GstSctpDec *self)
+{
+    GstSctpAssociation *sctp_association = NULL;
+    GstStructure *stats;
+    GValue streams = G_VALUE_INIT;
+    GstIterator *it;
+
+    GST_OBJECT_LOCK(self);
+    if (self->sctp_association)
+        sctp_association = g_object_ref(self->sctp_association);
+    GST_OBJECT_UNLOCK(self);
+
+    stats = gst_sctp_stats_new(sctp_association);
+    if (sctp_association)
+        g_object_unref(sctp_association);
+
+    g_value_init(&streams, GST_TYPE_ARRAY);
+    it = gst_element_iterate_src_pads(GST_ELEMENT(self));
+    while (gst_iterator_foreach(it, add_stream_stats, &streams) == GST_ITERATOR_RESYNC) {
+        g_value_unset(&streams);
+        g_value_init(&streams, GST_TYPE_ARRAY);
+        gst_iterator_resync(it);
+    }
+    gst_iterator_free(it);
+    gst_structure_take_value(stats, "streams", &streams);
+
+    return stats;
 }
 
 static void on_reset_stream(GstSctpDec *self, guint stream_id)
@@ -47,6 +47,23 @@ struct _GstSctpDec {
     GstPad *sink_pad;
     guint sctp_association_id;
     guint local_sctp_port;
+    guint max_size_bytes;
+    guint max_size_buffers;
+    guint worker_threads;
+    gboolean partial_delivery;
+    gboolean verify_checksum;
+    guint stats_interval;
+    GstClockID stats_clock_id;
+    GThreadPool *worker_pool;
+    /* worker-threads when the pool was made, and whether the element is PLAYING, both
+     * protected by the object lock, see update_worker_pool_size() */
+    guint worker_pool_size;
+    gboolean playing;
+
+    /* Source pads indexed by stream id, see lookup_src_pad() */
+    GMutex src_pads_lock;
+    GstPad **src_pads[256];
+    GstAtomicQueue *retired_src_pads;
 
     GstSctpAssociation *sctp_association;
     gulong signal_handler_stream_reset;
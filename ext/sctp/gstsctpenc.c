@@ -27,6 +27,7 @@
 #include "config.h"
 #endif
 #include "gstsctpenc.h"
+#include "gstsctpstats.h"
 
 #include <gst/sctp/sctpsendmeta.h>
 #include <stdio.h>
@@ -46,6 +47,7 @@ static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE("src", GST_PA
 enum {
     SIGNAL_SCTP_ASSOCIATION_ESTABLISHED,
     SIGNAL_GET_STREAM_BYTES_SENT,
+    SIGNAL_BUFFERED_AMOUNT_LOW,
     NUM_SIGNALS
 };
 
@@ -57,6 +59,25 @@ enum {
     PROP_GST_SCTP_ASSOCIATION_ID,
     PROP_REMOTE_SCTP_PORT,
     PROP_USE_SOCK_STREAM,
+    PROP_STREAM_SCHEDULER,
+    PROP_MAX_MTU,
+    PROP_MTU,
+    PROP_DONT_FRAGMENT,
+    PROP_CONGESTION_CONTROL,
+    PROP_RTO_INITIAL,
+    PROP_RTO_MIN,
+    PROP_RTO_MAX,
+    PROP_SEND_BUFFER_SIZE,
+    PROP_RECEIVE_BUFFER_SIZE,
+    PROP_SACK_DELAY,
+    PROP_SACK_FREQUENCY,
+    PROP_UDP_REMOTE_ADDRESS,
+    PROP_UDP_REMOTE_PORT,
+    PROP_UDP_LOCAL_PORT,
+    PROP_COMPUTE_CHECKSUM,
+    PROP_STACK_IDLE_TIMEOUT,
+    PROP_STATS,
+    PROP_STATS_INTERVAL,
 
     NUM_PROPERTIES
 };
@@ -68,8 +89,23 @@ static GParamSpec *properties[NUM_PROPERTIES];
 #define DEFAULT_GST_SCTP_ORDERED TRUE
 #define DEFAULT_SCTP_PPID 1
 #define DEFAULT_USE_SOCK_STREAM FALSE
-
-#define BUFFER_FULL_SLEEP_TIME 100000
+#define DEFAULT_STREAM_SCHEDULER GST_SCTP_ASSOCIATION_STREAM_SCHEDULER_DEFAULT
+#define DEFAULT_STREAM_PRIORITY 0
+#define MIN_MTU 1200
+#define DEFAULT_MAX_MTU MIN_MTU
+#define DEFAULT_CONGESTION_CONTROL GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_RFC4960
+/* RFC 4960 section 6.2 */
+#define MAX_SACK_DELAY 500
+#define DEFAULT_STACK_IDLE_TIMEOUT 30
+
+/* Outbound SCTP packets never exceed the path MTU, so pooled buffers of this size, or of
+ * max-mtu if that is larger, cover the steady state. Larger packets fall back to a
+ * one-off allocation. */
+#define OUTBOUND_PACKET_BUFFER_SIZE 1500
+#define OUTBOUND_PACKET_POOL_MIN_BUFFERS 16
+#define OUTBOUND_QUEUE_PREALLOCATED_ITEMS 32
+/* Items beyond this are freed when they come back, a burst does not pin its memory */
+#define OUTBOUND_QUEUE_MAX_FREE_ITEMS 256
 
 GType gst_sctp_enc_pad_get_type(void);
 
@@ -90,8 +126,20 @@ struct _GstSctpEncPad {
     guint32 ppid;
     GstSctpAssociationPartialReliability reliability;
     guint32 reliability_param;
+    guint16 priority;
+    /* Part of a message has been sent, but not its end. Only used by the streaming thread */
+    gboolean message_open;
 
+    /* Statistics, protected by the lock */
     guint64 bytes_sent;
+    guint64 messages_sent;
+    guint64 bytes_queued;
+    GstClockTime send_latency_total;
+    GstClockTime send_latency_max;
+
+    /* Sent bytes still in the send buffer of the association, protected by the lock */
+    guint64 buffered_amount;
+    guint64 buffered_amount_low_threshold;
 
     GMutex lock;
     GCond cond;
@@ -100,6 +148,71 @@ struct _GstSctpEncPad {
 
 G_DEFINE_TYPE(GstSctpEncPad, gst_sctp_enc_pad, GST_TYPE_PAD);
 
+enum {
+    PROP_PAD_0,
+    PROP_PAD_BUFFERED_AMOUNT,
+    PROP_PAD_BUFFERED_AMOUNT_LOW_THRESHOLD
+};
+
+typedef struct {
+    GstDataQueueItem item;
+    GstSctpEnc *sctpenc;
+} GstSctpEncQueueItem;
+
+typedef struct {
+    GstSctpEncPad *sctpenc_pad;
+    guint32 bytes;
+    guint16 priority;
+} BufferedRecord;
+
+/* The bytes of one pad in the send buffer, and its part of the bytes that have left it */
+typedef struct {
+    GstSctpEncPad *sctpenc_pad;
+    guint16 priority;
+    guint order;
+    guint32 outstanding;
+    guint32 share;
+} BufferedShare;
+
+static void gst_sctp_enc_pad_set_property(GObject *object, guint prop_id, const GValue *value,
+    GParamSpec *pspec)
+{
+    GstSctpEncPad *self = GST_SCTP_ENC_PAD(object);
+
+    switch (prop_id) {
+    case PROP_PAD_BUFFERED_AMOUNT_LOW_THRESHOLD:
+        g_mutex_lock(&self->lock);
+        self->buffered_amount_low_threshold = g_value_get_uint64(value);
+        g_mutex_unlock(&self->lock);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        break;
+    }
+}
+
+static void gst_sctp_enc_pad_get_property(GObject *object, guint prop_id, GValue *value,
+    GParamSpec *pspec)
+{
+    GstSctpEncPad *self = GST_SCTP_ENC_PAD(object);
+
+    switch (prop_id) {
+    case PROP_PAD_BUFFERED_AMOUNT:
+        g_mutex_lock(&self->lock);
+        g_value_set_uint64(value, self->buffered_amount);
+        g_mutex_unlock(&self->lock);
+        break;
+    case PROP_PAD_BUFFERED_AMOUNT_LOW_THRESHOLD:
+        g_mutex_lock(&self->lock);
+        g_value_set_uint64(value, self->buffered_amount_low_threshold);
+        g_mutex_unlock(&self->lock);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        break;
+    }
+}
+
 static void gst_sctp_enc_pad_finalize(GObject *object)
 {
     GstSctpEncPad *self = GST_SCTP_ENC_PAD(object);
@@ -115,6 +228,24 @@ static void gst_sctp_enc_pad_class_init(GstSctpEncPadClass *klass)
     GObjectClass *gobject_class = (GObjectClass *) klass;
 
     gobject_class->finalize = gst_sctp_enc_pad_finalize;
+    gobject_class->set_property = gst_sctp_enc_pad_set_property;
+    gobject_class->get_property = gst_sctp_enc_pad_get_property;
+
+    g_object_class_install_property(gobject_class, PROP_PAD_BUFFERED_AMOUNT,
+        g_param_spec_uint64("buffered-amount",
+            "Buffered amount",
+            "Bytes sent on this pad that are still in the send buffer of the association, "
+            "i.e. neither acknowledged by the peer nor abandoned",
+            0, G_MAXUINT64, 0,
+            G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+    g_object_class_install_property(gobject_class, PROP_PAD_BUFFERED_AMOUNT_LOW_THRESHOLD,
+        g_param_spec_uint64("buffered-amount-low-threshold",
+            "Buffered amount low threshold",
+            "The \"buffered-amount-low\" signal of the element is emitted when buffered-amount "
+            "drops from above this value to this value or below",
+            0, G_MAXUINT64, 0,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 static void gst_sctp_enc_pad_init(GstSctpEncPad *self)
@@ -122,6 +253,9 @@ static void gst_sctp_enc_pad_init(GstSctpEncPad *self)
     g_mutex_init(&self->lock);
     g_cond_init(&self->cond);
     self->flushing = FALSE;
+    self->message_open = FALSE;
+    self->buffered_amount = 0;
+    self->buffered_amount_low_threshold = 0;
 }
 
 static void gst_sctp_enc_finalize(GObject *object);
@@ -134,20 +268,37 @@ static GstPad *gst_sctp_enc_request_new_pad(GstElement *element, GstPadTemplate
 static void gst_sctp_enc_release_pad(GstElement *element, GstPad *pad);
 static void gst_sctp_enc_srcpad_loop(GstPad *pad);
 static GstFlowReturn gst_sctp_enc_sink_chain(GstPad *pad, GstObject *parent, GstBuffer *buffer);
+static GstFlowReturn send_message_part(GstSctpEnc *self, GstSctpEncPad *sctpenc_pad,
+    const guint8 *data, gsize size, gboolean end_of_record, guint32 ppid, gboolean ordered,
+    GstSctpAssociationPartialReliability pr, guint32 pr_param);
 static gboolean gst_sctp_enc_sink_event(GstPad *pad, GstObject *parent, GstEvent *event);
 static gboolean gst_sctp_enc_src_event(GstPad *pad, GstObject *parent, GstEvent *event);
 static void on_sctp_association_state_changed(GstSctpAssociation *sctp_association, GParamSpec *pspec,
     GstSctpEnc *self);
+static void on_sctp_association_mtu_changed(GstSctpAssociation *sctp_association, GParamSpec *pspec,
+    GstSctpEnc *self);
 
 static gboolean configure_association(GstSctpEnc *self);
 static void on_sctp_packet_out(GstSctpAssociation *sctp_association, const guint8 *buf, gsize length,
     gpointer user_data);
+static void on_sctp_ready_to_send(GstSctpAssociation *sctp_association, gpointer user_data);
+static void wake_pending_pads(GstSctpEnc *self);
+static void on_sctp_send_buffer_drained(GstSctpAssociation *sctp_association, guint32 bytes_drained,
+    gpointer user_data);
+static void record_buffered(GstSctpEnc *self, GstSctpEncPad *sctpenc_pad, guint32 bytes);
+static void release_buffered(GstSctpEnc *self);
+static guint32 take_buffered(GstSctpEnc *self, GstSctpEncPad *sctpenc_pad, guint32 bytes,
+    GQueue *released);
+static guint32 take_buffered_per_stream(GstSctpEnc *self, guint32 bytes, GQueue *released);
+static void clear_buffered_records(GstSctpEnc *self);
 static void stop_srcpad_task(GstPad *pad, GstSctpEnc *self);
 static void sctpenc_cleanup(GstSctpEnc *self);
 static void get_config_from_caps(const GstCaps *caps, gboolean *ordered,
     GstSctpAssociationPartialReliability *reliability, guint32 *reliability_param, guint32 *ppid,
-    gboolean *ppid_available);
+    gboolean *ppid_available, guint16 *priority, gboolean *priority_available);
+static void set_pad_priority(GstSctpEnc *self, GstSctpEncPad *sctpenc_pad, guint16 priority);
 static guint64 on_get_stream_bytes_sent(GstSctpEnc *self, guint stream_id);
+static GstStructure *get_stats(GstSctpEnc *self);
 
 static void gst_sctp_enc_class_init(GstSctpEncClass *klass)
 {
@@ -195,6 +346,155 @@ static void gst_sctp_enc_class_init(GstSctpEncClass *klass)
             "When TRUE the partial reliability parameters of the channel are ignored.",
             DEFAULT_USE_SOCK_STREAM, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
+    properties[PROP_STREAM_SCHEDULER] =
+        g_param_spec_enum("stream-scheduler",
+            "Stream scheduler",
+            "How the send capacity of the association is shared between the streams. The "
+            "priority of a stream is taken from the \"priority\" caps field of its sink pad "
+            "or from GstSctpSendMeta.",
+            GST_SCTP_TYPE_ASSOCIATION_STREAM_SCHEDULER, DEFAULT_STREAM_SCHEDULER,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_MAX_MTU] =
+        g_param_spec_uint("max-mtu",
+            "Max MTU",
+            "The largest SCTP packet size path MTU discovery probes for. Discovery starts at "
+            "1200 bytes, which is also the default and disables probing. Probing also needs "
+            "dont-fragment, or a UDP transport that could set the don't fragment bit. This "
+            "value must be set before the element goes to PAUSED.",
+            MIN_MTU, G_MAXUINT16, DEFAULT_MAX_MTU,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_MTU] =
+        g_param_spec_uint("mtu",
+            "MTU",
+            "The SCTP packet size currently used on the path, as found by path MTU discovery",
+            0, G_MAXUINT16, MIN_MTU,
+            G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_DONT_FRAGMENT] =
+        g_param_spec_boolean("dont-fragment",
+            "Don't fragment",
+            "Set when whatever carries the SCTP packets downstream drops packets larger than "
+            "the path MTU instead of fragmenting them. Path MTU probing over the pipeline is "
+            "only done when this is set. This value must be set before the element goes to "
+            "PAUSED.",
+            FALSE,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_CONGESTION_CONTROL] =
+        g_param_spec_enum("congestion-control",
+            "Congestion control",
+            "The congestion control module used by the SCTP association",
+            GST_SCTP_TYPE_ASSOCIATION_CONGESTION_CONTROL, DEFAULT_CONGESTION_CONTROL,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_RTO_INITIAL] =
+        g_param_spec_uint("rto-initial",
+            "RTO initial",
+            "Initial retransmission timeout in milliseconds (0 = default)",
+            0, G_MAXUINT, 0,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_RTO_MIN] =
+        g_param_spec_uint("rto-min",
+            "RTO min",
+            "Minimum retransmission timeout in milliseconds (0 = default)",
+            0, G_MAXUINT, 0,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_RTO_MAX] =
+        g_param_spec_uint("rto-max",
+            "RTO max",
+            "Maximum retransmission timeout in milliseconds (0 = default)",
+            0, G_MAXUINT, 0,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_SEND_BUFFER_SIZE] =
+        g_param_spec_uint("send-buffer-size",
+            "Send buffer size",
+            "Size of the SCTP socket send buffer in bytes (0 = default)",
+            0, G_MAXINT, 0,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_RECEIVE_BUFFER_SIZE] =
+        g_param_spec_uint("receive-buffer-size",
+            "Receive buffer size",
+            "Size of the SCTP socket receive buffer in bytes, which bounds the advertised "
+            "receive window (0 = default)",
+            0, G_MAXINT, 0,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_SACK_DELAY] =
+        g_param_spec_uint("sack-delay",
+            "SACK delay",
+            "Delayed acknowledgement timer in milliseconds (0 = default)",
+            0, MAX_SACK_DELAY, 0,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_SACK_FREQUENCY] =
+        g_param_spec_uint("sack-frequency",
+            "SACK frequency",
+            "Number of packets received before a SACK is sent without waiting for the "
+            "timer, 1 disables delayed acknowledgements (0 = default)",
+            0, G_MAXUINT16, 0,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_UDP_REMOTE_ADDRESS] =
+        g_param_spec_string("udp-remote-address",
+            "UDP remote address",
+            "When set, the SCTP association sends its packets over UDP (RFC 6951) to this host "
+            "itself. Nothing is pushed on the src pad and the GstSctpDec sink pad is not used. "
+            "Meant for unencrypted and test deployments.",
+            NULL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_UDP_REMOTE_PORT] =
+        g_param_spec_uint("udp-remote-port",
+            "UDP remote port",
+            "The UDP port of the peer, see udp-remote-address",
+            0, G_MAXUINT16, 0,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_UDP_LOCAL_PORT] =
+        g_param_spec_uint("udp-local-port",
+            "UDP local port",
+            "The local UDP port, see udp-remote-address (0 = any)",
+            0, G_MAXUINT16, 0,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_COMPUTE_CHECKSUM] =
+        g_param_spec_boolean("compute-checksum",
+            "Compute checksum",
+            "Fill in the CRC32c checksum of outgoing packets. Only disable when the peer "
+            "does not verify it, e.g. it accepts zero checksums (RFC 9653).",
+            TRUE,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_STACK_IDLE_TIMEOUT] =
+        g_param_spec_uint("stack-idle-timeout",
+            "Stack idle timeout",
+            "Seconds the SCTP stack is kept running after the last association is gone, so "
+            "that setting up the next one is faster (0 = stop it right away)",
+            0, G_MAXUINT, DEFAULT_STACK_IDLE_TIMEOUT,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_STATS] =
+        g_param_spec_boxed("stats",
+            "Statistics",
+            "Transport statistics of the association, with the per stream statistics of the "
+            "sink pads in its \"streams\" array. The send latency of a stream is the time from a "
+            "buffer arriving on its pad until all of it is accepted by the association.",
+            GST_TYPE_STRUCTURE,
+            G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_STATS_INTERVAL] =
+        g_param_spec_uint("stats-interval",
+            "Statistics interval",
+            "Post the statistics as an element message this often, in milliseconds "
+            "(0 = never). Applied when the element starts.",
+            0, G_MAXUINT, 0,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
     g_object_class_install_properties(gobject_class, NUM_PROPERTIES, properties);
 
     signals[SIGNAL_SCTP_ASSOCIATION_ESTABLISHED] = g_signal_new(
@@ -208,6 +508,11 @@ static void gst_sctp_enc_class_init(GstSctpEncClass *klass)
         G_STRUCT_OFFSET(GstSctpEncClass, on_get_stream_bytes_sent), NULL, NULL,
         g_cclosure_marshal_generic, G_TYPE_UINT64, 1, G_TYPE_UINT);
 
+    signals[SIGNAL_BUFFERED_AMOUNT_LOW] = g_signal_new("buffered-amount-low",
+        G_TYPE_FROM_CLASS(gobject_class), G_SIGNAL_RUN_LAST,
+        G_STRUCT_OFFSET(GstSctpEncClass, on_buffered_amount_low), NULL, NULL,
+        g_cclosure_marshal_generic, G_TYPE_NONE, 1, G_TYPE_UINT);
+
     klass->on_get_stream_bytes_sent =  GST_DEBUG_FUNCPTR(on_get_stream_bytes_sent);
 
     gst_element_class_set_static_metadata(element_class,
@@ -261,14 +566,94 @@ gst_sctp_enc_src_activate_mode (GstPad * pad, GstObject * parent,
   return ret;
 }
 
+static void setup_outbound_packet_pool(GstSctpEnc *self)
+{
+    GstStructure *config;
+    GstSctpEncQueueItem *queue_item;
+    guint i;
+
+    self->outbound_packet_pool = gst_buffer_pool_new();
+    config = gst_buffer_pool_get_config(self->outbound_packet_pool);
+    self->outbound_packet_size = OUTBOUND_PACKET_BUFFER_SIZE;
+    gst_buffer_pool_config_set_params(config, NULL, self->outbound_packet_size,
+        OUTBOUND_PACKET_POOL_MIN_BUFFERS, 0);
+    if (!gst_buffer_pool_set_config(self->outbound_packet_pool, config)
+        || !gst_buffer_pool_set_active(self->outbound_packet_pool, TRUE)) {
+        GST_WARNING_OBJECT(self, "Could not activate outbound packet pool");
+        gst_object_unref(self->outbound_packet_pool);
+        self->outbound_packet_pool = NULL;
+    }
+
+    self->free_queue_items = gst_atomic_queue_new(OUTBOUND_QUEUE_PREALLOCATED_ITEMS);
+    for (i = 0; i < OUTBOUND_QUEUE_PREALLOCATED_ITEMS; i++) {
+        queue_item = g_new0(GstSctpEncQueueItem, 1);
+        queue_item->sctpenc = self;
+        gst_atomic_queue_push(self->free_queue_items, queue_item);
+    }
+}
+
+/* Must be called before any packets are sent */
+static void resize_outbound_packet_pool(GstSctpEnc *self, guint size)
+{
+    GstStructure *config;
+
+    if (!self->outbound_packet_pool || size <= self->outbound_packet_size)
+        return;
+
+    gst_buffer_pool_set_active(self->outbound_packet_pool, FALSE);
+    config = gst_buffer_pool_get_config(self->outbound_packet_pool);
+    gst_buffer_pool_config_set_params(config, NULL, size, OUTBOUND_PACKET_POOL_MIN_BUFFERS, 0);
+    if (!gst_buffer_pool_set_config(self->outbound_packet_pool, config)
+        || !gst_buffer_pool_set_active(self->outbound_packet_pool, TRUE)) {
+        GST_WARNING_OBJECT(self, "Could not resize outbound packet pool");
+        gst_object_unref(self->outbound_packet_pool);
+        self->outbound_packet_pool = NULL;
+        return;
+    }
+    self->outbound_packet_size = size;
+}
+
+static void free_outbound_packet_pool(GstSctpEnc *self)
+{
+    GstSctpEncQueueItem *queue_item;
+
+    while ((queue_item = gst_atomic_queue_pop(self->free_queue_items)))
+        g_free(queue_item);
+    gst_atomic_queue_unref(self->free_queue_items);
+
+    if (self->outbound_packet_pool) {
+        gst_buffer_pool_set_active(self->outbound_packet_pool, FALSE);
+        gst_object_unref(self->outbound_packet_pool);
+    }
+}
+
 static void gst_sctp_enc_init(GstSctpEnc *self)
 {
     self->sctp_association_id = DEFAULT_GST_SCTP_ASSOCIATION_ID;
     self->remote_sctp_port = DEFAULT_REMOTE_SCTP_PORT;
+    self->stream_scheduler = DEFAULT_STREAM_SCHEDULER;
+    self->max_mtu = DEFAULT_MAX_MTU;
+    self->dont_fragment = FALSE;
+    self->congestion_control = DEFAULT_CONGESTION_CONTROL;
+    self->rto_initial = 0;
+    self->rto_min = 0;
+    self->rto_max = 0;
+    self->send_buffer_size = 0;
+    self->receive_buffer_size = 0;
+    self->sack_delay = 0;
+    self->sack_frequency = 0;
+    self->compute_checksum = TRUE;
+    self->stack_idle_timeout = DEFAULT_STACK_IDLE_TIMEOUT;
+    self->udp_remote_address = NULL;
+    self->udp_remote_port = 0;
+    self->udp_local_port = 0;
+    self->stats_interval = 0;
+    self->stats_clock_id = NULL;
 
     self->sctp_association = NULL;
     self->outbound_sctp_packet_queue = gst_data_queue_new(data_queue_check_full_cb,
         data_queue_full_cb, data_queue_empty_cb, NULL);
+    setup_outbound_packet_pool(self);
 
     self->src_pad = gst_pad_new_from_static_template(&src_template, "src");
     gst_pad_set_event_function(self->src_pad,
@@ -279,6 +664,11 @@ static void gst_sctp_enc_init(GstSctpEnc *self)
     gst_element_add_pad(GST_ELEMENT(self), self->src_pad);
 
     g_queue_init(&self->pending_pads);
+
+    g_mutex_init(&self->buffered_lock);
+    g_queue_init(&self->buffered_records);
+    self->bytes_drained = 0;
+    self->bytes_released = 0;
 }
 
 static void gst_sctp_enc_finalize(GObject *object)
@@ -286,7 +676,11 @@ static void gst_sctp_enc_finalize(GObject *object)
     GstSctpEnc *self = GST_SCTP_ENC(object);
 
     g_queue_clear(&self->pending_pads);
+    clear_buffered_records(self);
+    g_mutex_clear(&self->buffered_lock);
     gst_object_unref(self->outbound_sctp_packet_queue);
+    free_outbound_packet_pool(self);
+    g_free(self->udp_remote_address);
 
     G_OBJECT_CLASS(parent_class)->finalize (object);
 }
@@ -306,6 +700,58 @@ static void gst_sctp_enc_set_property(GObject *object, guint prop_id, const GVal
     case PROP_USE_SOCK_STREAM:
         self->use_sock_stream = g_value_get_boolean(value);
         break;
+    case PROP_STREAM_SCHEDULER:
+        self->stream_scheduler = g_value_get_enum(value);
+        break;
+    case PROP_MAX_MTU:
+        self->max_mtu = g_value_get_uint(value);
+        break;
+    case PROP_DONT_FRAGMENT:
+        self->dont_fragment = g_value_get_boolean(value);
+        break;
+    case PROP_CONGESTION_CONTROL:
+        self->congestion_control = g_value_get_enum(value);
+        break;
+    case PROP_RTO_INITIAL:
+        self->rto_initial = g_value_get_uint(value);
+        break;
+    case PROP_RTO_MIN:
+        self->rto_min = g_value_get_uint(value);
+        break;
+    case PROP_RTO_MAX:
+        self->rto_max = g_value_get_uint(value);
+        break;
+    case PROP_SEND_BUFFER_SIZE:
+        self->send_buffer_size = g_value_get_uint(value);
+        break;
+    case PROP_RECEIVE_BUFFER_SIZE:
+        self->receive_buffer_size = g_value_get_uint(value);
+        break;
+    case PROP_SACK_DELAY:
+        self->sack_delay = g_value_get_uint(value);
+        break;
+    case PROP_SACK_FREQUENCY:
+        self->sack_frequency = g_value_get_uint(value);
+        break;
+    case PROP_COMPUTE_CHECKSUM:
+        self->compute_checksum = g_value_get_boolean(value);
+        break;
+    case PROP_STACK_IDLE_TIMEOUT:
+        self->stack_idle_timeout = g_value_get_uint(value);
+        break;
+    case PROP_STATS_INTERVAL:
+        self->stats_interval = g_value_get_uint(value);
+        break;
+    case PROP_UDP_REMOTE_ADDRESS:
+        g_free(self->udp_remote_address);
+        self->udp_remote_address = g_value_dup_string(value);
+        break;
+    case PROP_UDP_REMOTE_PORT:
+        self->udp_remote_port = g_value_get_uint(value);
+        break;
+    case PROP_UDP_LOCAL_PORT:
+        self->udp_local_port = g_value_get_uint(value);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(self, prop_id, pspec);
         break;
@@ -327,6 +773,66 @@ static void gst_sctp_enc_get_property(GObject *object, guint prop_id, GValue *va
     case PROP_USE_SOCK_STREAM:
         g_value_set_boolean(value, self->use_sock_stream);
         break;
+    case PROP_STREAM_SCHEDULER:
+        g_value_set_enum(value, self->stream_scheduler);
+        break;
+    case PROP_MAX_MTU:
+        g_value_set_uint(value, self->max_mtu);
+        break;
+    case PROP_DONT_FRAGMENT:
+        g_value_set_boolean(value, self->dont_fragment);
+        break;
+    case PROP_CONGESTION_CONTROL:
+        g_value_set_enum(value, self->congestion_control);
+        break;
+    case PROP_RTO_INITIAL:
+        g_value_set_uint(value, self->rto_initial);
+        break;
+    case PROP_RTO_MIN:
+        g_value_set_uint(value, self->rto_min);
+        break;
+    case PROP_RTO_MAX:
+        g_value_set_uint(value, self->rto_max);
+        break;
+    case PROP_SEND_BUFFER_SIZE:
+        g_value_set_uint(value, self->send_buffer_size);
+        break;
+    case PROP_RECEIVE_BUFFER_SIZE:
+        g_value_set_uint(value, self->receive_buffer_size);
+        break;
+    case PROP_SACK_DELAY:
+        g_value_set_uint(value, self->sack_delay);
+        break;
+    case PROP_SACK_FREQUENCY:
+        g_value_set_uint(value, self->sack_frequency);
+        break;
+    case PROP_COMPUTE_CHECKSUM:
+        g_value_set_boolean(value, self->compute_checksum);
+        break;
+    case PROP_STACK_IDLE_TIMEOUT:
+        g_value_set_uint(value, self->stack_idle_timeout);
+        break;
+    case PROP_STATS:
+        g_value_take_boxed(value, get_stats(self));
+        break;
+    case PROP_STATS_INTERVAL:
+        g_value_set_uint(value, self->stats_interval);
+        break;
+    case PROP_UDP_REMOTE_ADDRESS:
+        g_value_set_string(value, self->udp_remote_address);
+        break;
+    case PROP_UDP_REMOTE_PORT:
+        g_value_set_uint(value, self->udp_remote_port);
+        break;
+    case PROP_UDP_LOCAL_PORT:
+        g_value_set_uint(value, self->udp_local_port);
+        break;
+    case PROP_MTU:
+        if (self->sctp_association)
+            g_object_get_property(G_OBJECT(self->sctp_association), "mtu", value);
+        else
+            g_value_set_uint(value, MIN_MTU);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(self, prop_id, pspec);
         break;
@@ -343,6 +849,8 @@ static GstPad * gst_sctp_enc_request_new_pad(GstElement *element, GstPadTemplate
     gint state;
     guint32 new_ppid;
     gboolean is_new_ppid;
+    guint16 new_priority;
+    gboolean is_new_priority;
 
     g_object_get(self->sctp_association, "state", &state, NULL);
 
@@ -374,10 +882,13 @@ static GstPad * gst_sctp_enc_request_new_pad(GstElement *element, GstPadTemplate
     sctpenc_pad->ppid = DEFAULT_SCTP_PPID;
 
     get_config_from_caps(caps, &sctpenc_pad->ordered, &sctpenc_pad->reliability,
-        &sctpenc_pad->reliability_param, &new_ppid, &is_new_ppid);
+        &sctpenc_pad->reliability_param, &new_ppid, &is_new_ppid, &new_priority, &is_new_priority);
 
     if (is_new_ppid)
         sctpenc_pad->ppid = new_ppid;
+    sctpenc_pad->priority = DEFAULT_STREAM_PRIORITY;
+    if (is_new_priority)
+        set_pad_priority(self, sctpenc_pad, new_priority);
     sctpenc_pad->flushing = FALSE;
 
     if (!gst_pad_set_active (new_pad, TRUE))
@@ -478,10 +989,13 @@ static GstFlowReturn gst_sctp_enc_sink_chain(GstPad *pad, GstObject *parent, Gst
     gboolean ordered;
     GstSctpAssociationPartialReliability pr;
     guint32 pr_param;
+    guint i, n_memory;
     gpointer state = NULL;
     GstMeta *meta;
     const GstMetaInfo *meta_info = GST_SCTP_SEND_META_INFO;
     GstFlowReturn flow_ret = GST_FLOW_ERROR;
+    GstClockTime start_time = gst_util_get_timestamp();
+    GstClockTime latency;
 
     ppid = sctpenc_pad->ppid;
     ordered = sctpenc_pad->ordered;
@@ -495,6 +1009,8 @@ static GstFlowReturn gst_sctp_enc_sink_chain(GstPad *pad, GstObject *parent, Gst
             ppid = sctp_send_meta->ppid;
             ordered = sctp_send_meta->ordered;
             pr_param = sctp_send_meta->pr_param;
+            if (sctp_send_meta->priority >= 0)
+                set_pad_priority(self, sctpenc_pad, (guint16)MIN(sctp_send_meta->priority, G_MAXUINT16));
             switch (sctp_send_meta->pr) {
             case GST_SCTP_SEND_META_PARTIAL_RELIABILITY_NONE:
                 pr = GST_SCTP_ASSOCIATION_PARTIAL_RELIABILITY_NONE;
@@ -513,53 +1029,145 @@ static GstFlowReturn gst_sctp_enc_sink_chain(GstPad *pad, GstObject *parent, Gst
         }
     }
 
-    if (!gst_buffer_map(buffer, &map, GST_MAP_READ)) {
-        g_warning("Could not map GstBuffer");
+    /* With message interleaving each memory is sent as a part of the same SCTP message, so
+     * buffers made of several memories are not merged into a contiguous copy. Without it an
+     * incomplete message would hold back all other streams, and as usrsctp has no
+     * scatter-gather send the buffer is merged and sent in one go. */
+    n_memory = gst_buffer_n_memory(buffer);
+    if (n_memory == 0) {
+        flow_ret = send_message_part(self, sctpenc_pad, NULL, 0, TRUE, ppid, ordered, pr, pr_param);
         goto error;
     }
 
+    if (n_memory == 1 || !gst_sctp_association_get_message_interleaving(self->sctp_association)) {
+        if (!gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+            g_warning("Could not map GstBuffer");
+            goto error;
+        }
+        flow_ret = send_message_part(self, sctpenc_pad, map.data, map.size, TRUE, ppid, ordered,
+            pr, pr_param);
+        gst_buffer_unmap(buffer, &map);
+    } else {
+        for (i = 0; i < n_memory; i++) {
+            GstMemory *mem = gst_buffer_peek_memory(buffer, i);
+
+            if (!gst_memory_map(mem, &map, GST_MAP_READ)) {
+                g_warning("Could not map GstMemory");
+                flow_ret = GST_FLOW_ERROR;
+                break;
+            }
+
+            flow_ret = send_message_part(self, sctpenc_pad, map.data, map.size, i == n_memory - 1,
+                ppid, ordered, pr, pr_param);
+            gst_memory_unmap(mem, &map);
+
+            if (flow_ret != GST_FLOW_OK)
+                break;
+        }
+    }
+
+    /* A truncated message must never be completed, the peer would take it for a whole one.
+     * Resetting the stream keeps the rest of it, and later messages, from being appended. */
+    if (flow_ret != GST_FLOW_OK && sctpenc_pad->message_open) {
+        GST_WARNING_OBJECT(self, "Abandoning incomplete message on stream %u",
+            sctpenc_pad->stream_id);
+        sctpenc_pad->message_open = FALSE;
+        gst_sctp_association_reset_stream(self->sctp_association, sctpenc_pad->stream_id);
+    }
+
+error:
+    if (flow_ret == GST_FLOW_OK) {
+        latency = gst_util_get_timestamp() - start_time;
+        g_mutex_lock(&sctpenc_pad->lock);
+        sctpenc_pad->messages_sent++;
+        sctpenc_pad->send_latency_total += latency;
+        sctpenc_pad->send_latency_max = MAX(sctpenc_pad->send_latency_max, latency);
+        g_mutex_unlock(&sctpenc_pad->lock);
+    }
+
+    gst_buffer_unref(buffer);
+    return flow_ret;
+}
+
+/* Sends data as part of the current message on the pad's stream, the message is completed
+ * when end_of_record is TRUE. Blocks while the send buffer is full. */
+static GstFlowReturn send_message_part(GstSctpEnc *self, GstSctpEncPad *sctpenc_pad,
+    const guint8 *data, gsize size, gboolean end_of_record, guint32 ppid, gboolean ordered,
+    GstSctpAssociationPartialReliability pr, guint32 pr_param)
+{
+    GstFlowReturn flow_ret = GST_FLOW_OK;
+    GstSctpAssociationSendResult send_result;
+    gsize offset = 0;
+
     g_mutex_lock(&sctpenc_pad->lock);
     while (!sctpenc_pad->flushing) {
-        gboolean data_sent = FALSE;
+        guint32 bytes_sent = 0;
+        guint send_ready_seqnum;
 
         g_mutex_unlock(&sctpenc_pad->lock);
 
-        data_sent = gst_sctp_association_send_data(self->sctp_association, map.data,
-                    map.size, sctpenc_pad->stream_id, ppid, ordered, pr, pr_param);
+        GST_OBJECT_LOCK(self);
+        send_ready_seqnum = self->send_ready_seqnum;
+        GST_OBJECT_UNLOCK(self);
+
+        send_result = gst_sctp_association_send_data(self->sctp_association, data + offset,
+                    (guint32)(size - offset), sctpenc_pad->stream_id, ppid, ordered, pr, pr_param,
+                    end_of_record, &bytes_sent);
 
         g_mutex_lock(&sctpenc_pad->lock);
-        if (data_sent) {
-            sctpenc_pad->bytes_sent += map.size;
+        if (send_result == GST_SCTP_ASSOCIATION_SEND_OK) {
+            sctpenc_pad->bytes_sent += bytes_sent;
+            if (bytes_sent > 0)
+                record_buffered(self, sctpenc_pad, bytes_sent);
+            offset += bytes_sent;
+            sctpenc_pad->message_open = offset < size || !end_of_record;
+            if (offset >= size)
+                break;
+        } else if (send_result == GST_SCTP_ASSOCIATION_SEND_ERROR) {
+            /* Nothing will wake us up again */
+            flow_ret = GST_FLOW_ERROR;
             break;
         } else if (!sctpenc_pad->flushing) {
-            gint64 end_time = g_get_monotonic_time() + BUFFER_FULL_SLEEP_TIME;
-
-            /* The buffer was probably full. Retry in a while */
+            /* The buffer is full or the association is not up yet. Wait until the association
+             * reports that we can send again, unless it already did while we were sending */
             GST_OBJECT_LOCK(self);
+            if (self->send_ready_seqnum != send_ready_seqnum) {
+                GST_OBJECT_UNLOCK(self);
+                continue;
+            }
             g_queue_push_tail(&self->pending_pads, sctpenc_pad);
             GST_OBJECT_UNLOCK(self);
 
-            g_cond_wait_until(&sctpenc_pad->cond, &sctpenc_pad->lock, end_time);
+            sctpenc_pad->bytes_queued = size - offset;
+            g_cond_wait(&sctpenc_pad->cond, &sctpenc_pad->lock);
 
             GST_OBJECT_LOCK(self);
             g_queue_remove(&self->pending_pads, sctpenc_pad);
             GST_OBJECT_UNLOCK(self);
         }
     }
-    flow_ret = sctpenc_pad->flushing ? GST_FLOW_FLUSHING : GST_FLOW_OK;
+    sctpenc_pad->bytes_queued = 0;
+    if (sctpenc_pad->flushing)
+        flow_ret = GST_FLOW_FLUSHING;
     g_mutex_unlock(&sctpenc_pad->lock);
 
-    gst_buffer_unmap(buffer, &map);
-error:
-    gst_buffer_unref(buffer);
+    if (flow_ret == GST_FLOW_ERROR) {
+        GST_ELEMENT_ERROR(self, RESOURCE, WRITE, (NULL),
+            ("Could not send data on SCTP stream %u", sctpenc_pad->stream_id));
+    }
+
+    /* The data may already have been acknowledged before it was recorded above */
+    release_buffered(self);
+
     return flow_ret;
 }
 
 static gboolean gst_sctp_enc_sink_event(GstPad *pad, GstObject *parent, GstEvent *event)
 {
     GstSctpEncPad *sctpenc_pad = GST_SCTP_ENC_PAD(pad);
-    gboolean ret, is_new_ppid;
+    gboolean ret, is_new_ppid, is_new_priority;
     guint32 new_ppid;
+    guint16 new_priority;
 
     switch (GST_EVENT_TYPE(event)) {
     case GST_EVENT_CAPS: {
@@ -567,9 +1175,11 @@ static gboolean gst_sctp_enc_sink_event(GstPad *pad, GstObject *parent, GstEvent
 
         gst_event_parse_caps(event, &caps);
         get_config_from_caps(caps, &sctpenc_pad->ordered, &sctpenc_pad->reliability,
-            &sctpenc_pad->reliability_param, &new_ppid, &is_new_ppid);
+            &sctpenc_pad->reliability_param, &new_ppid, &is_new_ppid, &new_priority, &is_new_priority);
         if (is_new_ppid)
             sctpenc_pad->ppid = new_ppid;
+        if (is_new_priority)
+            set_pad_priority(GST_SCTP_ENC(parent), sctpenc_pad, new_priority);
         gst_event_unref(event);
         ret = TRUE;
         break;
@@ -687,8 +1297,66 @@ static gboolean configure_association(GstSctpEnc *self)
     g_object_bind_property(self, "use-sock-stream", self->sctp_association, "use-sock-stream",
         G_BINDING_SYNC_CREATE);
 
+    g_object_bind_property(self, "stream-scheduler", self->sctp_association, "stream-scheduler",
+        G_BINDING_SYNC_CREATE);
+
+    g_object_bind_property(self, "max-mtu", self->sctp_association, "max-mtu",
+        G_BINDING_SYNC_CREATE);
+
+    g_object_bind_property(self, "dont-fragment", self->sctp_association, "dont-fragment",
+        G_BINDING_SYNC_CREATE);
+
+    g_object_bind_property(self, "congestion-control", self->sctp_association, "congestion-control",
+        G_BINDING_SYNC_CREATE);
+
+    g_object_bind_property(self, "rto-initial", self->sctp_association, "rto-initial",
+        G_BINDING_SYNC_CREATE);
+
+    g_object_bind_property(self, "rto-min", self->sctp_association, "rto-min",
+        G_BINDING_SYNC_CREATE);
+
+    g_object_bind_property(self, "rto-max", self->sctp_association, "rto-max",
+        G_BINDING_SYNC_CREATE);
+
+    g_object_bind_property(self, "send-buffer-size", self->sctp_association, "send-buffer-size",
+        G_BINDING_SYNC_CREATE);
+
+    g_object_bind_property(self, "receive-buffer-size", self->sctp_association, "receive-buffer-size",
+        G_BINDING_SYNC_CREATE);
+
+    g_object_bind_property(self, "sack-delay", self->sctp_association, "sack-delay",
+        G_BINDING_SYNC_CREATE);
+
+    g_object_bind_property(self, "sack-frequency", self->sctp_association, "sack-frequency",
+        G_BINDING_SYNC_CREATE);
+
+    g_object_bind_property(self, "udp-remote-address", self->sctp_association, "udp-remote-address",
+        G_BINDING_SYNC_CREATE);
+
+    g_object_bind_property(self, "udp-remote-port", self->sctp_association, "udp-remote-port",
+        G_BINDING_SYNC_CREATE);
+
+    g_object_bind_property(self, "udp-local-port", self->sctp_association, "udp-local-port",
+        G_BINDING_SYNC_CREATE);
+
+    g_object_bind_property(self, "compute-checksum", self->sctp_association, "compute-checksum",
+        G_BINDING_SYNC_CREATE);
+
+    g_object_bind_property(self, "stack-idle-timeout", self->sctp_association,
+        "stack-idle-timeout", G_BINDING_SYNC_CREATE);
+    resize_outbound_packet_pool(self, self->max_mtu);
+
+    g_signal_connect_object(self->sctp_association, "notify::mtu",
+        G_CALLBACK(on_sctp_association_mtu_changed), self, 0);
+
+    gst_sctp_association_set_on_ready_to_send(self->sctp_association, on_sctp_ready_to_send, self);
+    gst_sctp_association_set_on_send_buffer_drained(self->sctp_association,
+        on_sctp_send_buffer_drained, self);
     gst_sctp_association_set_on_packet_out(self->sctp_association, on_sctp_packet_out, self);
 
+    if (self->stats_interval > 0)
+        self->stats_clock_id = gst_sctp_stats_start_periodic(GST_ELEMENT(self), self->stats_interval);
+
     return TRUE;
 }
 
@@ -708,6 +1376,8 @@ static void on_sctp_association_state_changed(GstSctpAssociation *sctp_associati
         break;
     case GST_SCTP_ASSOCIATION_STATE_CONNECTED:
         g_signal_emit_by_name(self, "sctp-association-established", TRUE);
+        /* Pads that tried to send before the association was up */
+        wake_pending_pads(self);
         break;
     case GST_SCTP_ASSOCIATION_STATE_DISCONNECTING:
         g_signal_emit(self, signals[SIGNAL_SCTP_ASSOCIATION_ESTABLISHED], 0, FALSE);
@@ -719,25 +1389,56 @@ static void on_sctp_association_state_changed(GstSctpAssociation *sctp_associati
     }
 }
 
+static void on_sctp_association_mtu_changed(GstSctpAssociation *sctp_association, GParamSpec *pspec,
+    GstSctpEnc *self)
+{
+    guint mtu;
+
+    g_object_get(sctp_association, "mtu", &mtu, NULL);
+    GST_INFO_OBJECT(self, "Path MTU is now %u", mtu);
+    g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_MTU]);
+}
+
 static void data_queue_item_free(GstDataQueueItem *item)
 {
+    GstSctpEncQueueItem *queue_item = (GstSctpEncQueueItem *)item;
+
     if (item->object)
         gst_mini_object_unref(item->object);
-    g_free(item);
+    item->object = NULL;
+
+    /* Items are recycled rather than freed, up to a bound. The length is only a hint
+     * with concurrent pushes, which may overshoot the bound by a few items. */
+    if (gst_atomic_queue_length(queue_item->sctpenc->free_queue_items)
+        < OUTBOUND_QUEUE_MAX_FREE_ITEMS)
+        gst_atomic_queue_push(queue_item->sctpenc->free_queue_items, queue_item);
+    else
+        g_free(queue_item);
 }
 
 static void on_sctp_packet_out(GstSctpAssociation *_association, const guint8 *buf, gsize length,
     gpointer user_data)
 {
     GstSctpEnc *self = user_data;
-    GstBuffer *gstbuf;
+    GstBuffer *gstbuf = NULL;
+    GstSctpEncQueueItem *queue_item;
     GstDataQueueItem *item;
-    GList *pending_pads, *l;
-    GstSctpEncPad *sctpenc_pad;
 
-    gstbuf = gst_buffer_new_wrapped(g_memdup(buf, length), length);
+    if (G_LIKELY(self->outbound_packet_pool && length <= self->outbound_packet_size)
+        && gst_buffer_pool_acquire_buffer(self->outbound_packet_pool, &gstbuf, NULL) == GST_FLOW_OK) {
+        gst_buffer_fill(gstbuf, 0, buf, length);
+        gst_buffer_set_size(gstbuf, length);
+    } else {
+        gstbuf = gst_buffer_new_wrapped(g_memdup(buf, length), length);
+    }
+
+    queue_item = gst_atomic_queue_pop(self->free_queue_items);
+    if (G_UNLIKELY(!queue_item)) {
+        queue_item = g_new0(GstSctpEncQueueItem, 1);
+        queue_item->sctpenc = self;
+    }
 
-    item = g_new0(GstDataQueueItem, 1);
+    item = &queue_item->item;
     item->object = GST_MINI_OBJECT(gstbuf);
     item->size = length;
     item->visible = TRUE;
@@ -747,9 +1448,22 @@ static void on_sctp_packet_out(GstSctpAssociation *_association, const guint8 *b
         item->destroy(item);
         GST_DEBUG_OBJECT(self, "Failed to push item because we're flushing");
     }
+}
+
+/* Made from within usrsctp, so the pads are only woken up to send from their own threads */
+static void on_sctp_ready_to_send(GstSctpAssociation *_association, gpointer user_data)
+{
+    wake_pending_pads(GST_SCTP_ENC(user_data));
+}
+
+static void wake_pending_pads(GstSctpEnc *self)
+{
+    GList *pending_pads, *l;
+    GstSctpEncPad *sctpenc_pad;
 
     /* Wake up pads in the order they waited, oldest pad first */
     GST_OBJECT_LOCK(self);
+    self->send_ready_seqnum++;
     pending_pads = NULL;
     while ((sctpenc_pad = g_queue_pop_tail(&self->pending_pads))) {
         pending_pads = g_list_prepend(pending_pads, sctpenc_pad);
@@ -765,6 +1479,193 @@ static void on_sctp_packet_out(GstSctpAssociation *_association, const guint8 *b
     g_list_free(pending_pads);
 }
 
+static void on_sctp_send_buffer_drained(GstSctpAssociation *_association, guint32 bytes_drained,
+    gpointer user_data)
+{
+    GstSctpEnc *self = GST_SCTP_ENC(user_data);
+
+    g_mutex_lock(&self->buffered_lock);
+    self->bytes_drained = bytes_drained;
+    g_mutex_unlock(&self->buffered_lock);
+
+    release_buffered(self);
+}
+
+/* Called with the pad lock held, after the association accepted the bytes */
+static void record_buffered(GstSctpEnc *self, GstSctpEncPad *sctpenc_pad, guint32 bytes)
+{
+    BufferedRecord *record;
+
+    sctpenc_pad->buffered_amount += bytes;
+
+    record = g_slice_new(BufferedRecord);
+    record->sctpenc_pad = gst_object_ref(sctpenc_pad);
+    record->bytes = bytes;
+    record->priority = sctpenc_pad->priority;
+
+    g_mutex_lock(&self->buffered_lock);
+    g_queue_push_tail(&self->buffered_records, record);
+    g_mutex_unlock(&self->buffered_lock);
+}
+
+static void free_buffered_record(BufferedRecord *record)
+{
+    gst_object_unref(record->sctpenc_pad);
+    g_slice_free(BufferedRecord, record);
+}
+
+/* usrsctp only accounts for the send buffer of the association as a whole. The bytes that
+ * have left it are shared out to the streams the way the stream scheduler serves them, and
+ * within a stream the oldest bytes are released first. */
+static void release_buffered(GstSctpEnc *self)
+{
+    GQueue released = G_QUEUE_INIT;
+    BufferedRecord *record;
+    GstSctpEncPad *sctpenc_pad;
+    guint32 pending;
+    gboolean was_above, is_low;
+    guint stream_id;
+
+    g_mutex_lock(&self->buffered_lock);
+    pending = self->bytes_drained - self->bytes_released;
+    if (pending > 0 && !g_queue_is_empty(&self->buffered_records)) {
+        if (self->stream_scheduler == GST_SCTP_ASSOCIATION_STREAM_SCHEDULER_FIRST_COME)
+            self->bytes_released += take_buffered(self, NULL, pending, &released);
+        else
+            self->bytes_released += take_buffered_per_stream(self, pending, &released);
+    }
+    g_mutex_unlock(&self->buffered_lock);
+
+    while ((record = g_queue_pop_head(&released))) {
+        sctpenc_pad = record->sctpenc_pad;
+
+        g_mutex_lock(&sctpenc_pad->lock);
+        was_above = sctpenc_pad->buffered_amount > sctpenc_pad->buffered_amount_low_threshold;
+        sctpenc_pad->buffered_amount -= MIN(record->bytes, sctpenc_pad->buffered_amount);
+        is_low = sctpenc_pad->buffered_amount <= sctpenc_pad->buffered_amount_low_threshold;
+        stream_id = sctpenc_pad->stream_id;
+        g_mutex_unlock(&sctpenc_pad->lock);
+
+        if (was_above && is_low && GST_PAD_PARENT(sctpenc_pad))
+            g_signal_emit(self, signals[SIGNAL_BUFFERED_AMOUNT_LOW], 0, stream_id);
+
+        free_buffered_record(record);
+    }
+}
+
+/* Takes up to bytes from the records of sctpenc_pad, or of any pad if it is NULL, oldest
+ * first. Called with the buffered lock held. */
+static guint32 take_buffered(GstSctpEnc *self, GstSctpEncPad *sctpenc_pad, guint32 bytes,
+    GQueue *released)
+{
+    BufferedRecord *record, *part;
+    GList *l, *next;
+    guint32 taken = 0;
+
+    for (l = self->buffered_records.head; l && taken < bytes; l = next) {
+        next = l->next;
+        record = l->data;
+        if (sctpenc_pad && record->sctpenc_pad != sctpenc_pad)
+            continue;
+
+        if (record->bytes <= bytes - taken) {
+            g_queue_delete_link(&self->buffered_records, l);
+        } else {
+            part = g_slice_new(BufferedRecord);
+            part->sctpenc_pad = gst_object_ref(record->sctpenc_pad);
+            part->bytes = bytes - taken;
+            part->priority = record->priority;
+            record->bytes -= part->bytes;
+            record = part;
+        }
+        taken += record->bytes;
+        g_queue_push_tail(released, record);
+    }
+    return taken;
+}
+
+static gint compare_buffered_share_priority(const BufferedShare *a, const BufferedShare *b)
+{
+    if (a->priority != b->priority)
+        return a->priority < b->priority ? -1 : 1;
+    return a->order < b->order ? -1 : a->order > b->order;
+}
+
+/* The priority scheduler empties the streams with the lowest value first. The others serve
+ * every stream with data in turn, which is taken as an even share of the drained bytes, as
+ * usrsctp does not tell how much each stream sent. Called with the buffered lock held. */
+static guint32 take_buffered_per_stream(GstSctpEnc *self, guint32 bytes, GQueue *released)
+{
+    GArray *shares;
+    BufferedShare *share;
+    BufferedRecord *record;
+    GList *l;
+    guint32 pending = bytes, quantum, part, taken = 0;
+    guint i, n_active;
+
+    /* Pads in the order of their oldest data */
+    shares = g_array_new(FALSE, TRUE, sizeof(BufferedShare));
+    for (l = self->buffered_records.head; l; l = l->next) {
+        record = l->data;
+        for (i = 0; i < shares->len; i++) {
+            if (g_array_index(shares, BufferedShare, i).sctpenc_pad == record->sctpenc_pad)
+                break;
+        }
+        if (i == shares->len) {
+            g_array_set_size(shares, i + 1);
+            g_array_index(shares, BufferedShare, i).sctpenc_pad = record->sctpenc_pad;
+            g_array_index(shares, BufferedShare, i).order = i;
+        }
+        share = &g_array_index(shares, BufferedShare, i);
+        share->outstanding += record->bytes;
+        share->priority = record->priority;
+    }
+
+    if (self->stream_scheduler == GST_SCTP_ASSOCIATION_STREAM_SCHEDULER_PRIORITY) {
+        g_array_sort(shares, (GCompareFunc)compare_buffered_share_priority);
+        for (i = 0; i < shares->len && pending > 0; i++) {
+            share = &g_array_index(shares, BufferedShare, i);
+            share->share = MIN(share->outstanding, pending);
+            pending -= share->share;
+        }
+    } else {
+        n_active = shares->len;
+        while (pending > 0 && n_active > 0) {
+            quantum = MAX(pending / n_active, 1);
+            n_active = 0;
+            for (i = 0; i < shares->len && pending > 0; i++) {
+                share = &g_array_index(shares, BufferedShare, i);
+                part = MIN(MIN(quantum, share->outstanding - share->share), pending);
+                share->share += part;
+                pending -= part;
+                if (share->share < share->outstanding)
+                    n_active++;
+            }
+        }
+    }
+
+    for (i = 0; i < shares->len; i++) {
+        share = &g_array_index(shares, BufferedShare, i);
+        if (share->share > 0)
+            taken += take_buffered(self, share->sctpenc_pad, share->share, released);
+    }
+    g_array_free(shares, TRUE);
+
+    return taken;
+}
+
+static void clear_buffered_records(GstSctpEnc *self)
+{
+    BufferedRecord *record;
+
+    g_mutex_lock(&self->buffered_lock);
+    while ((record = g_queue_pop_head(&self->buffered_records)))
+        free_buffered_record(record);
+    self->bytes_drained = 0;
+    self->bytes_released = 0;
+    g_mutex_unlock(&self->buffered_lock);
+}
+
 static void stop_srcpad_task(GstPad *pad, GstSctpEnc *self)
 {
     gst_data_queue_set_flushing(self->outbound_sctp_packet_queue, TRUE);
@@ -782,24 +1683,36 @@ static void remove_sinkpad(const GValue *item, gpointer user_data)
 
 static void sctpenc_cleanup(GstSctpEnc *self)
 {
+    GstSctpAssociation *sctp_association;
     GstIterator *it;
 
+    if (self->stats_clock_id) {
+        gst_sctp_stats_stop_periodic(self->stats_clock_id);
+        self->stats_clock_id = NULL;
+    }
+
     g_signal_handler_disconnect(self->sctp_association, self->signal_handler_state_changed);
     stop_srcpad_task(self->src_pad, self);
     gst_sctp_association_force_close(self->sctp_association);
-    g_object_unref(self->sctp_association);
+
+    /* The stats property may be read from another thread */
+    GST_OBJECT_LOCK(self);
+    sctp_association = self->sctp_association;
     self->sctp_association = NULL;
+    GST_OBJECT_UNLOCK(self);
+    g_object_unref(sctp_association);
 
     it = gst_element_iterate_sink_pads(GST_ELEMENT(self));
     while (gst_iterator_foreach(it, remove_sinkpad, self) == GST_ITERATOR_RESYNC)
         gst_iterator_resync(it);
     gst_iterator_free(it);
     g_queue_clear(&self->pending_pads);
+    clear_buffered_records(self);
 }
 
 static void get_config_from_caps(const GstCaps *caps, gboolean *ordered,
     GstSctpAssociationPartialReliability *reliability, guint32 *reliability_param, guint32 *ppid,
-    gboolean *ppid_available)
+    gboolean *ppid_available, guint16 *priority, gboolean *priority_available)
 {
     GstStructure *s;
     guint i, n;
@@ -808,6 +1721,7 @@ static void get_config_from_caps(const GstCaps *caps, gboolean *ordered,
     *reliability = GST_SCTP_ASSOCIATION_PARTIAL_RELIABILITY_NONE;
     *reliability_param = 0;
     *ppid_available = FALSE;
+    *priority_available = FALSE;
 
     if (!caps)
       return;
@@ -841,6 +1755,11 @@ static void get_config_from_caps(const GstCaps *caps, gboolean *ordered,
             *ppid = g_value_get_uint(v);
             *ppid_available = TRUE;
         }
+        if (gst_structure_has_field(s, "priority")) {
+            const GValue *v = gst_structure_get_value(s, "priority");
+            *priority = (guint16)MIN(g_value_get_uint(v), G_MAXUINT16);
+            *priority_available = TRUE;
+        }
     }
 }
 
@@ -870,3 +1789,79 @@ static guint64 on_get_stream_bytes_sent(GstSctpEnc *self, guint stream_id)
 
     return bytes_sent;
 }
+
+typedef struct {
+    GstSctpAssociation *sctp_association;
+    GValue streams;
+} StatsContext;
+
+static void add_stream_stats(const GValue *item, gpointer user_data)
+{
+    GstSctpEncPad *sctpenc_pad = g_value_get_object(item);
+    StatsContext *context = user_data;
+    GstStructure *stream_stats;
+    GValue value = G_VALUE_INIT;
+    guint abandoned = 0;
+
+    if (context->sctp_association) {
+        abandoned = gst_sctp_association_get_abandoned_messages(context->sctp_association,
+            sctpenc_pad->stream_id);
+    }
+
+    g_mutex_lock(&sctpenc_pad->lock);
+    stream_stats = gst_structure_new("sctp-stream-stats",
+        "stream-id", G_TYPE_UINT, (guint)sctpenc_pad->stream_id,
+        "bytes-sent", G_TYPE_UINT64, sctpenc_pad->bytes_sent,
+        "messages-sent", G_TYPE_UINT64, sctpenc_pad->messages_sent,
+        "messages-abandoned", G_TYPE_UINT, abandoned,
+        "bytes-queued", G_TYPE_UINT64, sctpenc_pad->bytes_queued,
+        "buffered-amount", G_TYPE_UINT64, sctpenc_pad->buffered_amount,
+        "send-latency-avg", G_TYPE_UINT64, sctpenc_pad->messages_sent ?
+            sctpenc_pad->send_latency_total / sctpenc_pad->messages_sent : (GstClockTime)0,
+        "send-latency-max", G_TYPE_UINT64, sctpenc_pad->send_latency_max,
+        NULL);
+    g_mutex_unlock(&sctpenc_pad->lock);
+
+    g_value_init(&value, GST_TYPE_STRUCTURE);
+    g_value_take_boxed(&value, stream_stats);
+    gst_value_array_append_and_take_value(&context->streams, &value);
+}
+
+static GstStructure *get_stats(GstSctpEnc *self)
+{
+    StatsContext context = { NULL, G_VALUE_INIT };
+    GstStructure *stats;
+    GstIterator *it;
+
+    GST_OBJECT_LOCK(self);
+    if (self->sctp_association)
+        context.sctp_association = g_object_ref(self->sctp_association);
+    GST_OBJECT_UNLOCK(self);
+
+    stats = gst_sctp_stats_new(context.sctp_association);
+
+    g_value_init(&context.streams, GST_TYPE_ARRAY);
+    it = gst_element_iterate_sink_pads(GST_ELEMENT(self));
+    while (gst_iterator_foreach(it, add_stream_stats, &context) == GST_ITERATOR_RESYNC) {
+        g_value_unset(&context.streams);
+        g_value_init(&context.streams, GST_TYPE_ARRAY);
+        gst_iterator_resync(it);
+    }
+    gst_iterator_free(it);
+    gst_structure_take_value(stats, "streams", &context.streams);
+
+    if (context.sctp_association)
+        g_object_unref(context.sctp_association);
+
+    return stats;
+}
+
+static void set_pad_priority(GstSctpEnc *self, GstSctpEncPad *sctpenc_pad, guint16 priority)
+{
+    if (sctpenc_pad->priority == priority)
+        return;
+
+    if (gst_sctp_association_set_stream_priority(self->sctp_association, sctpenc_pad->stream_id,
+        priority))
+        sctpenc_pad->priority = priority;
+}
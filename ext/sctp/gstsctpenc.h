@@ -50,11 +50,41 @@ struct _GstSctpEnc {
     guint32 sctp_association_id;
     guint16 remote_sctp_port;
     gboolean use_sock_stream;
+    GstSctpAssociationStreamScheduler stream_scheduler;
+    guint max_mtu;
+    gboolean dont_fragment;
+    GstSctpAssociationCongestionControl congestion_control;
+    guint rto_initial;
+    guint rto_min;
+    guint rto_max;
+    guint send_buffer_size;
+    guint receive_buffer_size;
+    guint sack_delay;
+    guint sack_frequency;
+    gboolean compute_checksum;
+    guint stack_idle_timeout;
+    gchar *udp_remote_address;
+    guint udp_remote_port;
+    guint udp_local_port;
+    guint stats_interval;
+    GstClockID stats_clock_id;
 
     GstSctpAssociation *sctp_association;
     GstDataQueue *outbound_sctp_packet_queue;
+    GstBufferPool *outbound_packet_pool;
+    guint outbound_packet_size;
+    GstAtomicQueue *free_queue_items;
 
     GQueue pending_pads;
+    guint send_ready_seqnum;
+
+    /* Data accepted by the association that has not yet been released from the
+     * buffered-amount of its pad, oldest first. Drained bytes are shared out per
+     * stream, see release_buffered(). The byte counts wrap around */
+    GMutex buffered_lock;
+    GQueue buffered_records;
+    guint32 bytes_drained;
+    guint32 bytes_released;
 
     gulong signal_handler_state_changed;
 };
@@ -64,6 +94,7 @@ struct _GstSctpEncClass {
 
     void (*on_sctp_association_is_established)(GstSctpEnc *sctp_enc, gboolean established);
     guint64 (*on_get_stream_bytes_sent)(GstSctpEnc *sctp_enc, guint stream_id);
+    void (*on_buffered_amount_low)(GstSctpEnc *sctp_enc, guint stream_id);
 
 };
 
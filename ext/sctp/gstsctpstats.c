@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2015, Ericsson AB. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "gstsctpstats.h"
+
+static gboolean on_stats_timeout(GstClock *clock, GstClockTime time, GstClockID id,
+    gpointer user_data);
+
+GstStructure *gst_sctp_stats_new(GstSctpAssociation *association)
+{
+    GstSctpAssociationStats stats;
+
+    if (!association || !gst_sctp_association_get_stats(association, &stats))
+        return gst_structure_new_empty("sctp-stats");
+
+    return gst_structure_new("sctp-stats",
+        "cwnd", G_TYPE_UINT, stats.cwnd,
+        "peer-rwnd", G_TYPE_UINT, stats.peer_rwnd,
+        "srtt", G_TYPE_UINT64, stats.srtt * GST_MSECOND,
+        "rto", G_TYPE_UINT64, stats.rto * GST_MSECOND,
+        "mtu", G_TYPE_UINT, stats.mtu,
+        "unacked-chunks", G_TYPE_UINT, stats.unacked_chunks,
+        "pending-chunks", G_TYPE_UINT, stats.pending_chunks,
+        "send-buffer-used", G_TYPE_UINT, stats.send_buffer_used,
+        "abandoned-messages", G_TYPE_UINT64, stats.abandoned_messages,
+        "udp-dropped-packets", G_TYPE_UINT64, stats.udp_dropped_packets,
+        "stack-retransmissions", G_TYPE_UINT64, stats.stack_retransmissions,
+        NULL);
+}
+
+GstClockID gst_sctp_stats_start_periodic(GstElement *element, guint interval_ms)
+{
+    GstClock *clock;
+    GstClockID clock_id;
+    GstClockTime interval = interval_ms * GST_MSECOND;
+
+    /* The system clock keeps ticking whatever state the pipeline is in */
+    clock = gst_system_clock_obtain();
+    clock_id = gst_clock_new_periodic_id(clock, gst_clock_get_time(clock) + interval, interval);
+    gst_object_unref(clock);
+
+    if (gst_clock_id_wait_async(clock_id, on_stats_timeout, gst_object_ref(element),
+        (GDestroyNotify)gst_object_unref) != GST_CLOCK_OK) {
+        GST_WARNING_OBJECT(element, "Could not schedule the statistics messages");
+        gst_clock_id_unref(clock_id);
+        return NULL;
+    }
+
+    return clock_id;
+}
+
+void gst_sctp_stats_stop_periodic(GstClockID clock_id)
+{
+    gst_clock_id_unschedule(clock_id);
+    gst_clock_id_unref(clock_id);
+}
+
+static gboolean on_stats_timeout(GstClock *clock, GstClockTime time, GstClockID id,
+    gpointer user_data)
+{
+    GstElement *element = user_data;
+    GstStructure *stats = NULL;
+
+    g_object_get(element, "stats", &stats, NULL);
+    if (stats)
+        gst_element_post_message(element, gst_message_new_element(GST_OBJECT(element), stats));
+
+    return TRUE;
+}
@@ -28,6 +28,8 @@
 #endif
 
 #include "sctpassociation.h"
+#include "sctpcrc32c.h"
+#include "sctppmtuprobe.h"
 
 #include <string.h>
 #include <errno.h>
@@ -58,6 +60,48 @@ static GType gst_sctp_association_state_get_type(void)
     return id;
 }
 
+GType gst_sctp_association_stream_scheduler_get_type(void)
+{
+    static const GEnumValue values[] = {
+        {GST_SCTP_ASSOCIATION_STREAM_SCHEDULER_DEFAULT, "Default (first come, first served)", "default"},
+        {GST_SCTP_ASSOCIATION_STREAM_SCHEDULER_ROUND_ROBIN, "Round robin between streams", "round-robin"},
+        {GST_SCTP_ASSOCIATION_STREAM_SCHEDULER_ROUND_ROBIN_PACKET, "Round robin between streams, per packet", "round-robin-packet"},
+        {GST_SCTP_ASSOCIATION_STREAM_SCHEDULER_PRIORITY, "Strict stream priority", "priority"},
+        {GST_SCTP_ASSOCIATION_STREAM_SCHEDULER_FAIR_BANDWIDTH, "Fair bandwidth between streams", "fair-bandwidth"},
+        {GST_SCTP_ASSOCIATION_STREAM_SCHEDULER_FIRST_COME, "First come, first served across streams", "first-come"},
+        {0, NULL, NULL}
+        };
+    static volatile GType id = 0;
+
+    if (g_once_init_enter((gsize *) & id)) {
+        GType _id;
+        _id = g_enum_register_static("GstSctpAssociationStreamScheduler", values);
+        g_once_init_leave((gsize *) & id, _id);
+    }
+
+    return id;
+}
+
+GType gst_sctp_association_congestion_control_get_type(void)
+{
+    static const GEnumValue values[] = {
+        {GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_RFC4960, "Standard SCTP congestion control (RFC 4960)", "rfc4960"},
+        {GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_HSTCP, "High Speed TCP (RFC 3649)", "hstcp"},
+        {GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_HTCP, "H-TCP", "htcp"},
+        {GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_RTCC, "RTT based congestion control", "rtcc"},
+        {0, NULL, NULL}
+        };
+    static volatile GType id = 0;
+
+    if (g_once_init_enter((gsize *) & id)) {
+        GType _id;
+        _id = g_enum_register_static("GstSctpAssociationCongestionControl", values);
+        g_once_init_leave((gsize *) & id, _id);
+    }
+
+    return id;
+}
+
 G_DEFINE_TYPE(GstSctpAssociation, gst_sctp_association, G_TYPE_OBJECT);
 
 enum
@@ -75,6 +119,25 @@ enum {
     PROP_REMOTE_PORT,
     PROP_STATE,
     PROP_USE_SOCK_STREAM,
+    PROP_STREAM_SCHEDULER,
+    PROP_PARTIAL_DELIVERY,
+    PROP_MAX_MTU,
+    PROP_MTU,
+    PROP_DONT_FRAGMENT,
+    PROP_CONGESTION_CONTROL,
+    PROP_RTO_INITIAL,
+    PROP_RTO_MIN,
+    PROP_RTO_MAX,
+    PROP_SEND_BUFFER_SIZE,
+    PROP_RECEIVE_BUFFER_SIZE,
+    PROP_SACK_DELAY,
+    PROP_SACK_FREQUENCY,
+    PROP_UDP_REMOTE_ADDRESS,
+    PROP_UDP_REMOTE_PORT,
+    PROP_UDP_LOCAL_PORT,
+    PROP_COMPUTE_CHECKSUM,
+    PROP_VERIFY_CHECKSUM,
+    PROP_STACK_IDLE_TIMEOUT,
 
     NUM_PROPERTIES
 };
@@ -85,10 +148,53 @@ static GParamSpec *properties[NUM_PROPERTIES];
 #define MAX_SCTP_SID UINT16_MAX
 #define DEFAULT_LOCAL_SCTP_PORT 0
 #define DEFAULT_REMOTE_SCTP_PORT 0
-
-static GHashTable *associations = NULL;
+#define RECEIVE_BUFFER_SIZE 65536
+/* RFC 4960 section 6.2 */
+#define MAX_SACK_DELAY 500
+/* Receive buffers of the UDP transport hold at least an Ethernet MTU worth of packet */
+#define MIN_UDP_PACKET_SIZE 1500
+/* Seconds the usrsctp stack is kept after the last association is gone */
+#define DEFAULT_STACK_IDLE_TIMEOUT 30
+/* Partially read messages are kept per stream and ordering, as I-DATA lets them interleave */
+#define PARTIAL_MESSAGE_KEY(sid, unordered) GUINT_TO_POINTER((sid) | ((unordered) ? 0x10000 : 0))
+#define PARTIAL_NOTIFICATION_KEY GUINT_TO_POINTER(0x20000)
+
+/* draft-ietf-rtcweb-data-channel-13 section 5: max initial MTU IPV4 1200, IPV6 1280.
+ * 1200 is safe for either and is where path MTU discovery starts from. */
+#define PMTU_BASE 1200
+#define DEFAULT_MAX_MTU PMTU_BASE
+#define PMTU_MAX_PROBES 3
+#define PMTU_PROBE_TIMEOUT G_USEC_PER_SEC
+#define PMTU_RAISE_INTERVAL (600 * G_USEC_PER_SEC)
+/* Probe sizes are multiples of 4 so the PAD chunk needs no padding of its own */
+#define PMTU_ALIGN(size) ((size) & ~3u)
+#define SCTP_COMMON_HEADER_LENGTH 12
+#define SCTP_CHUNK_ABORT 6
+
+/* The registry is sharded by association id so that looking up or creating one association
+ * does not contend with the others */
+#define ASSOCIATION_SHARDS 64
+
+typedef struct {
+    GWeakRef ref;
+    gpointer association;
+} AssociationEntry;
+
+typedef struct {
+    GMutex lock;
+    GHashTable *associations;
+} AssociationShard;
+
+static AssociationShard association_shards[ASSOCIATION_SHARDS];
+/* Only taken when an association is created or destroyed, and guards the worker below */
+static guint usrsctp_users = 0;
 static gboolean initialized = FALSE;
-G_LOCK_DEFINE_STATIC(associations_lock);
+G_LOCK_DEFINE_STATIC(usrsctp_lock);
+
+/* One thread shared by all associations runs their connects and the idle teardown of the
+ * usrsctp stack */
+static GMainContext *worker_context = NULL;
+static GSource *stack_teardown_source = NULL;
 
 /* Interface implementations */
 static void gst_sctp_association_finalize(GObject *object);
@@ -98,22 +204,48 @@ static void gst_sctp_association_get_property(GObject *object, guint prop_id, GV
     GParamSpec *pspec);
 
 static struct socket * create_sctp_socket(GstSctpAssociation *gst_sctp_association);
+static void apply_transport_parameters(GstSctpAssociation *self, struct socket *sock);
 static struct sockaddr_conn get_sctp_socket_address(GstSctpAssociation *gst_sctp_association,
     guint16 port);
-static gpointer connection_thread_func(GstSctpAssociation *self);
+static GMainContext *get_worker_context(void);
+static gpointer worker_thread_func(GMainLoop *loop);
+static gboolean connect_on_worker(GstSctpAssociation *self);
+static gboolean stack_idle_teardown(gpointer user_data);
+static void finish_stack(void);
 static gboolean client_role_connect(GstSctpAssociation *self);
 static int sctp_packet_out(void *addr, void* buffer, size_t length, guint8 tos, guint8 set_df);
-static int receive_cb(struct socket *sock, union sctp_sockstore addr, void *data, size_t datalen,
-    struct sctp_rcvinfo rcv_info, gint flags, void *ulp_info);
+static void socket_upcall(struct socket *sock, void *arg, gint flags);
+static void receive_pending_data(GstSctpAssociation *self);
+static void schedule_receive(GstSctpAssociation *self);
+static gboolean receive_on_worker(GstSctpAssociation *self);
+static gboolean receive_one(GstSctpAssociation *self);
+static void notify_ready_to_send(GstSctpAssociation *self);
 static void handle_notification(GstSctpAssociation *self, const union sctp_notification *notification,
     size_t length);
 static void handle_association_changed(GstSctpAssociation *self, const struct sctp_assoc_change *sac);
 static void handle_stream_reset_event(GstSctpAssociation *self,
     const struct sctp_stream_reset_event *ssr);
+static void handle_partial_delivery_event(GstSctpAssociation *self,
+    const struct sctp_pdapi_event *pdapi);
+static void handle_send_failed(GstSctpAssociation *self, const struct sctp_send_failed *ssf);
 static void handle_message(GstSctpAssociation *self, guint8 *data, guint32 datalen, guint16 stream_id,
-    guint32 ppid);
+    guint32 ppid, GstSctpAssociationMessageFlags flags);
+
+static gboolean set_path_mtu(GstSctpAssociation *self, guint mtu);
+static void pmtu_probe_tick(GstSctpAssociation *self, guint acked_size, guint32 acked_seq);
+static gboolean pmtu_probe_timeout(GstSctpAssociation *self);
+static void start_pmtu_probe_timer(GstSctpAssociation *self);
+static void send_pmtu_probe(GstSctpAssociation *self, guint size, guint32 seq);
+static void record_peer_vtag(GstSctpAssociation *self, const guint8 *buf, size_t length);
+static void report_send_buffer_drained(GstSctpAssociation *self);
+static void schedule_send_buffer_report(GstSctpAssociation *self);
+static gboolean report_send_buffer_on_worker(GstSctpAssociation *self);
+static void check_message_interleaving(GstSctpAssociation *self);
+static void output_packet(GstSctpAssociation *self, guint8 *buf, gsize length);
+static void on_udp_packet(guint8 *data, gsize length, GstSctpAssociation *self);
 
 static void maybe_set_state_to_ready(GstSctpAssociation *self);
+static void free_association_entry(AssociationEntry *entry);
 static void gst_sctp_association_change_state(GstSctpAssociation *self, GstSctpAssociationState new_state,
     gboolean notify);
 
@@ -152,12 +284,112 @@ static void gst_sctp_association_class_init (GstSctpAssociationClass *klass)
         "When TRUE the partial reliability parameters of the channel is ignored.",
         FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
+    properties[PROP_STREAM_SCHEDULER] = g_param_spec_enum("stream-scheduler", "Stream scheduler",
+        "How the association shares the send capacity between streams. Applied when the "
+        "association is started.", GST_SCTP_TYPE_ASSOCIATION_STREAM_SCHEDULER,
+        GST_SCTP_ASSOCIATION_STREAM_SCHEDULER_DEFAULT, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_PARTIAL_DELIVERY] = g_param_spec_boolean("partial-delivery", "Partial delivery",
+        "When set to TRUE, large messages are handed to the receiver in parts as they arrive "
+        "instead of being reassembled first. Cannot be changed once the association is started.",
+        FALSE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_MAX_MTU] = g_param_spec_uint("max-mtu", "Max MTU",
+        "The largest SCTP packet size path MTU discovery probes for. Discovery starts at "
+        "the safe 1200 bytes, the default disables probing. Probing also needs a transport "
+        "that does not fragment, see dont-fragment. Applied when the association is started.",
+        PMTU_BASE, G_MAXUINT16, DEFAULT_MAX_MTU,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_MTU] = g_param_spec_uint("mtu", "MTU",
+        "The SCTP packet size currently used on the path", 0, G_MAXUINT16, PMTU_BASE,
+        G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_DONT_FRAGMENT] = g_param_spec_boolean("dont-fragment", "Don't fragment",
+        "Set when the transport the packets are handed to drops packets larger than the path "
+        "MTU instead of fragmenting them, so that path MTU probes are meaningful. The UDP "
+        "transport decides this itself, from whether its socket could set the don't fragment "
+        "bit. Applied when the association is started.", FALSE,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    /* The transport parameters below are applied when the association is started. 0 keeps
+     * the usrsctp default. */
+    properties[PROP_CONGESTION_CONTROL] = g_param_spec_enum("congestion-control",
+        "Congestion control", "The congestion control module used by the association",
+        GST_SCTP_TYPE_ASSOCIATION_CONGESTION_CONTROL, GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_RFC4960,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_RTO_INITIAL] = g_param_spec_uint("rto-initial", "RTO initial",
+        "Initial retransmission timeout in milliseconds (0 = default)", 0, G_MAXUINT, 0,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_RTO_MIN] = g_param_spec_uint("rto-min", "RTO min",
+        "Minimum retransmission timeout in milliseconds (0 = default)", 0, G_MAXUINT, 0,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_RTO_MAX] = g_param_spec_uint("rto-max", "RTO max",
+        "Maximum retransmission timeout in milliseconds (0 = default)", 0, G_MAXUINT, 0,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_SEND_BUFFER_SIZE] = g_param_spec_uint("send-buffer-size", "Send buffer size",
+        "Size of the socket send buffer in bytes (0 = default)", 0, G_MAXINT, 0,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_RECEIVE_BUFFER_SIZE] = g_param_spec_uint("receive-buffer-size",
+        "Receive buffer size", "Size of the socket receive buffer in bytes, which bounds the "
+        "advertised receive window (0 = default)", 0, G_MAXINT, 0,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_SACK_DELAY] = g_param_spec_uint("sack-delay", "SACK delay",
+        "Delayed acknowledgement timer in milliseconds (0 = default)", 0, MAX_SACK_DELAY, 0,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_SACK_FREQUENCY] = g_param_spec_uint("sack-frequency", "SACK frequency",
+        "Number of packets received before a SACK is sent without waiting for the timer, "
+        "1 disables delayed acknowledgements (0 = default)", 0, G_MAXUINT16, 0,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_UDP_REMOTE_ADDRESS] = g_param_spec_string("udp-remote-address",
+        "UDP remote address", "When set, SCTP packets are sent over UDP (RFC 6951) to this "
+        "host on udp-remote-port instead of being handed to the pipeline. Applied when the "
+        "association is started.", NULL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_UDP_REMOTE_PORT] = g_param_spec_uint("udp-remote-port", "UDP remote port",
+        "The UDP port of the peer, see udp-remote-address", 0, G_MAXUINT16, 0,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_UDP_LOCAL_PORT] = g_param_spec_uint("udp-local-port", "UDP local port",
+        "The local UDP port, see udp-remote-address (0 = any)", 0, G_MAXUINT16, 0,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_COMPUTE_CHECKSUM] = g_param_spec_boolean("compute-checksum",
+        "Compute checksum", "Fill in the CRC32c checksum of outgoing packets. Only disable "
+        "when the peer does not verify it, e.g. it accepts zero checksums (RFC 9653).", TRUE,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_VERIFY_CHECKSUM] = g_param_spec_boolean("verify-checksum",
+        "Verify checksum", "Drop incoming packets with a bad CRC32c checksum. Can be disabled "
+        "when a secure transport below, such as DTLS, already checks their integrity.", TRUE,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_STACK_IDLE_TIMEOUT] = g_param_spec_uint("stack-idle-timeout",
+        "Stack idle timeout", "Seconds the usrsctp stack is kept running after the last "
+        "association is gone, so that a new one does not have to set it up again (0 = stop "
+        "it right away). The value of the last association to go away is used.", 0, G_MAXUINT,
+        DEFAULT_STACK_IDLE_TIMEOUT, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
     g_object_class_install_properties(gobject_class, NUM_PROPERTIES, properties);
 }
 
 static void gst_sctp_association_init (GstSctpAssociation *self)
 {
-    /* No need to lock mutex here as long as the function is only called from gst_sctp_association_get */
+    G_LOCK(usrsctp_lock);
+    usrsctp_users++;
+    if (stack_teardown_source) {
+        g_source_destroy(stack_teardown_source);
+        g_source_unref(stack_teardown_source);
+        stack_teardown_source = NULL;
+    }
     if (!initialized) {
         usrsctp_init(0, sctp_packet_out, g_print);
         initialized = TRUE;
@@ -168,18 +400,76 @@ static void gst_sctp_association_init (GstSctpAssociation *self)
         usrsctp_sysctl_set_sctp_ecn_enable(0);
 
         usrsctp_sysctl_set_sctp_nr_outgoing_streams_default(MAX_SCTP_SID);
+
+        /* Checksums are computed and verified per association in output_packet() and
+         * gst_sctp_association_incoming_packet() instead, see compute-checksum and
+         * verify-checksum */
+        usrsctp_enable_crc32c_offload();
     }
+    G_UNLOCK(usrsctp_lock);
 
     self->local_port = DEFAULT_LOCAL_SCTP_PORT;
     self->remote_port = DEFAULT_REMOTE_SCTP_PORT;
     self->sctp_ass_sock = NULL;
 
-    self->connection_thread = NULL;
     g_mutex_init(&self->association_mutex);
+    g_rw_lock_init(&self->socket_lock);
 
     self->state = GST_SCTP_ASSOCIATION_STATE_NEW;
 
     self->use_sock_stream = FALSE;
+    self->partial_delivery = FALSE;
+    self->stream_scheduler = GST_SCTP_ASSOCIATION_STREAM_SCHEDULER_DEFAULT;
+    self->congestion_control = GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_RFC4960;
+    self->rto_initial = 0;
+    self->rto_min = 0;
+    self->rto_max = 0;
+    self->send_buffer_size = 0;
+    self->receive_buffer_size = 0;
+    self->sack_delay = 0;
+    self->sack_frequency = 0;
+    self->stack_idle_timeout = DEFAULT_STACK_IDLE_TIMEOUT;
+    self->compute_checksum = TRUE;
+    self->verify_checksum = TRUE;
+    self->udp_remote_address = NULL;
+    self->udp_remote_port = 0;
+    self->udp_local_port = 0;
+    self->udp_transport = NULL;
+    self->sctp_assoc_id = 0;
+    self->message_interleaving = -1;
+    self->bytes_accepted = 0;
+    self->bytes_drained = 0;
+    self->send_buffer_drained_cb = NULL;
+    self->send_buffer_drained_user_data = NULL;
+    self->send_buffer_report_scheduled = FALSE;
+
+    g_mutex_init(&self->receive_mutex);
+    self->receive_buffer = g_malloc(RECEIVE_BUFFER_SIZE);
+    self->partial_messages = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+        (GDestroyNotify)g_byte_array_unref);
+    self->partial_deliveries = g_hash_table_new(g_direct_hash, g_direct_equal);
+    g_mutex_init(&self->abandoned_mutex);
+    self->abandoned_messages = g_hash_table_new(g_direct_hash, g_direct_equal);
+    self->abandoned_messages_total = 0;
+    self->receive_paused = 0;
+    self->receive_pending = 0;
+
+    g_mutex_init(&self->pmtu_mutex);
+    self->max_mtu = DEFAULT_MAX_MTU;
+    self->mtu = PMTU_BASE;
+    self->peer_vtag = 0;
+    self->pmtu_low = PMTU_BASE;
+    self->pmtu_high = PMTU_BASE;
+    self->pmtu_bisect = FALSE;
+    self->pmtu_confirming = FALSE;
+    self->pmtu_probe_size = 0;
+    self->pmtu_probe_count = 0;
+    self->pmtu_probe_seq = 0;
+    self->pmtu_probe_sent = 0;
+    self->pmtu_next_search = 0;
+    self->dont_fragment = FALSE;
+    self->pmtu_enabled = FALSE;
+    self->pmtu_timer = NULL;
 
     usrsctp_register_address((void *) self);
 }
@@ -187,24 +477,44 @@ static void gst_sctp_association_init (GstSctpAssociation *self)
 static void gst_sctp_association_finalize(GObject *object)
 {
     GstSctpAssociation *self = GST_SCTP_ASSOCIATION(object);
+    AssociationShard *shard = &association_shards[self->association_id % ASSOCIATION_SHARDS];
+    AssociationEntry *entry;
 
-    G_LOCK(associations_lock);
-
-    g_hash_table_remove(associations, GUINT_TO_POINTER(self->association_id));
+    /* A new association may already have taken this id */
+    g_mutex_lock(&shard->lock);
+    entry = shard->associations ? g_hash_table_lookup(shard->associations,
+        GUINT_TO_POINTER(self->association_id)) : NULL;
+    if (entry && entry->association == self)
+        g_hash_table_remove(shard->associations, GUINT_TO_POINTER(self->association_id));
+    g_mutex_unlock(&shard->lock);
 
     usrsctp_deregister_address((void *) self);
-    if (g_hash_table_size(associations) == 0) {
-        if (usrsctp_finish() == 0)
-          initialized = FALSE;
-    }
-    G_UNLOCK(associations_lock);
 
-    if (self->connection_thread) {
-      g_thread_join(self->connection_thread);
-      self->connection_thread = NULL;
+    G_LOCK(usrsctp_lock);
+    if (--usrsctp_users == 0) {
+        if (self->stack_idle_timeout == 0) {
+            finish_stack();
+        } else {
+            stack_teardown_source = g_timeout_source_new_seconds(self->stack_idle_timeout);
+            g_source_set_callback(stack_teardown_source, stack_idle_teardown, NULL, NULL);
+            g_source_attach(stack_teardown_source, get_worker_context());
+        }
     }
+    G_UNLOCK(usrsctp_lock);
+
+    if (self->udp_transport)
+        gst_sctp_udp_transport_free(self->udp_transport);
+    g_free(self->udp_remote_address);
 
     g_mutex_clear(&self->association_mutex);
+    g_rw_lock_clear(&self->socket_lock);
+    g_mutex_clear(&self->receive_mutex);
+    g_mutex_clear(&self->pmtu_mutex);
+    g_mutex_clear(&self->abandoned_mutex);
+    g_free(self->receive_buffer);
+    g_hash_table_unref(self->partial_messages);
+    g_hash_table_unref(self->partial_deliveries);
+    g_hash_table_unref(self->abandoned_messages);
 
     G_OBJECT_CLASS(gst_sctp_association_parent_class)->finalize(object);
 }
@@ -219,11 +529,22 @@ static void gst_sctp_association_set_property(GObject *object, guint prop_id, co
         switch (prop_id) {
         case PROP_LOCAL_PORT:
         case PROP_REMOTE_PORT:
+        case PROP_MAX_MTU:
+        case PROP_DONT_FRAGMENT:
+        case PROP_UDP_REMOTE_ADDRESS:
+        case PROP_UDP_REMOTE_PORT:
+        case PROP_UDP_LOCAL_PORT:
             g_warning("These properties cannot be set in this state");
             goto error;
         }
     }
 
+    if (self->state != GST_SCTP_ASSOCIATION_STATE_NEW &&
+        self->state != GST_SCTP_ASSOCIATION_STATE_READY && prop_id == PROP_PARTIAL_DELIVERY) {
+        g_warning("partial-delivery cannot be changed once the association is started");
+        goto error;
+    }
+
     switch (prop_id) {
     case PROP_ASSOCIATION_ID:
         self->association_id = g_value_get_uint(value);
@@ -240,6 +561,63 @@ static void gst_sctp_association_set_property(GObject *object, guint prop_id, co
     case PROP_USE_SOCK_STREAM:
         self->use_sock_stream = g_value_get_boolean(value);
         break;
+    case PROP_STREAM_SCHEDULER:
+        self->stream_scheduler = g_value_get_enum(value);
+        break;
+    case PROP_PARTIAL_DELIVERY:
+        self->partial_delivery = g_value_get_boolean(value);
+        break;
+    case PROP_MAX_MTU:
+        g_mutex_lock(&self->pmtu_mutex);
+        self->max_mtu = PMTU_ALIGN(g_value_get_uint(value));
+        g_mutex_unlock(&self->pmtu_mutex);
+        break;
+    case PROP_DONT_FRAGMENT:
+        self->dont_fragment = g_value_get_boolean(value);
+        break;
+    case PROP_CONGESTION_CONTROL:
+        self->congestion_control = g_value_get_enum(value);
+        break;
+    case PROP_RTO_INITIAL:
+        self->rto_initial = g_value_get_uint(value);
+        break;
+    case PROP_RTO_MIN:
+        self->rto_min = g_value_get_uint(value);
+        break;
+    case PROP_RTO_MAX:
+        self->rto_max = g_value_get_uint(value);
+        break;
+    case PROP_SEND_BUFFER_SIZE:
+        self->send_buffer_size = g_value_get_uint(value);
+        break;
+    case PROP_RECEIVE_BUFFER_SIZE:
+        self->receive_buffer_size = g_value_get_uint(value);
+        break;
+    case PROP_SACK_DELAY:
+        self->sack_delay = g_value_get_uint(value);
+        break;
+    case PROP_SACK_FREQUENCY:
+        self->sack_frequency = g_value_get_uint(value);
+        break;
+    case PROP_UDP_REMOTE_ADDRESS:
+        g_free(self->udp_remote_address);
+        self->udp_remote_address = g_value_dup_string(value);
+        break;
+    case PROP_UDP_REMOTE_PORT:
+        self->udp_remote_port = g_value_get_uint(value);
+        break;
+    case PROP_UDP_LOCAL_PORT:
+        self->udp_local_port = g_value_get_uint(value);
+        break;
+    case PROP_COMPUTE_CHECKSUM:
+        g_atomic_int_set(&self->compute_checksum, g_value_get_boolean(value));
+        break;
+    case PROP_VERIFY_CHECKSUM:
+        g_atomic_int_set(&self->verify_checksum, g_value_get_boolean(value));
+        break;
+    case PROP_STACK_IDLE_TIMEOUT:
+        self->stack_idle_timeout = g_value_get_uint(value);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(self, prop_id, pspec);
         break;
@@ -297,6 +675,67 @@ static void gst_sctp_association_get_property(GObject *object, guint prop_id, GV
     case PROP_USE_SOCK_STREAM:
         g_value_set_boolean(value, self->use_sock_stream);
         break;
+    case PROP_STREAM_SCHEDULER:
+        g_value_set_enum(value, self->stream_scheduler);
+        break;
+    case PROP_PARTIAL_DELIVERY:
+        g_value_set_boolean(value, self->partial_delivery);
+        break;
+    case PROP_MAX_MTU:
+        g_mutex_lock(&self->pmtu_mutex);
+        g_value_set_uint(value, self->max_mtu);
+        g_mutex_unlock(&self->pmtu_mutex);
+        break;
+    case PROP_MTU:
+        g_value_set_uint(value, g_atomic_int_get(&self->mtu));
+        break;
+    case PROP_DONT_FRAGMENT:
+        g_value_set_boolean(value, self->dont_fragment);
+        break;
+    case PROP_CONGESTION_CONTROL:
+        g_value_set_enum(value, self->congestion_control);
+        break;
+    case PROP_RTO_INITIAL:
+        g_value_set_uint(value, self->rto_initial);
+        break;
+    case PROP_RTO_MIN:
+        g_value_set_uint(value, self->rto_min);
+        break;
+    case PROP_RTO_MAX:
+        g_value_set_uint(value, self->rto_max);
+        break;
+    case PROP_SEND_BUFFER_SIZE:
+        g_value_set_uint(value, self->send_buffer_size);
+        break;
+    case PROP_RECEIVE_BUFFER_SIZE:
+        g_value_set_uint(value, self->receive_buffer_size);
+        break;
+    case PROP_SACK_DELAY:
+        g_value_set_uint(value, self->sack_delay);
+        break;
+    case PROP_SACK_FREQUENCY:
+        g_value_set_uint(value, self->sack_frequency);
+        break;
+    case PROP_UDP_REMOTE_ADDRESS:
+        g_mutex_lock(&self->association_mutex);
+        g_value_set_string(value, self->udp_remote_address);
+        g_mutex_unlock(&self->association_mutex);
+        break;
+    case PROP_UDP_REMOTE_PORT:
+        g_value_set_uint(value, self->udp_remote_port);
+        break;
+    case PROP_UDP_LOCAL_PORT:
+        g_value_set_uint(value, self->udp_local_port);
+        break;
+    case PROP_COMPUTE_CHECKSUM:
+        g_value_set_boolean(value, g_atomic_int_get(&self->compute_checksum));
+        break;
+    case PROP_VERIFY_CHECKSUM:
+        g_value_set_boolean(value, g_atomic_int_get(&self->verify_checksum));
+        break;
+    case PROP_STACK_IDLE_TIMEOUT:
+        g_value_set_uint(value, self->stack_idle_timeout);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(self, prop_id, pspec);
         break;
@@ -307,26 +746,37 @@ static void gst_sctp_association_get_property(GObject *object, guint prop_id, GV
 
 GstSctpAssociation *gst_sctp_association_get(guint32 association_id)
 {
-    GstSctpAssociation *association;
-
-    G_LOCK(associations_lock);
-    if (!associations) {
-        associations = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
+    AssociationShard *shard = &association_shards[association_id % ASSOCIATION_SHARDS];
+    GstSctpAssociation *association = NULL;
+    AssociationEntry *entry;
+
+    g_mutex_lock(&shard->lock);
+    if (!shard->associations) {
+        shard->associations = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+            (GDestroyNotify)free_association_entry);
     }
 
-    association = g_hash_table_lookup(associations, GUINT_TO_POINTER(association_id));
+    /* The weak reference is cleared before an association being finalized is removed, so a
+     * dying association is never handed out again */
+    entry = g_hash_table_lookup(shard->associations, GUINT_TO_POINTER(association_id));
+    if (entry)
+        association = g_weak_ref_get(&entry->ref);
+
     if (!association) {
         association = g_object_new(GST_SCTP_TYPE_ASSOCIATION, "association-id", association_id, NULL);
-        g_hash_table_insert(associations, GUINT_TO_POINTER(association_id), association);
-    } else {
-        g_object_ref(association);
+        entry = g_slice_new(AssociationEntry);
+        g_weak_ref_init(&entry->ref, association);
+        entry->association = association;
+        g_hash_table_insert(shard->associations, GUINT_TO_POINTER(association_id), entry);
     }
-    G_UNLOCK(associations_lock);
+    g_mutex_unlock(&shard->lock);
     return association;
 }
 
 gboolean gst_sctp_association_start(GstSctpAssociation *self) {
-    gchar *thread_name;
+    GMainContext *context;
+    GstSctpUdpTransport *udp_transport;
+    gsize packet_size;
 
     g_mutex_lock(&self->association_mutex);
     if (self->state != GST_SCTP_ASSOCIATION_STATE_READY) {
@@ -334,7 +784,25 @@ gboolean gst_sctp_association_start(GstSctpAssociation *self) {
         goto configure_required;
     }
 
-    if ((self->sctp_ass_sock = create_sctp_socket(self)) == NULL)
+    if (self->udp_remote_address) {
+        g_mutex_lock(&self->pmtu_mutex);
+        packet_size = MAX(self->max_mtu, MIN_UDP_PACKET_SIZE);
+        g_mutex_unlock(&self->pmtu_mutex);
+
+        udp_transport = gst_sctp_udp_transport_new(self->udp_local_port, self->udp_remote_address,
+            self->udp_remote_port, packet_size, (GstSctpUdpTransportReceiveCb)on_udp_packet, self);
+        if (!udp_transport)
+            goto error;
+        g_atomic_pointer_set(&self->udp_transport, udp_transport);
+    }
+
+    g_rw_lock_writer_lock(&self->socket_lock);
+    self->sctp_ass_sock = create_sctp_socket(self);
+    g_atomic_int_set(&self->bytes_accepted, 0);
+    self->bytes_drained = 0;
+    g_atomic_int_set(&self->message_interleaving, -1);
+    g_rw_lock_writer_unlock(&self->socket_lock);
+    if (!self->sctp_ass_sock)
         goto error;
 
     gst_sctp_association_change_state(self, GST_SCTP_ASSOCIATION_STATE_CONNECTING, FALSE);
@@ -345,14 +813,19 @@ gboolean gst_sctp_association_start(GstSctpAssociation *self) {
      * on property change and call this object a deadlock might occur.*/
     gst_sctp_association_change_state(self, GST_SCTP_ASSOCIATION_STATE_CONNECTING, TRUE);
 
-    thread_name = g_strdup_printf("connection_thread_%u", self->association_id);
-    self->connection_thread = g_thread_new(thread_name,
-        (GThreadFunc) connection_thread_func, self);
-    g_free(thread_name);
+    G_LOCK(usrsctp_lock);
+    context = get_worker_context();
+    G_UNLOCK(usrsctp_lock);
+    g_main_context_invoke_full(context, G_PRIORITY_DEFAULT, (GSourceFunc)connect_on_worker,
+        g_object_ref(self), g_object_unref);
 
     return TRUE;
 error:
+    udp_transport = g_atomic_pointer_get(&self->udp_transport);
+    g_atomic_pointer_set(&self->udp_transport, NULL);
     g_mutex_unlock(&self->association_mutex);
+    if (udp_transport)
+        gst_sctp_udp_transport_free(udp_transport);
     gst_sctp_association_change_state(self, GST_SCTP_ASSOCIATION_STATE_ERROR, TRUE);
     return FALSE;
 configure_required:
@@ -377,6 +850,35 @@ void gst_sctp_association_set_on_packet_out(GstSctpAssociation *self, GstSctpAss
     maybe_set_state_to_ready(self);
 }
 
+void gst_sctp_association_set_on_send_buffer_drained(GstSctpAssociation *self, GstSctpAssociationSendBufferDrainedCb send_buffer_drained_cb, gpointer user_data)
+{
+    g_return_if_fail(GST_SCTP_IS_ASSOCIATION(self));
+
+    g_mutex_lock(&self->association_mutex);
+    if (self->state == GST_SCTP_ASSOCIATION_STATE_NEW) {
+        self->send_buffer_drained_cb = send_buffer_drained_cb;
+        self->send_buffer_drained_user_data = user_data;
+    } else {
+        g_warning("It is not possible to change send buffer drained callback in this state");
+    }
+    g_mutex_unlock(&self->association_mutex);
+}
+
+void gst_sctp_association_set_on_ready_to_send(GstSctpAssociation *self, GstSctpAssociationReadyToSendCb ready_to_send_cb, gpointer user_data)
+{
+    g_return_if_fail(GST_SCTP_IS_ASSOCIATION(self));
+
+    g_mutex_lock(&self->association_mutex);
+    if (self->state == GST_SCTP_ASSOCIATION_STATE_NEW) {
+        self->ready_to_send_cb = ready_to_send_cb;
+        self->ready_to_send_user_data = user_data;
+    } else {
+        /* This is to be thread safe. The socket upcall might try to call the closure already */
+        g_warning("It is not possible to change ready to send callback in this state");
+    }
+    g_mutex_unlock(&self->association_mutex);
+}
+
 void gst_sctp_association_set_on_packet_received(GstSctpAssociation *self, GstSctpAssociationPacketReceivedCb packet_received_cb, gpointer user_data)
 {
     g_return_if_fail(GST_SCTP_IS_ASSOCIATION(self));
@@ -396,27 +898,84 @@ void gst_sctp_association_set_on_packet_received(GstSctpAssociation *self, GstSc
 
 void gst_sctp_association_incoming_packet(GstSctpAssociation *self, guint8 *buf, guint32 length)
 {
+    guint acked_size;
+    guint32 acked_seq = 0;
+    guint32 checksum;
+
+    if (g_atomic_int_get(&self->verify_checksum)) {
+        if (length < SCTP_COMMON_HEADER_LENGTH)
+            return;
+
+        memcpy(&checksum, buf + 8, sizeof(checksum));
+        if (checksum != gst_sctp_crc32c_packet(buf, length)) {
+            g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Dropping SCTP packet with bad checksum");
+            return;
+        }
+    }
+
+    /* usrsctp drops the probe's HEARTBEAT-ACK as it does not recognise the heartbeat info */
+    acked_size = gst_sctp_pmtu_probe_find_ack(buf, length, &acked_seq);
     usrsctp_conninput((void *) self, (const void *)buf, (size_t)length, 0);
+    check_message_interleaving(self);
+    report_send_buffer_drained(self);
+
+    /* Timeouts are left to the probe timer, an ack moves on to the next probe right away */
+    if (acked_size)
+        pmtu_probe_tick(self, acked_size, acked_seq);
+}
+
+/* While paused, received data is left in the socket receive buffer. Once that is full
+ * the advertised receive window closes and the peer stops sending. Pause and resume
+ * calls nest, and may arrive in any order from different threads. Reading resumes on
+ * the worker context rather than on the calling thread. */
+void gst_sctp_association_pause_receive(GstSctpAssociation *self)
+{
+    if (g_atomic_int_add(&self->receive_paused, 1) == -1)
+        schedule_receive(self);
+}
+
+void gst_sctp_association_resume_receive(GstSctpAssociation *self)
+{
+    if (g_atomic_int_add(&self->receive_paused, -1) == 1)
+        schedule_receive(self);
 }
 
-gboolean gst_sctp_association_send_data(GstSctpAssociation *self, guint8 *buf, guint32 length,
+GstSctpAssociationSendResult gst_sctp_association_send_data(GstSctpAssociation *self, const guint8 *buf, guint32 length,
     guint16 stream_id, guint32 ppid, gboolean ordered, GstSctpAssociationPartialReliability pr,
-    guint32 reliability_param)
+    guint32 reliability_param, gboolean end_of_record, guint32 *bytes_sent_out)
 {
     struct sctp_sendv_spa spa;
     gint32 bytes_sent;
-    gboolean result = FALSE;
+    GstSctpAssociationSendResult result = GST_SCTP_ASSOCIATION_SEND_ERROR;
+    GstSctpAssociationState state;
     struct sockaddr_conn remote_addr;
 
-    g_mutex_lock(&self->association_mutex);
-    if (self->state != GST_SCTP_ASSOCIATION_STATE_CONNECTED)
+    /* usrsctp_sendv() may call back into sctp_packet_out() and socket_upcall() and the
+     * socket is locked internally, so only closing it is kept out here */
+    g_rw_lock_reader_lock(&self->socket_lock);
+    state = g_atomic_int_get((gint *)&self->state);
+    if (state < GST_SCTP_ASSOCIATION_STATE_CONNECTED) {
+        /* The ready-to-send callback is called once the association is up */
+        result = GST_SCTP_ASSOCIATION_SEND_WOULD_BLOCK;
+        goto end;
+    }
+    if (state != GST_SCTP_ASSOCIATION_STATE_CONNECTED || !self->sctp_ass_sock)
+        goto end;
+    if (g_atomic_int_get(&self->message_interleaving) == -1) {
+        /* How messages may be sent is not settled yet, see check_message_interleaving() */
+        result = GST_SCTP_ASSOCIATION_SEND_WOULD_BLOCK;
         goto end;
+    }
 
     memset(&spa, 0, sizeof(spa));
 
     spa.sendv_sndinfo.snd_ppid = g_htonl(ppid);
     spa.sendv_sndinfo.snd_sid = stream_id;
     spa.sendv_sndinfo.snd_flags = ordered ? 0 : SCTP_UNORDERED;
+    /* With message interleaving the socket uses SCTP_EXPLICIT_EOR, and a message is only
+     * complete once sent with SCTP_EOR. Otherwise every send is a complete message. */
+    if (end_of_record)
+        spa.sendv_sndinfo.snd_flags |= SCTP_EOR;
     spa.sendv_sndinfo.snd_context = 0;
     spa.sendv_sndinfo.snd_assoc_id = 0;
     spa.sendv_flags = SCTP_SEND_SNDINFO_VALID;
@@ -432,10 +991,11 @@ gboolean gst_sctp_association_send_data(GstSctpAssociation *self, guint8 *buf, g
     }
 
     remote_addr = get_sctp_socket_address(self, self->remote_port);
-    bytes_sent = usrsctp_sendv(self->sctp_ass_sock, buf, length, (struct sockaddr *)&remote_addr, 1, (void *)&spa, (socklen_t)sizeof(struct sctp_sendv_spa), SCTP_SENDV_SPA, 0);
+    bytes_sent = usrsctp_sendv(self->sctp_ass_sock, (const void *)buf, length, (struct sockaddr *)&remote_addr, 1, (void *)&spa, (socklen_t)sizeof(struct sctp_sendv_spa), SCTP_SENDV_SPA, 0);
     if (bytes_sent < 0) {
         if (errno == EAGAIN || errno == EWOULDBLOCK) {
             /* Resending this buffer is taken care of by the gstsctpenc */
+            result = GST_SCTP_ASSOCIATION_SEND_WOULD_BLOCK;
             goto end;
         } else {
             g_warning("Error sending data on stream %u: (%u) %s", stream_id, errno, strerror(errno));
@@ -443,9 +1003,18 @@ gboolean gst_sctp_association_send_data(GstSctpAssociation *self, guint8 *buf, g
         }
     }
 
-    result = TRUE;
+    g_atomic_int_add((gint *)&self->bytes_accepted, bytes_sent);
+    if (bytes_sent_out)
+        *bytes_sent_out = (guint32)bytes_sent;
+    result = GST_SCTP_ASSOCIATION_SEND_OK;
 end:
-    g_mutex_unlock(&self->association_mutex);
+    g_rw_lock_reader_unlock(&self->socket_lock);
+
+    /* Data may have left the send buffer without a packet coming in, when it was abandoned
+     * or acknowledged while the sender was busy. A full buffer is checked too, so that the
+     * sender does not wait on a stale buffered amount. */
+    if (result != GST_SCTP_ASSOCIATION_SEND_ERROR && state == GST_SCTP_ASSOCIATION_STATE_CONNECTED)
+        report_send_buffer_drained(self);
     return result;
 }
 
@@ -468,16 +1037,149 @@ void gst_sctp_association_reset_stream(GstSctpAssociation *self, guint16 stream_
     g_free(srs);
 }
 
+/* The priority is the stream value of the configured scheduler: lower values are sent first
+ * with the priority scheduler, the fair bandwidth scheduler uses it as the stream's initial
+ * round count. Other schedulers ignore it. */
+gboolean gst_sctp_association_set_stream_priority(GstSctpAssociation *self, guint16 stream_id,
+    guint16 priority)
+{
+    struct sctp_stream_value stream_value;
+    gboolean result = FALSE;
+
+    g_mutex_lock(&self->association_mutex);
+    if (self->state != GST_SCTP_ASSOCIATION_STATE_CONNECTED)
+        goto end;
+
+    memset(&stream_value, 0, sizeof(stream_value));
+    stream_value.assoc_id = self->sctp_assoc_id;
+    stream_value.stream_id = stream_id;
+    stream_value.stream_value = priority;
+    if (usrsctp_setsockopt(self->sctp_ass_sock, IPPROTO_SCTP, SCTP_SS_VALUE, &stream_value,
+        (socklen_t)sizeof(stream_value)) < 0) {
+        g_warning("Could not set priority of stream %u: (%u) %s", stream_id, errno, strerror(errno));
+        goto end;
+    }
+
+    result = TRUE;
+end:
+    g_mutex_unlock(&self->association_mutex);
+    return result;
+}
+
 void gst_sctp_association_force_close(GstSctpAssociation *self)
 {
+    GstSctpUdpTransport *udp_transport;
+    GSource *pmtu_timer;
+
+    /* The receive mutex goes first, a reader that is still draining the socket takes
+     * the association mutex while holding it */
+    g_mutex_lock(&self->receive_mutex);
     g_mutex_lock(&self->association_mutex);
     if (self->sctp_ass_sock) {
+        g_rw_lock_writer_lock(&self->socket_lock);
         usrsctp_set_ulpinfo(self->sctp_ass_sock, NULL);
+        usrsctp_set_upcall(self->sctp_ass_sock, NULL, NULL);
         usrsctp_shutdown (self->sctp_ass_sock, SHUT_RDWR);
         usrsctp_close(self->sctp_ass_sock);
         self->sctp_ass_sock = NULL;
+        g_rw_lock_writer_unlock(&self->socket_lock);
     }
+    g_hash_table_remove_all(self->partial_messages);
+    g_hash_table_remove_all(self->partial_deliveries);
+    g_atomic_int_set(&self->peer_vtag, 0);
+    udp_transport = g_atomic_pointer_get(&self->udp_transport);
+    g_atomic_pointer_set(&self->udp_transport, NULL);
     g_mutex_unlock(&self->association_mutex);
+    g_mutex_unlock(&self->receive_mutex);
+
+    g_mutex_lock(&self->pmtu_mutex);
+    self->pmtu_enabled = FALSE;
+    pmtu_timer = self->pmtu_timer;
+    self->pmtu_timer = NULL;
+    g_mutex_unlock(&self->pmtu_mutex);
+    if (pmtu_timer) {
+        g_source_destroy(pmtu_timer);
+        g_source_unref(pmtu_timer);
+    }
+
+    /* Its receive thread may be waiting for either mutex */
+    if (udp_transport)
+        gst_sctp_udp_transport_free(udp_transport);
+}
+
+/* Whether a message may be handed over to gst_sctp_association_send_data() in several parts.
+ * FALSE until the association is up. */
+gboolean gst_sctp_association_get_message_interleaving(GstSctpAssociation *self)
+{
+    return g_atomic_int_get(&self->message_interleaving) == 1;
+}
+
+gboolean gst_sctp_association_get_stats(GstSctpAssociation *self, GstSctpAssociationStats *stats)
+{
+    struct sctp_status status;
+    struct sctp_sockstat sockstat;
+    struct sctpstat stack_stats;
+    socklen_t len;
+    gboolean result = FALSE;
+
+    memset(stats, 0, sizeof(*stats));
+
+    g_mutex_lock(&self->abandoned_mutex);
+    stats->abandoned_messages = self->abandoned_messages_total;
+    g_mutex_unlock(&self->abandoned_mutex);
+
+    g_mutex_lock(&self->association_mutex);
+    /* Only freed after being cleared under the association mutex */
+    if (self->udp_transport)
+        stats->udp_dropped_packets = gst_sctp_udp_transport_get_dropped_packets(
+            self->udp_transport);
+    if (self->state != GST_SCTP_ASSOCIATION_STATE_CONNECTED)
+        goto end;
+
+    /* The primary path is the only path of an AF_CONN association, so SCTP_STATUS has
+     * what SCTP_GET_PEER_ADDR_INFO would return for it */
+    memset(&status, 0, sizeof(status));
+    status.sstat_assoc_id = self->sctp_assoc_id;
+    len = (socklen_t)sizeof(status);
+    if (usrsctp_getsockopt(self->sctp_ass_sock, IPPROTO_SCTP, SCTP_STATUS, &status, &len) < 0) {
+        g_warning("Could not get SCTP status: (%u) %s", errno, strerror(errno));
+        goto end;
+    }
+    stats->cwnd = status.sstat_primary.spinfo_cwnd;
+    stats->peer_rwnd = status.sstat_rwnd;
+    stats->srtt = status.sstat_primary.spinfo_srtt;
+    stats->rto = status.sstat_primary.spinfo_rto;
+    stats->mtu = status.sstat_primary.spinfo_mtu;
+    stats->unacked_chunks = status.sstat_unackdata;
+    stats->pending_chunks = status.sstat_penddata;
+
+    memset(&sockstat, 0, sizeof(sockstat));
+    sockstat.ss_assoc_id = self->sctp_assoc_id;
+    len = (socklen_t)sizeof(sockstat);
+    if (usrsctp_getsockopt(self->sctp_ass_sock, IPPROTO_SCTP, SCTP_GET_SNDBUF_USE, &sockstat,
+        &len) == 0)
+        stats->send_buffer_used = sockstat.ss_total_sndbuf;
+
+    usrsctp_get_stat(&stack_stats);
+    stats->stack_retransmissions = (guint64)stack_stats.sctps_sendretransdata
+        + stack_stats.sctps_sendfastretrans;
+
+    result = TRUE;
+end:
+    g_mutex_unlock(&self->association_mutex);
+    return result;
+}
+
+guint gst_sctp_association_get_abandoned_messages(GstSctpAssociation *self, guint16 stream_id)
+{
+    guint count;
+
+    g_mutex_lock(&self->abandoned_mutex);
+    count = GPOINTER_TO_UINT(g_hash_table_lookup(self->abandoned_messages,
+        GUINT_TO_POINTER(stream_id)));
+    g_mutex_unlock(&self->abandoned_mutex);
+
+    return count;
 }
 
 static struct socket * create_sctp_socket(GstSctpAssociation *self)
@@ -486,6 +1188,8 @@ static struct socket * create_sctp_socket(GstSctpAssociation *self)
     struct linger l;
     struct sctp_event event;
     struct sctp_assoc_value stream_reset;
+    struct sctp_assoc_value scheduler;
+    struct sctp_assoc_value interleaving;
     int value = 1;
     guint16 event_types[] = {
         SCTP_ASSOC_CHANGE,
@@ -494,17 +1198,19 @@ static struct socket * create_sctp_socket(GstSctpAssociation *self)
         SCTP_SEND_FAILED,
         SCTP_SHUTDOWN_EVENT,
         SCTP_ADAPTATION_INDICATION,
-        /*SCTP_PARTIAL_DELIVERY_EVENT,*/
+        SCTP_PARTIAL_DELIVERY_EVENT,
         /*SCTP_AUTHENTICATION_EVENT,*/
         SCTP_STREAM_RESET_EVENT,
-        /*SCTP_SENDER_DRY_EVENT,*/
+        SCTP_SENDER_DRY_EVENT,
         /*SCTP_NOTIFICATIONS_STOPPED_EVENT,*/
         /*SCTP_ASSOC_RESET_EVENT,*/
         SCTP_STREAM_CHANGE_EVENT};
     guint32 i;
     guint sock_type = self->use_sock_stream ? SOCK_STREAM : SOCK_SEQPACKET;
 
-    if ((sock = usrsctp_socket(AF_CONN, sock_type, IPPROTO_SCTP, receive_cb, NULL, 0,
+    /* No receive callback, data is pulled with usrsctp_recvv() from the upcall so that
+     * reading can be paused when the consumers cannot keep up */
+    if ((sock = usrsctp_socket(AF_CONN, sock_type, IPPROTO_SCTP, NULL, NULL, 0,
         (void *)self)) == NULL)
         goto error;
 
@@ -513,6 +1219,13 @@ static struct socket * create_sctp_socket(GstSctpAssociation *self)
         goto error;
     }
 
+    /* Lets sctpenc wake up blocked pads as soon as there is room in the send buffer again
+     * instead of polling for it, and tells us when there is data to read */
+    if (usrsctp_set_upcall(sock, socket_upcall, (void *)self) < 0) {
+        g_warning("Could not set upcall on SCTP socket");
+        goto error;
+    }
+
     memset(&l, 0, sizeof(l));
     l.l_onoff = 1;
     l.l_linger = 0;
@@ -527,6 +1240,42 @@ static struct socket * create_sctp_socket(GstSctpAssociation *self)
         goto error;
     }
 
+    if (usrsctp_setsockopt(sock, IPPROTO_SCTP, SCTP_RECVRCVINFO, &value, sizeof(int))) {
+        g_warning("Could not set SCTP_RECVRCVINFO");
+        goto error;
+    }
+
+    /* Fragments of large messages on different streams may interleave, so a large message
+     * does not hold back the other streams. Needed by I-DATA below. */
+    value = SCTP_FRAG_LEVEL_2;
+    if (usrsctp_setsockopt(sock, IPPROTO_SCTP, SCTP_FRAGMENT_INTERLEAVE, &value, sizeof(int)))
+        g_warning("Could not set SCTP_FRAGMENT_INTERLEAVE");
+    value = 1;
+
+    /* Message interleaving (RFC 8260), used when the peer supports it as well */
+    memset(&interleaving, 0, sizeof(interleaving));
+    interleaving.assoc_id = SCTP_FUTURE_ASSOC;
+    interleaving.assoc_value = 1;
+    if (usrsctp_setsockopt(sock, IPPROTO_SCTP, SCTP_INTERLEAVING_SUPPORTED, &interleaving,
+        sizeof(interleaving)))
+        g_warning("Could not set SCTP_INTERLEAVING_SUPPORTED");
+
+    /* Start handing over a message once a receive buffer worth of it is queued, rather than
+     * when the stack's default point is reached */
+    if (self->partial_delivery) {
+        guint32 pd_point = RECEIVE_BUFFER_SIZE;
+        if (usrsctp_setsockopt(sock, IPPROTO_SCTP, SCTP_PARTIAL_DELIVERY_POINT, &pd_point,
+            sizeof(pd_point)))
+            g_warning("Could not set SCTP_PARTIAL_DELIVERY_POINT");
+    }
+
+    /* Lets a message be handed over in several parts, turned off again unless I-DATA is
+     * negotiated, see check_message_interleaving() */
+    if (usrsctp_setsockopt(sock, IPPROTO_SCTP, SCTP_EXPLICIT_EOR, &value, sizeof(int))) {
+        g_warning("Could not set SCTP_EXPLICIT_EOR");
+        goto error;
+    }
+
     memset(&stream_reset, 0, sizeof(stream_reset));
     stream_reset.assoc_id = SCTP_ALL_ASSOC;
     stream_reset.assoc_value = 1;
@@ -536,6 +1285,38 @@ static struct socket * create_sctp_socket(GstSctpAssociation *self)
         goto error;
     }
 
+    if (self->stream_scheduler != GST_SCTP_ASSOCIATION_STREAM_SCHEDULER_DEFAULT) {
+        memset(&scheduler, 0, sizeof(scheduler));
+        scheduler.assoc_id = SCTP_ALL_ASSOC;
+        switch (self->stream_scheduler) {
+        case GST_SCTP_ASSOCIATION_STREAM_SCHEDULER_ROUND_ROBIN:
+            scheduler.assoc_value = SCTP_SS_ROUND_ROBIN;
+            break;
+        case GST_SCTP_ASSOCIATION_STREAM_SCHEDULER_ROUND_ROBIN_PACKET:
+            scheduler.assoc_value = SCTP_SS_ROUND_ROBIN_PACKET;
+            break;
+        case GST_SCTP_ASSOCIATION_STREAM_SCHEDULER_PRIORITY:
+            scheduler.assoc_value = SCTP_SS_PRIORITY;
+            break;
+        case GST_SCTP_ASSOCIATION_STREAM_SCHEDULER_FAIR_BANDWIDTH:
+            scheduler.assoc_value = SCTP_SS_FAIR_BANDWITH;
+            break;
+        case GST_SCTP_ASSOCIATION_STREAM_SCHEDULER_FIRST_COME:
+            scheduler.assoc_value = SCTP_SS_FIRST_COME;
+            break;
+        default:
+            scheduler.assoc_value = SCTP_SS_DEFAULT;
+            break;
+        }
+        if (usrsctp_setsockopt(sock, IPPROTO_SCTP, SCTP_PLUGGABLE_SS, &scheduler,
+            sizeof(scheduler))) {
+            g_warning("Could not set SCTP_PLUGGABLE_SS");
+            goto error;
+        }
+    }
+
+    apply_transport_parameters(self, sock);
+
     memset(&event, 0, sizeof(event));
     event.se_assoc_id = SCTP_ALL_ASSOC;
     event.se_on = 1;
@@ -558,6 +1339,68 @@ error:
     return NULL;
 }
 
+/* Failing to apply one of these only costs performance, so the association is set up anyway */
+static void apply_transport_parameters(GstSctpAssociation *self, struct socket *sock)
+{
+    struct sctp_assoc_value cc;
+    struct sctp_rtoinfo rto;
+    struct sctp_sack_info sack;
+    int value;
+
+    if (self->congestion_control != GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_RFC4960) {
+        memset(&cc, 0, sizeof(cc));
+        cc.assoc_id = SCTP_FUTURE_ASSOC;
+        switch (self->congestion_control) {
+        case GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_HSTCP:
+            cc.assoc_value = SCTP_CC_HSTCP;
+            break;
+        case GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_HTCP:
+            cc.assoc_value = SCTP_CC_HTCP;
+            break;
+        case GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_RTCC:
+            cc.assoc_value = SCTP_CC_RTCC;
+            break;
+        default:
+            cc.assoc_value = SCTP_CC_RFC2581;
+            break;
+        }
+        if (usrsctp_setsockopt(sock, IPPROTO_SCTP, SCTP_PLUGGABLE_CC, &cc, sizeof(cc)))
+            g_warning("Could not set SCTP_PLUGGABLE_CC");
+    }
+
+    if (self->rto_initial || self->rto_min || self->rto_max) {
+        /* Fields left at 0 are not changed */
+        memset(&rto, 0, sizeof(rto));
+        rto.srto_assoc_id = SCTP_FUTURE_ASSOC;
+        rto.srto_initial = self->rto_initial;
+        rto.srto_min = self->rto_min;
+        rto.srto_max = self->rto_max;
+        if (usrsctp_setsockopt(sock, IPPROTO_SCTP, SCTP_RTOINFO, &rto, sizeof(rto)))
+            g_warning("Could not set SCTP_RTOINFO");
+    }
+
+    if (self->send_buffer_size) {
+        value = (int)self->send_buffer_size;
+        if (usrsctp_setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &value, sizeof(int)))
+            g_warning("Could not set SO_SNDBUF");
+    }
+
+    if (self->receive_buffer_size) {
+        value = (int)self->receive_buffer_size;
+        if (usrsctp_setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &value, sizeof(int)))
+            g_warning("Could not set SO_RCVBUF");
+    }
+
+    if (self->sack_delay || self->sack_frequency) {
+        memset(&sack, 0, sizeof(sack));
+        sack.sack_assoc_id = SCTP_FUTURE_ASSOC;
+        sack.sack_delay = self->sack_delay;
+        sack.sack_freq = self->sack_frequency;
+        if (usrsctp_setsockopt(sock, IPPROTO_SCTP, SCTP_DELAYED_SACK, &sack, sizeof(sack)))
+            g_warning("Could not set SCTP_DELAYED_SACK");
+    }
+}
+
 static struct sockaddr_conn get_sctp_socket_address(GstSctpAssociation *gst_sctp_association,
     guint16 port) {
     struct sockaddr_conn addr;
@@ -573,17 +1416,85 @@ static struct sockaddr_conn get_sctp_socket_address(GstSctpAssociation *gst_sctp
     return addr;
 }
 
-static gpointer connection_thread_func(GstSctpAssociation *self)
+/* usrsctp leaves the checksum to us, see usrsctp_enable_crc32c_offload() */
+static void output_packet(GstSctpAssociation *self, guint8 *buf, gsize length)
 {
-    /* TODO: Support both server and client role */
-    client_role_connect(self);
+    GstSctpUdpTransport *udp_transport = g_atomic_pointer_get(&self->udp_transport);
+    guint32 checksum = 0;
+
+    if (length < SCTP_COMMON_HEADER_LENGTH)
+        return;
+
+    if (g_atomic_int_get(&self->compute_checksum))
+        checksum = gst_sctp_crc32c_packet(buf, length);
+    memcpy(buf + 8, &checksum, sizeof(checksum));
+
+    if (udp_transport)
+        gst_sctp_udp_transport_send(udp_transport, buf, length);
+    else if (self->packet_out_cb)
+        self->packet_out_cb(self, buf, length, self->packet_out_user_data);
+}
+
+static void on_udp_packet(guint8 *data, gsize length, GstSctpAssociation *self)
+{
+    gst_sctp_association_incoming_packet(self, data, (guint32)length);
+}
+
+/* Must be called with usrsctp_lock held */
+static GMainContext *get_worker_context(void)
+{
+    GMainLoop *loop;
+    GThread *thread;
+
+    if (!worker_context) {
+        worker_context = g_main_context_new();
+        loop = g_main_loop_new(worker_context, FALSE);
+        thread = g_thread_new("sctp_worker", (GThreadFunc)worker_thread_func, loop);
+        g_thread_unref(thread);
+    }
+
+    return worker_context;
+}
+
+static gpointer worker_thread_func(GMainLoop *loop)
+{
+    g_main_loop_run(loop);
     return NULL;
 }
 
+static gboolean connect_on_worker(GstSctpAssociation *self)
+{
+    /* TODO: Support both server and client role */
+    if (client_role_connect(self))
+        start_pmtu_probe_timer(self);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean stack_idle_teardown(gpointer user_data)
+{
+    (void)user_data;
+
+    G_LOCK(usrsctp_lock);
+    /* A new association may have cancelled the teardown while this was waiting for the lock */
+    if (!g_source_is_destroyed(g_main_current_source())) {
+        g_source_unref(stack_teardown_source);
+        stack_teardown_source = NULL;
+        finish_stack();
+    }
+    G_UNLOCK(usrsctp_lock);
+
+    return G_SOURCE_REMOVE;
+}
+
+/* Must be called with usrsctp_lock held */
+static void finish_stack(void)
+{
+    if (usrsctp_users == 0 && initialized && usrsctp_finish() == 0)
+        initialized = FALSE;
+}
+
 static gboolean client_role_connect(GstSctpAssociation *self) {
-    struct sctp_paddrparams paddrparams;
     struct sockaddr_conn addr;
-    socklen_t opt_len;
     gint ret;
 
     g_mutex_lock(&self->association_mutex);
@@ -601,29 +1512,24 @@ static gboolean client_role_connect(GstSctpAssociation *self) {
         goto error;
     }
 
-    memset(&paddrparams, 0, sizeof(struct sctp_paddrparams));
-    memcpy(&paddrparams.spp_address, &addr, sizeof(struct sockaddr_conn));
-
-    opt_len = (socklen_t)sizeof(struct sctp_paddrparams);
-    ret = usrsctp_getsockopt(self->sctp_ass_sock, IPPROTO_SCTP, SCTP_PEER_ADDR_PARAMS, &paddrparams, &opt_len);
-    if (ret < 0) {
-        g_warning("usrsctp_getsockopt() error: (%u) %s", errno, strerror(errno));
-        goto error;
-    }
-
-    // draft-ietf-rtcweb-data-channel-13 section 5: max initial MTU IPV4 1200, IPV6 1280
-    paddrparams.spp_pathmtu = 1200; // safe for either
-    paddrparams.spp_flags &= ~SPP_PMTUD_ENABLE;
-    paddrparams.spp_flags |= SPP_PMTUD_DISABLE;
-    opt_len = (socklen_t)sizeof(struct sctp_paddrparams);
-
-    ret = usrsctp_setsockopt(self->sctp_ass_sock, IPPROTO_SCTP, SCTP_PEER_ADDR_PARAMS, &paddrparams, opt_len);
-    if (ret < 0) {
-        g_warning("usrsctp_setsockopt() error: (%u) %s", errno, strerror(errno));
+    if (!set_path_mtu(self, PMTU_BASE))
         goto error;
-    }
 
-    g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "usrsctp: PMTUD disabled, MTU set to %u", paddrparams.spp_pathmtu);
+    g_mutex_lock(&self->pmtu_mutex);
+    /* A probe that is fragmented on the way gets through and would be taken as proof that
+     * the path carries packets of its size */
+    if (self->udp_transport)
+        self->pmtu_enabled = gst_sctp_udp_transport_get_dont_fragment(self->udp_transport);
+    else
+        self->pmtu_enabled = self->dont_fragment;
+    self->pmtu_enabled = self->pmtu_enabled && self->max_mtu > PMTU_BASE;
+    self->pmtu_low = PMTU_BASE;
+    self->pmtu_high = self->max_mtu;
+    self->pmtu_bisect = FALSE;
+    self->pmtu_confirming = FALSE;
+    self->pmtu_probe_size = 0;
+    self->pmtu_next_search = 0;
+    g_mutex_unlock(&self->pmtu_mutex);
 
     g_mutex_unlock(&self->association_mutex);
     return TRUE;
@@ -641,39 +1547,167 @@ static int sctp_packet_out(void *addr, void* buffer, size_t length, guint8 tos,
     } else {
       self = GST_SCTP_ASSOCIATION(addr);
 
-      if (self->packet_out_cb) {
-        self->packet_out_cb(self, buffer, length, self->packet_out_user_data);
-      }
+      record_peer_vtag(self, buffer, length);
+      output_packet(self, buffer, length);
     }
 
     return 0;
 }
 
-static int receive_cb(struct socket *sock, union sctp_sockstore addr, void *data, size_t datalen,
-    struct sctp_rcvinfo rcv_info, gint flags, void *ulp_info)
+static void socket_upcall(struct socket *sock, void *arg, gint flags)
 {
-    GstSctpAssociation *self;
+    GstSctpAssociation *self = GST_SCTP_ASSOCIATION(arg);
+    gint events;
+
+    (void)flags;
+
+    /* Called from within the usrsctp stack, possibly while the association mutex is held,
+     * so neither this nor the notification handlers that receive_pending_data() reaches may
+     * take it. The ready-to-send callback is made from here as well, see the header. */
+    events = usrsctp_get_events(sock);
+    if (events & SCTP_EVENT_READ)
+        receive_pending_data(self);
+    if (events & SCTP_EVENT_WRITE) {
+        notify_ready_to_send(self);
+        /* Space in the send buffer may come from a timer, with no packet received */
+        schedule_send_buffer_report(self);
+    }
+}
+
+/* The callers of resume are draining a queue downstream of the packet received callback.
+ * Reading there would run the whole receive path, stream resets and state notifications
+ * included, on that thread, so it is left to the next iteration of the worker context. */
+static void schedule_receive(GstSctpAssociation *self)
+{
+    GMainContext *context;
+    GSource *source;
+
+    G_LOCK(usrsctp_lock);
+    context = get_worker_context();
+    G_UNLOCK(usrsctp_lock);
+
+    source = g_idle_source_new();
+    g_source_set_priority(source, G_PRIORITY_DEFAULT);
+    g_source_set_callback(source, (GSourceFunc)receive_on_worker, g_object_ref(self),
+        g_object_unref);
+    g_source_attach(source, context);
+    g_source_unref(source);
+}
+
+static gboolean receive_on_worker(GstSctpAssociation *self)
+{
+    receive_pending_data(self);
+    /* The association may have come up while paused */
+    check_message_interleaving(self);
+    return G_SOURCE_REMOVE;
+}
 
-    if (!GST_SCTP_ASSOCIATION (ulp_info)) {
-      g_warning("No asctp association to manage data buffer");
-      return 1;
+static void receive_pending_data(GstSctpAssociation *self)
+{
+    /* Only one thread drains the socket at a time. A thread that finds it busy leaves
+     * receive_pending set, and the draining thread goes another round before leaving */
+    g_atomic_int_set(&self->receive_pending, 1);
+    while (g_atomic_int_get(&self->receive_pending) && g_mutex_trylock(&self->receive_mutex)) {
+        g_atomic_int_set(&self->receive_pending, 0);
+        while (g_atomic_int_get(&self->receive_paused) <= 0 && receive_one(self))
+            ;
+        g_mutex_unlock(&self->receive_mutex);
     }
+}
 
-    self = GST_SCTP_ASSOCIATION(ulp_info);
+/* Must be called with receive_mutex held. Returns FALSE when there is nothing more to read. */
+static gboolean receive_one(GstSctpAssociation *self)
+{
+    struct sctp_rcvinfo rcv_info;
+    struct sockaddr_conn from;
+    socklen_t from_len = (socklen_t)sizeof(from);
+    socklen_t info_len = (socklen_t)sizeof(rcv_info);
+    guint info_type = SCTP_RECVV_NOINFO;
+    gint flags = 0;
+    ssize_t length;
+    guint8 *data;
+    gsize data_length;
+    gpointer key;
+    GByteArray *partial_message;
+    GstSctpAssociationMessageFlags message_flags;
+
+    if (!self->sctp_ass_sock)
+        return FALSE;
+
+    memset(&rcv_info, 0, sizeof(rcv_info));
+    length = usrsctp_recvv(self->sctp_ass_sock, self->receive_buffer, RECEIVE_BUFFER_SIZE,
+        (struct sockaddr *)&from, &from_len, (void *)&rcv_info, &info_len, &info_type, &flags);
+    if (length < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            g_warning("Error receiving data: (%u) %s", errno, strerror(errno));
+        return FALSE;
+    } else if (length == 0) {
+        return FALSE;
+    }
 
-    if (!data) {
-        /* Not sure if this can happend. */
-        g_warning("Received empty data buffer");
-    } else {
-        if (flags & MSG_NOTIFICATION) {
-            handle_notification(self, (const union sctp_notification *)data, datalen);
-            free(data);
+    if (flags & MSG_NOTIFICATION)
+        key = PARTIAL_NOTIFICATION_KEY;
+    else
+        key = PARTIAL_MESSAGE_KEY(rcv_info.rcv_sid, rcv_info.rcv_flags & SCTP_UNORDERED);
+
+    if (self->partial_delivery && !(flags & MSG_NOTIFICATION)) {
+        /* Hand each part over as it is read, only remembering that a message is in progress */
+        if (g_hash_table_contains(self->partial_deliveries, key))
+            message_flags = 0;
+        else
+            message_flags = GST_SCTP_ASSOCIATION_MESSAGE_BEGIN;
+
+        if (flags & MSG_EOR) {
+            message_flags |= GST_SCTP_ASSOCIATION_MESSAGE_END;
+            g_hash_table_remove(self->partial_deliveries, key);
         } else {
-            handle_message(self, data, datalen, rcv_info.rcv_sid, ntohl(rcv_info.rcv_ppid));
+            g_hash_table_add(self->partial_deliveries, key);
+        }
+
+        handle_message(self, g_memdup(self->receive_buffer, (guint)length), (guint32)length,
+            rcv_info.rcv_sid, ntohl(rcv_info.rcv_ppid), message_flags);
+        return TRUE;
+    }
+
+    partial_message = g_hash_table_lookup(self->partial_messages, key);
+
+    if (!(flags & MSG_EOR)) {
+        /* Message larger than the receive buffer or the partial delivery point, the rest
+         * comes in later reads, possibly interleaved with other streams */
+        if (!partial_message) {
+            partial_message = g_byte_array_new();
+            g_hash_table_insert(self->partial_messages, key, partial_message);
         }
+        g_byte_array_append(partial_message, self->receive_buffer, (guint)length);
+        return TRUE;
+    }
+
+    if (partial_message) {
+        g_hash_table_steal(self->partial_messages, key);
+        g_byte_array_append(partial_message, self->receive_buffer, (guint)length);
+        data_length = partial_message->len;
+        data = g_byte_array_free(partial_message, FALSE);
+    } else {
+        data_length = (gsize)length;
+        data = g_memdup(self->receive_buffer, (guint)length);
+    }
+
+    if (flags & MSG_NOTIFICATION) {
+        handle_notification(self, (const union sctp_notification *)data, data_length);
+        g_free(data);
+    } else {
+        handle_message(self, data, (guint32)data_length, rcv_info.rcv_sid, ntohl(rcv_info.rcv_ppid),
+            GST_SCTP_ASSOCIATION_MESSAGE_BEGIN | GST_SCTP_ASSOCIATION_MESSAGE_END);
     }
 
-    return 1;
+    return TRUE;
+}
+
+static void notify_ready_to_send(GstSctpAssociation *self)
+{
+    if (self->ready_to_send_cb) {
+        self->ready_to_send_cb(self, self->ready_to_send_user_data);
+    }
 }
 
 static void handle_notification(GstSctpAssociation *self, const union sctp_notification *notification,
@@ -694,6 +1728,7 @@ static void handle_notification(GstSctpAssociation *self, const union sctp_notif
         break;
     case SCTP_SEND_FAILED:
         g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_SEND_FAILED");
+        handle_send_failed(self, &notification->sn_send_failed);
         break;
     case SCTP_SHUTDOWN_EVENT:
         g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_SHUTDOWN_EVENT");
@@ -703,6 +1738,7 @@ static void handle_notification(GstSctpAssociation *self, const union sctp_notif
         break;
     case SCTP_PARTIAL_DELIVERY_EVENT:
         g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_PARTIAL_DELIVERY_EVENT");
+        handle_partial_delivery_event(self, &notification->sn_pdapi_event);
         break;
     case SCTP_AUTHENTICATION_EVENT:
         g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_AUTHENTICATION_EVENT");
@@ -713,6 +1749,7 @@ static void handle_notification(GstSctpAssociation *self, const union sctp_notif
         break;
     case SCTP_SENDER_DRY_EVENT:
         g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_SENDER_DRY_EVENT");
+        notify_ready_to_send(self);
         break;
     case SCTP_NOTIFICATIONS_STOPPED_EVENT:
         g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Event: SCTP_NOTIFICATIONS_STOPPED_EVENT");
@@ -734,22 +1771,22 @@ static void handle_notification(GstSctpAssociation *self, const union sctp_notif
 static void handle_association_changed(GstSctpAssociation *self, const struct sctp_assoc_change *sac)
 {
     gboolean change_state = FALSE;
-    GstSctpAssociationState new_state;
 
     switch (sac->sac_state) {
     case SCTP_COMM_UP:
         g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "SCTP_COMM_UP()");
-        g_mutex_lock(&self->association_mutex);
-        if (self->state == GST_SCTP_ASSOCIATION_STATE_CONNECTING) {
+        /* Without the association mutex, see socket_upcall(). The id is published before
+         * the state, and is only used by readers that see the association connected. */
+        g_atomic_int_set((gint *)&self->sctp_assoc_id, (gint)sac->sac_assoc_id);
+        if (g_atomic_int_compare_and_exchange((gint *)&self->state,
+            GST_SCTP_ASSOCIATION_STATE_CONNECTING, GST_SCTP_ASSOCIATION_STATE_CONNECTED)) {
             change_state = TRUE;
-            new_state = GST_SCTP_ASSOCIATION_STATE_CONNECTED;
             g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "SCTP association connected!");
-        } else if (self->state == GST_SCTP_ASSOCIATION_STATE_CONNECTED) {
+        } else if (g_atomic_int_get((gint *)&self->state) == GST_SCTP_ASSOCIATION_STATE_CONNECTED) {
             g_warning("SCTP association already open");
         } else {
             g_warning("SCTP association in unexpected state");
         }
-        g_mutex_unlock(&self->association_mutex);
         break;
     case SCTP_COMM_LOST:
         g_warning("SCTP event SCTP_COMM_LOST received");
@@ -767,8 +1804,43 @@ static void handle_association_changed(GstSctpAssociation *self, const struct sc
         break;
     }
 
-    if (change_state)
-        gst_sctp_association_change_state(self, new_state, TRUE);
+    if (change_state) {
+        /* The state is already set, a concurrent close must not be overwritten */
+        g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_STATE]);
+        /* Sends refused while connecting can be retried now */
+        notify_ready_to_send(self);
+    }
+}
+
+static void handle_partial_delivery_event(GstSctpAssociation *self,
+    const struct sctp_pdapi_event *pdapi)
+{
+    if (pdapi->pdapi_indication != SCTP_PARTIAL_DELIVERY_ABORTED)
+        return;
+
+    /* The rest of the message will never arrive. The event does not say whether the message
+     * was ordered, so drop both. With partial-delivery the receiver sees the next message
+     * begin without the previous one having ended. */
+    g_warning("Partial delivery aborted on stream %u", pdapi->pdapi_stream);
+    g_hash_table_remove(self->partial_messages, PARTIAL_MESSAGE_KEY(pdapi->pdapi_stream, FALSE));
+    g_hash_table_remove(self->partial_messages, PARTIAL_MESSAGE_KEY(pdapi->pdapi_stream, TRUE));
+    g_hash_table_remove(self->partial_deliveries, PARTIAL_MESSAGE_KEY(pdapi->pdapi_stream, FALSE));
+    g_hash_table_remove(self->partial_deliveries, PARTIAL_MESSAGE_KEY(pdapi->pdapi_stream, TRUE));
+}
+
+/* Sent for PR-SCTP messages that are abandoned, and for anything left unsent when the
+ * association goes down */
+static void handle_send_failed(GstSctpAssociation *self, const struct sctp_send_failed *ssf)
+{
+    gpointer key = GUINT_TO_POINTER(ssf->ssf_info.sinfo_stream);
+    guint count;
+
+    /* A leaf lock, never held while calling into usrsctp, see socket_upcall() */
+    g_mutex_lock(&self->abandoned_mutex);
+    count = GPOINTER_TO_UINT(g_hash_table_lookup(self->abandoned_messages, key));
+    g_hash_table_insert(self->abandoned_messages, key, GUINT_TO_POINTER(count + 1));
+    self->abandoned_messages_total++;
+    g_mutex_unlock(&self->abandoned_mutex);
 }
 
 static void handle_stream_reset_event(GstSctpAssociation *self,
@@ -787,17 +1859,321 @@ static void handle_stream_reset_event(GstSctpAssociation *self,
 }
 
 static void handle_message(GstSctpAssociation *self, guint8 *data, guint32 datalen, guint16 stream_id,
-    guint32 ppid)
+    guint32 ppid, GstSctpAssociationMessageFlags flags)
 {
     if (self->packet_received_cb) {
-        self->packet_received_cb(self, data, datalen, stream_id, ppid, self->packet_received_user_data);
+        self->packet_received_cb(self, data, datalen, stream_id, ppid, flags,
+            self->packet_received_user_data);
     }
 }
 
 static void gst_sctp_association_change_state(GstSctpAssociation *self, GstSctpAssociationState new_state,
     gboolean notify)
 {
-    self->state = new_state;
+    /* Read without the association mutex by send_data() */
+    g_atomic_int_set((gint *)&self->state, new_state);
     if (notify)
         g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_STATE]);
 }
+
+/* Must be called with association_mutex held */
+static gboolean set_path_mtu(GstSctpAssociation *self, guint mtu)
+{
+    struct sctp_paddrparams paddrparams;
+    struct sockaddr_conn addr;
+    socklen_t opt_len;
+
+    if (!self->sctp_ass_sock)
+        return FALSE;
+
+    addr = get_sctp_socket_address(self, self->remote_port);
+    memset(&paddrparams, 0, sizeof(struct sctp_paddrparams));
+    memcpy(&paddrparams.spp_address, &addr, sizeof(struct sockaddr_conn));
+
+    opt_len = (socklen_t)sizeof(struct sctp_paddrparams);
+    if (usrsctp_getsockopt(self->sctp_ass_sock, IPPROTO_SCTP, SCTP_PEER_ADDR_PARAMS, &paddrparams,
+        &opt_len) < 0) {
+        g_warning("usrsctp_getsockopt() error: (%u) %s", errno, strerror(errno));
+        return FALSE;
+    }
+
+    /* usrsctp never learns about the path over AF_CONN, so its own PMTUD stays off and
+     * the MTU is what pmtu_probe_tick() has found to work */
+    paddrparams.spp_pathmtu = mtu;
+    paddrparams.spp_flags &= ~SPP_PMTUD_ENABLE;
+    paddrparams.spp_flags |= SPP_PMTUD_DISABLE;
+    opt_len = (socklen_t)sizeof(struct sctp_paddrparams);
+
+    if (usrsctp_setsockopt(self->sctp_ass_sock, IPPROTO_SCTP, SCTP_PEER_ADDR_PARAMS, &paddrparams,
+        opt_len) < 0) {
+        g_warning("usrsctp_setsockopt() error: (%u) %s", errno, strerror(errno));
+        return FALSE;
+    }
+
+    g_atomic_int_set(&self->mtu, mtu);
+    g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "usrsctp: PMTUD disabled, MTU set to %u", mtu);
+    return TRUE;
+}
+
+static guint32 get_uint32_be(const guint8 *data)
+{
+    return ((guint32)data[0] << 24) | ((guint32)data[1] << 16) | ((guint32)data[2] << 8) | data[3];
+}
+
+/* Probes are sent with the peer's verification tag, which is taken from what the stack sends */
+static void record_peer_vtag(GstSctpAssociation *self, const guint8 *buf, size_t length)
+{
+    guint32 vtag;
+
+    /* INIT carries a zero tag and an ABORT may carry our own */
+    if (length < SCTP_COMMON_HEADER_LENGTH + 4 || buf[SCTP_COMMON_HEADER_LENGTH] == SCTP_CHUNK_ABORT)
+        return;
+
+    vtag = get_uint32_be(buf + 4);
+    if (vtag != 0)
+        g_atomic_int_set(&self->peer_vtag, vtag);
+}
+
+static void send_pmtu_probe(GstSctpAssociation *self, guint size, guint32 seq)
+{
+    guint8 *packet;
+
+    packet = g_malloc(size);
+    gst_sctp_pmtu_probe_build(packet, size, self->local_port, self->remote_port,
+        g_atomic_int_get(&self->peer_vtag), seq);
+    output_packet(self, packet, size);
+    g_free(packet);
+}
+
+/* A simplified RFC 8899 search. The largest size known to work is pmtu_low and sizes above
+ * pmtu_high are known or assumed not to. max-mtu is tried first, after that the range is
+ * bisected. Once done, the current MTU is confirmed and a larger one looked for every
+ * PMTU_RAISE_INTERVAL, falling back to PMTU_BASE if the current one stopped working. */
+static void pmtu_probe_tick(GstSctpAssociation *self, guint acked_size, guint32 acked_seq)
+{
+    gint64 now;
+    guint probe_size = 0, new_mtu = 0;
+    guint32 probe_seq = 0;
+    gboolean mtu_changed = FALSE;
+
+    if (!g_atomic_int_get(&self->peer_vtag))
+        return;
+
+    now = g_get_monotonic_time();
+    g_mutex_lock(&self->pmtu_mutex);
+    if (!self->pmtu_enabled) {
+        g_mutex_unlock(&self->pmtu_mutex);
+        return;
+    }
+
+    if (self->pmtu_probe_size) {
+        if (acked_size == self->pmtu_probe_size && acked_seq == self->pmtu_probe_seq) {
+            if (self->pmtu_probe_size != (guint)g_atomic_int_get(&self->mtu))
+                new_mtu = self->pmtu_probe_size;
+            self->pmtu_low = self->pmtu_probe_size;
+            self->pmtu_probe_size = 0;
+            self->pmtu_confirming = FALSE;
+        } else if (now - self->pmtu_probe_sent >= PMTU_PROBE_TIMEOUT) {
+            if (++self->pmtu_probe_count < PMTU_MAX_PROBES) {
+                probe_size = self->pmtu_probe_size;
+            } else if (self->pmtu_confirming) {
+                new_mtu = PMTU_BASE;
+                self->pmtu_low = PMTU_BASE;
+                self->pmtu_high = self->max_mtu;
+                self->pmtu_bisect = FALSE;
+                self->pmtu_confirming = FALSE;
+                self->pmtu_probe_size = 0;
+            } else {
+                self->pmtu_high = self->pmtu_probe_size - 4;
+                self->pmtu_bisect = TRUE;
+                self->pmtu_probe_size = 0;
+            }
+        }
+    }
+
+    if (!self->pmtu_probe_size) {
+        if (self->pmtu_high > self->pmtu_low) {
+            if (self->pmtu_bisect)
+                probe_size = PMTU_ALIGN(self->pmtu_low + (self->pmtu_high - self->pmtu_low + 4) / 2);
+            else
+                probe_size = self->pmtu_high;
+        } else if (self->max_mtu > PMTU_BASE) {
+            if (!self->pmtu_next_search) {
+                self->pmtu_next_search = now + PMTU_RAISE_INTERVAL;
+            } else if (now >= self->pmtu_next_search) {
+                self->pmtu_next_search = 0;
+                self->pmtu_high = self->max_mtu;
+                self->pmtu_bisect = FALSE;
+                if (self->pmtu_low > PMTU_BASE) {
+                    self->pmtu_confirming = TRUE;
+                    probe_size = self->pmtu_low;
+                }
+            }
+        }
+
+        if (probe_size) {
+            self->pmtu_probe_size = probe_size;
+            self->pmtu_probe_count = 0;
+            self->pmtu_probe_seq++;
+        }
+    }
+
+    if (probe_size) {
+        probe_seq = self->pmtu_probe_seq;
+        self->pmtu_probe_sent = now;
+    }
+    g_mutex_unlock(&self->pmtu_mutex);
+
+    if (probe_size)
+        send_pmtu_probe(self, probe_size, probe_seq);
+
+    if (new_mtu) {
+        g_mutex_lock(&self->association_mutex);
+        mtu_changed = set_path_mtu(self, new_mtu);
+        g_mutex_unlock(&self->association_mutex);
+        if (mtu_changed)
+            g_object_notify_by_pspec(G_OBJECT(self), properties[PROP_MTU]);
+    }
+}
+
+static gboolean pmtu_probe_timeout(GstSctpAssociation *self)
+{
+    pmtu_probe_tick(self, 0, 0);
+    return G_SOURCE_CONTINUE;
+}
+
+/* Probe timeouts and the periodic search for a larger MTU are run from the worker context,
+ * until gst_sctp_association_force_close() */
+static void start_pmtu_probe_timer(GstSctpAssociation *self)
+{
+    GMainContext *context;
+    GSource *source;
+
+    G_LOCK(usrsctp_lock);
+    context = get_worker_context();
+    G_UNLOCK(usrsctp_lock);
+
+    g_mutex_lock(&self->pmtu_mutex);
+    if (self->pmtu_enabled && !self->pmtu_timer) {
+        source = g_timeout_source_new(PMTU_PROBE_TIMEOUT / 1000);
+        g_source_set_callback(source, (GSourceFunc)pmtu_probe_timeout, g_object_ref(self),
+            g_object_unref);
+        g_source_attach(source, context);
+        self->pmtu_timer = source;
+    }
+    g_mutex_unlock(&self->pmtu_mutex);
+}
+
+static void free_association_entry(AssociationEntry *entry)
+{
+    g_weak_ref_clear(&entry->ref);
+    g_slice_free(AssociationEntry, entry);
+}
+
+/* Acknowledged and abandoned data leaves the send buffer while usrsctp handles an incoming
+ * packet. The send buffer is queried here rather than from socket_upcall(), which must not
+ * call back into usrsctp. bytes_accepted is read first, so that data being sent meanwhile
+ * can only make bytes_drained lag behind until the next packet, never run ahead. */
+static void report_send_buffer_drained(GstSctpAssociation *self)
+{
+    struct sctp_sockstat sockstat;
+    socklen_t len;
+    guint32 bytes_accepted, bytes_drained;
+    gboolean drained = FALSE;
+
+    if (!self->send_buffer_drained_cb)
+        return;
+
+    g_mutex_lock(&self->association_mutex);
+    if (self->state == GST_SCTP_ASSOCIATION_STATE_CONNECTED && self->sctp_ass_sock) {
+        bytes_accepted = (guint32)g_atomic_int_get(&self->bytes_accepted);
+        memset(&sockstat, 0, sizeof(sockstat));
+        sockstat.ss_assoc_id = self->sctp_assoc_id;
+        len = (socklen_t)sizeof(sockstat);
+        if (usrsctp_getsockopt(self->sctp_ass_sock, IPPROTO_SCTP, SCTP_GET_SNDBUF_USE, &sockstat,
+            &len) == 0) {
+            bytes_drained = bytes_accepted - sockstat.ss_total_sndbuf;
+            if ((gint32)(bytes_drained - self->bytes_drained) > 0) {
+                self->bytes_drained = bytes_drained;
+                drained = TRUE;
+            }
+        }
+    }
+    bytes_drained = self->bytes_drained;
+    g_mutex_unlock(&self->association_mutex);
+
+    if (drained)
+        self->send_buffer_drained_cb(self, bytes_drained, self->send_buffer_drained_user_data);
+}
+
+/* Coalesces the reports requested from within usrsctp, where the send buffer cannot be
+ * queried, into one on the worker context */
+static void schedule_send_buffer_report(GstSctpAssociation *self)
+{
+    GMainContext *context;
+    GSource *source;
+
+    if (!self->send_buffer_drained_cb
+        || !g_atomic_int_compare_and_exchange(&self->send_buffer_report_scheduled, FALSE, TRUE))
+        return;
+
+    G_LOCK(usrsctp_lock);
+    context = get_worker_context();
+    G_UNLOCK(usrsctp_lock);
+
+    source = g_idle_source_new();
+    g_source_set_priority(source, G_PRIORITY_DEFAULT);
+    g_source_set_callback(source, (GSourceFunc)report_send_buffer_on_worker, g_object_ref(self),
+        g_object_unref);
+    g_source_attach(source, context);
+    g_source_unref(source);
+}
+
+static gboolean report_send_buffer_on_worker(GstSctpAssociation *self)
+{
+    g_atomic_int_set(&self->send_buffer_report_scheduled, FALSE);
+    report_send_buffer_drained(self);
+    return G_SOURCE_REMOVE;
+}
+
+/* Only with I-DATA (RFC 8260) may a message be sent in several usrsctp_sendv() calls. Without
+ * it usrsctp locks the stream scheduler onto an incomplete message and sends on every other
+ * stream fail until it is complete. Explicit EOR is turned off then, so that each send is a
+ * complete message that the stack takes whole or not at all. Runs after usrsctp_conninput(),
+ * as socket options cannot be set from within usrsctp callbacks. */
+static void check_message_interleaving(GstSctpAssociation *self)
+{
+    struct sctp_assoc_value interleaving;
+    socklen_t len;
+    int value = 0;
+    gboolean settled = FALSE;
+
+    if (g_atomic_int_get(&self->message_interleaving) != -1)
+        return;
+
+    g_mutex_lock(&self->association_mutex);
+    if (self->message_interleaving == -1 && self->state == GST_SCTP_ASSOCIATION_STATE_CONNECTED
+        && self->sctp_ass_sock) {
+        memset(&interleaving, 0, sizeof(interleaving));
+        interleaving.assoc_id = self->sctp_assoc_id;
+        len = (socklen_t)sizeof(interleaving);
+        if (usrsctp_getsockopt(self->sctp_ass_sock, IPPROTO_SCTP, SCTP_INTERLEAVING_SUPPORTED,
+            &interleaving, &len) < 0) {
+            g_warning("Could not get SCTP_INTERLEAVING_SUPPORTED");
+            interleaving.assoc_value = 0;
+        }
+        if (!interleaving.assoc_value && usrsctp_setsockopt(self->sctp_ass_sock, IPPROTO_SCTP,
+            SCTP_EXPLICIT_EOR, &value, sizeof(int)))
+            g_warning("Could not unset SCTP_EXPLICIT_EOR");
+
+        g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, "Message interleaving %s",
+            interleaving.assoc_value ? "negotiated" : "not supported by the peer");
+        g_atomic_int_set(&self->message_interleaving, interleaving.assoc_value ? 1 : 0);
+        settled = TRUE;
+    }
+    g_mutex_unlock(&self->association_mutex);
+
+    /* Sends were refused until now */
+    if (settled)
+        notify_ready_to_send(self);
+}
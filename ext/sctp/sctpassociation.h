@@ -31,6 +31,8 @@
 #define INET6
 #include <usrsctp.h>
 
+#include "sctpudptransport.h"
+
 /*
  * Type macros.
  */
@@ -40,6 +42,8 @@
 #define GST_SCTP_ASSOCIATION_CLASS(klass)          (G_TYPE_CHECK_CLASS_CAST ((klass), GST_SCTP_TYPE_ASSOCIATION, GstSctpAssociationClass))
 #define GST_SCTP_IS_ASSOCIATION_CLASS(klass)       (G_TYPE_CHECK_CLASS_TYPE ((klass), GST_SCTP_TYPE_ASSOCIATION))
 #define GST_SCTP_ASSOCIATION_GET_CLASS(obj)        (G_TYPE_INSTANCE_GET_CLASS ((obj), GST_SCTP_TYPE_ASSOCIATION, GstSctpAssociationClass))
+#define GST_SCTP_TYPE_ASSOCIATION_STREAM_SCHEDULER (gst_sctp_association_stream_scheduler_get_type ())
+#define GST_SCTP_TYPE_ASSOCIATION_CONGESTION_CONTROL (gst_sctp_association_congestion_control_get_type ())
 
 typedef struct _GstSctpAssociation        GstSctpAssociation;
 typedef struct _GstSctpAssociationClass   GstSctpAssociationClass;
@@ -61,8 +65,64 @@ typedef enum {
     GST_SCTP_ASSOCIATION_PARTIAL_RELIABILITY_RTX = 0x0003
 } GstSctpAssociationPartialReliability;
 
-typedef void (*GstSctpAssociationPacketReceivedCb) (GstSctpAssociation *sctp_association, guint8 *data, gsize length, guint16 stream_id, guint ppid, gpointer user_data);
+/* Maps to the usrsctp SCTP_SS_* stream schedulers */
+typedef enum {
+    GST_SCTP_ASSOCIATION_STREAM_SCHEDULER_DEFAULT,
+    GST_SCTP_ASSOCIATION_STREAM_SCHEDULER_ROUND_ROBIN,
+    GST_SCTP_ASSOCIATION_STREAM_SCHEDULER_ROUND_ROBIN_PACKET,
+    GST_SCTP_ASSOCIATION_STREAM_SCHEDULER_PRIORITY,
+    GST_SCTP_ASSOCIATION_STREAM_SCHEDULER_FAIR_BANDWIDTH,
+    GST_SCTP_ASSOCIATION_STREAM_SCHEDULER_FIRST_COME
+} GstSctpAssociationStreamScheduler;
+
+/* Maps to the usrsctp SCTP_CC_* congestion control modules */
+typedef enum {
+    GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_RFC4960,
+    GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_HSTCP,
+    GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_HTCP,
+    GST_SCTP_ASSOCIATION_CONGESTION_CONTROL_RTCC
+} GstSctpAssociationCongestionControl;
+
+/* Which part of a message a received buffer holds. Whole messages have both flags set, see
+ * the partial-delivery property */
+typedef enum {
+    GST_SCTP_ASSOCIATION_MESSAGE_BEGIN = (1 << 0),
+    GST_SCTP_ASSOCIATION_MESSAGE_END = (1 << 1)
+} GstSctpAssociationMessageFlags;
+
+/* See gst_sctp_association_send_data(). WOULD_BLOCK is retried once the ready-to-send
+ * callback has been called, ERROR is final. */
+typedef enum {
+    GST_SCTP_ASSOCIATION_SEND_OK,
+    GST_SCTP_ASSOCIATION_SEND_WOULD_BLOCK,
+    GST_SCTP_ASSOCIATION_SEND_ERROR
+} GstSctpAssociationSendResult;
+
+/* See gst_sctp_association_get_stats(). Path values are those of the primary path, times are
+ * in milliseconds and sizes in bytes. */
+typedef struct {
+    guint32 cwnd;
+    guint32 peer_rwnd;
+    guint32 srtt;
+    guint32 rto;
+    guint32 mtu;
+    guint32 unacked_chunks;
+    guint32 pending_chunks;
+    guint32 send_buffer_used;
+    guint64 abandoned_messages;
+    /* Packets the UDP transport dropped instead of blocking usrsctp, 0 without one */
+    guint64 udp_dropped_packets;
+    /* For all associations in the process, usrsctp does not count these per association */
+    guint64 stack_retransmissions;
+} GstSctpAssociationStats;
+
+typedef void (*GstSctpAssociationPacketReceivedCb) (GstSctpAssociation *sctp_association, guint8 *data, gsize length, guint16 stream_id, guint ppid, GstSctpAssociationMessageFlags flags, gpointer user_data);
 typedef void (*GstSctpAssociationPacketOutCb) (GstSctpAssociation *sctp_association, const guint8 *data, gsize length, gpointer user_data);
+/* Called from within usrsctp callbacks, possibly with internal usrsctp and association locks
+ * held. It must only wake up the senders, which call gst_sctp_association_send_data() from
+ * their own threads. */
+typedef void (*GstSctpAssociationReadyToSendCb) (GstSctpAssociation *sctp_association, gpointer user_data);
+typedef void (*GstSctpAssociationSendBufferDrainedCb) (GstSctpAssociation *sctp_association, guint32 bytes_drained, gpointer user_data);
 
 struct _GstSctpAssociation
 {
@@ -72,19 +132,86 @@ struct _GstSctpAssociation
     guint16 local_port;
     guint16 remote_port;
     gboolean use_sock_stream;
+    gboolean partial_delivery;
+    GstSctpAssociationStreamScheduler stream_scheduler;
+    GstSctpAssociationCongestionControl congestion_control;
+    guint rto_initial;
+    guint rto_min;
+    guint rto_max;
+    guint send_buffer_size;
+    guint receive_buffer_size;
+    guint sack_delay;
+    guint sack_frequency;
+    guint stack_idle_timeout;
+    gboolean compute_checksum;
+    gboolean verify_checksum;
     struct socket *sctp_ass_sock;
+    sctp_assoc_t sctp_assoc_id;
+    /* Whether I-DATA was negotiated, -1 until that is known. Written under association_mutex */
+    gint message_interleaving;
 
     GMutex association_mutex;
+    /* Held for reading while sending, so sends do not serialise on association_mutex, and
+     * for writing while the socket is closed */
+    GRWLock socket_lock;
 
     GstSctpAssociationState state;
 
-    GThread *connection_thread;
-
     GstSctpAssociationPacketReceivedCb packet_received_cb;
     gpointer packet_received_user_data;
 
     GstSctpAssociationPacketOutCb packet_out_cb;
     gpointer packet_out_user_data;
+
+    /* When udp-remote-address is set, packets go over a UDP socket of the association's own
+     * instead of through packet_out_cb and gst_sctp_association_incoming_packet() */
+    gchar *udp_remote_address;
+    guint16 udp_remote_port;
+    guint16 udp_local_port;
+    GstSctpUdpTransport *udp_transport;
+
+    GstSctpAssociationReadyToSendCb ready_to_send_cb;
+    gpointer ready_to_send_user_data;
+
+    /* Running totals of the bytes accepted by send_data() and of the bytes that have left
+     * the send buffer since, both wrap around. bytes_drained is protected by association_mutex */
+    guint bytes_accepted;
+    guint32 bytes_drained;
+    GstSctpAssociationSendBufferDrainedCb send_buffer_drained_cb;
+    gpointer send_buffer_drained_user_data;
+    gint send_buffer_report_scheduled;
+
+    GMutex receive_mutex;
+    guint8 *receive_buffer;
+    GHashTable *partial_messages;
+    GHashTable *partial_deliveries;
+
+    /* Abandoned PR-SCTP messages per stream id, protected by abandoned_mutex as they are
+     * counted from within usrsctp */
+    GMutex abandoned_mutex;
+    GHashTable *abandoned_messages;
+    guint64 abandoned_messages_total;
+    gint receive_paused;
+    gint receive_pending;
+
+    /* Path MTU discovery, see pmtu_probe_tick() */
+    GMutex pmtu_mutex;
+    guint max_mtu;
+    guint mtu;
+    guint32 peer_vtag;
+    guint pmtu_low;
+    guint pmtu_high;
+    gboolean pmtu_bisect;
+    gboolean pmtu_confirming;
+    guint pmtu_probe_size;
+    guint pmtu_probe_count;
+    guint32 pmtu_probe_seq;
+    gint64 pmtu_probe_sent;
+    gint64 pmtu_next_search;
+    /* Only probed for when the transport does not fragment, see dont-fragment */
+    gboolean dont_fragment;
+    gboolean pmtu_enabled;
+    GSource *pmtu_timer;
 };
 
 struct _GstSctpAssociationClass {
@@ -94,17 +221,28 @@ struct _GstSctpAssociationClass {
 };
 
 GType gst_sctp_association_get_type(void);
+GType gst_sctp_association_stream_scheduler_get_type(void);
+GType gst_sctp_association_congestion_control_get_type(void);
 
 GstSctpAssociation *gst_sctp_association_get(guint32 association_id);
 
 gboolean gst_sctp_association_start(GstSctpAssociation *self);
 void gst_sctp_association_set_on_packet_out(GstSctpAssociation *self, GstSctpAssociationPacketOutCb packet_out_cb, gpointer user_data);
+void gst_sctp_association_set_on_ready_to_send(GstSctpAssociation *self, GstSctpAssociationReadyToSendCb ready_to_send_cb, gpointer user_data);
 void gst_sctp_association_set_on_packet_received(GstSctpAssociation *self, GstSctpAssociationPacketReceivedCb packet_received_cb, gpointer user_data);
+void gst_sctp_association_set_on_send_buffer_drained(GstSctpAssociation *self, GstSctpAssociationSendBufferDrainedCb send_buffer_drained_cb, gpointer user_data);
 void gst_sctp_association_incoming_packet(GstSctpAssociation *self, guint8 *buf, guint32 length);
-gboolean gst_sctp_association_send_data(GstSctpAssociation *self, guint8 *buf, guint32 length,
+void gst_sctp_association_pause_receive(GstSctpAssociation *self);
+void gst_sctp_association_resume_receive(GstSctpAssociation *self);
+GstSctpAssociationSendResult gst_sctp_association_send_data(GstSctpAssociation *self, const guint8 *buf, guint32 length,
     guint16 stream_id, guint32 ppid, gboolean ordered, GstSctpAssociationPartialReliability pr,
-    guint32 reliability_param);
+    guint32 reliability_param, gboolean end_of_record, guint32 *bytes_sent);
 void gst_sctp_association_reset_stream(GstSctpAssociation *self, guint16 stream_id);
+gboolean gst_sctp_association_set_stream_priority(GstSctpAssociation *self, guint16 stream_id,
+    guint16 priority);
 void gst_sctp_association_force_close(GstSctpAssociation *self);
+gboolean gst_sctp_association_get_message_interleaving(GstSctpAssociation *self);
+gboolean gst_sctp_association_get_stats(GstSctpAssociation *self, GstSctpAssociationStats *stats);
+guint gst_sctp_association_get_abandoned_messages(GstSctpAssociation *self, guint16 stream_id);
 
 #endif /* __GST_SCTP_ASSOCIATION_H__ */
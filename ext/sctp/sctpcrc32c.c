@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2015, Ericsson AB. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "sctpcrc32c.h"
+
+#include <string.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define HAVE_CRC32C_SSE42 1
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__aarch64__) && defined(__linux__)
+#define HAVE_CRC32C_ARMV8 1
+#include <sys/auxv.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#endif
+
+/* Castagnoli polynomial, reflected */
+#define CRC32C_POLYNOMIAL 0x82f63b78
+
+typedef guint32 (*Crc32cUpdateFunc) (guint32 crc, const guint8 *data, gsize length);
+
+static guint32 crc32c_table[8][256];
+
+static Crc32cUpdateFunc get_crc32c_update(void);
+static guint32 crc32c_update_sw(guint32 crc, const guint8 *data, gsize length);
+
+guint32 gst_sctp_crc32c_packet(const guint8 *packet, gsize length)
+{
+    static const guint8 zero_checksum[4] = { 0, 0, 0, 0 };
+    Crc32cUpdateFunc update = get_crc32c_update();
+    guint32 crc = 0xffffffff;
+
+    g_return_val_if_fail(length >= 12, 0);
+
+    crc = update(crc, packet, 8);
+    crc = update(crc, zero_checksum, sizeof(zero_checksum));
+    crc = update(crc, packet + 12, length - 12);
+
+    return GUINT32_TO_LE(~crc);
+}
+
+/* Slicing-by-8 */
+static guint32 crc32c_update_sw(guint32 crc, const guint8 *data, gsize length)
+{
+    guint32 low, high;
+
+    while (length && ((guintptr)data & 7)) {
+        crc = crc32c_table[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+        length--;
+    }
+
+    while (length >= 8) {
+        memcpy(&low, data, 4);
+        memcpy(&high, data + 4, 4);
+        low = GUINT32_FROM_LE(low) ^ crc;
+        high = GUINT32_FROM_LE(high);
+        crc = crc32c_table[7][low & 0xff] ^ crc32c_table[6][(low >> 8) & 0xff]
+            ^ crc32c_table[5][(low >> 16) & 0xff] ^ crc32c_table[4][low >> 24]
+            ^ crc32c_table[3][high & 0xff] ^ crc32c_table[2][(high >> 8) & 0xff]
+            ^ crc32c_table[1][(high >> 16) & 0xff] ^ crc32c_table[0][high >> 24];
+        data += 8;
+        length -= 8;
+    }
+
+    while (length--)
+        crc = crc32c_table[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+
+    return crc;
+}
+
+#ifdef HAVE_CRC32C_SSE42
+__attribute__((target("sse4.2")))
+static guint32 crc32c_update_sse42(guint32 crc, const guint8 *data, gsize length)
+{
+    guint64 crc64, value;
+
+    while (length && ((guintptr)data & 7)) {
+        crc = __builtin_ia32_crc32qi(crc, *data++);
+        length--;
+    }
+
+    crc64 = crc;
+    while (length >= 8) {
+        memcpy(&value, data, 8);
+        crc64 = __builtin_ia32_crc32di(crc64, value);
+        data += 8;
+        length -= 8;
+    }
+    crc = (guint32)crc64;
+
+    while (length--)
+        crc = __builtin_ia32_crc32qi(crc, *data++);
+
+    return crc;
+}
+#endif
+
+#ifdef HAVE_CRC32C_ARMV8
+#ifdef __clang__
+__attribute__((target("crc")))
+#else
+__attribute__((target("+crc")))
+#endif
+static guint32 crc32c_update_armv8(guint32 crc, const guint8 *data, gsize length)
+{
+    guint64 value;
+
+    while (length && ((guintptr)data & 7)) {
+        __asm__("crc32cb %w0, %w0, %w1" : "+r"(crc) : "r"(*data++));
+        length--;
+    }
+
+    while (length >= 8) {
+        memcpy(&value, data, 8);
+        __asm__("crc32cx %w0, %w0, %x1" : "+r"(crc) : "r"(value));
+        data += 8;
+        length -= 8;
+    }
+
+    while (length--)
+        __asm__("crc32cb %w0, %w0, %w1" : "+r"(crc) : "r"(*data++));
+
+    return crc;
+}
+#endif
+
+static Crc32cUpdateFunc get_crc32c_update(void)
+{
+    static gsize update = 0;
+
+    if (g_once_init_enter(&update)) {
+        Crc32cUpdateFunc selected = crc32c_update_sw;
+        guint32 crc;
+        guint i, j;
+
+        for (i = 0; i < 256; i++) {
+            crc = i;
+            for (j = 0; j < 8; j++)
+                crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLYNOMIAL : crc >> 1;
+            crc32c_table[0][i] = crc;
+        }
+        for (i = 0; i < 256; i++) {
+            for (j = 1; j < 8; j++) {
+                crc32c_table[j][i] = (crc32c_table[j - 1][i] >> 8)
+                    ^ crc32c_table[0][crc32c_table[j - 1][i] & 0xff];
+            }
+        }
+
+#if defined(HAVE_CRC32C_SSE42)
+        if (__builtin_cpu_supports("sse4.2"))
+            selected = crc32c_update_sse42;
+#elif defined(HAVE_CRC32C_ARMV8)
+        if (getauxval(AT_HWCAP) & HWCAP_CRC32)
+            selected = crc32c_update_armv8;
+#endif
+
+        g_once_init_leave(&update, (gsize)selected);
+    }
+
+    return (Crc32cUpdateFunc)update;
+}
+
+gboolean gst_sctp_crc32c_compute(GstSctpCrc32cImpl impl, const guint8 *data, gsize length,
+    guint32 *crc)
+{
+    Crc32cUpdateFunc update = get_crc32c_update();
+
+    g_return_val_if_fail(data || !length, FALSE);
+    g_return_val_if_fail(crc, FALSE);
+
+    switch (impl) {
+    case GST_SCTP_CRC32C_IMPL_AUTO:
+        break;
+    case GST_SCTP_CRC32C_IMPL_SOFTWARE:
+        update = crc32c_update_sw;
+        break;
+    case GST_SCTP_CRC32C_IMPL_SSE42:
+#ifdef HAVE_CRC32C_SSE42
+        if (!__builtin_cpu_supports("sse4.2"))
+            return FALSE;
+        update = crc32c_update_sse42;
+        break;
+#else
+        return FALSE;
+#endif
+    case GST_SCTP_CRC32C_IMPL_ARMV8:
+#ifdef HAVE_CRC32C_ARMV8
+        if (!(getauxval(AT_HWCAP) & HWCAP_CRC32))
+            return FALSE;
+        update = crc32c_update_armv8;
+        break;
+#else
+        return FALSE;
+#endif
+    default:
+        return FALSE;
+    }
+
+    *crc = ~update(0xffffffff, data, length);
+    return TRUE;
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2015, Ericsson AB. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef __GST_SCTP_CRC32C_H__
+#define __GST_SCTP_CRC32C_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* The CRC32c checksum of an SCTP packet (RFC 4960 appendix B), computed as if its checksum
+ * field was zero. The result is in the byte order it is stored in the common header in.
+ * Uses the SSE4.2 or ARMv8 CRC32 instructions when the CPU has them. */
+guint32 gst_sctp_crc32c_packet(const guint8 *packet, gsize length);
+
+typedef enum {
+    GST_SCTP_CRC32C_IMPL_AUTO,
+    GST_SCTP_CRC32C_IMPL_SOFTWARE,
+    GST_SCTP_CRC32C_IMPL_SSE42,
+    GST_SCTP_CRC32C_IMPL_ARMV8
+} GstSctpCrc32cImpl;
+
+/* The plain CRC32c of data in host byte order, using a specific implementation so that they
+ * can be checked against each other. Returns FALSE if the implementation is not available
+ * on this build or CPU. */
+gboolean gst_sctp_crc32c_compute(GstSctpCrc32cImpl impl, const guint8 *data, gsize length,
+    guint32 *crc);
+
+G_END_DECLS
+
+#endif /* __GST_SCTP_CRC32C_H__ */
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2015, Ericsson AB. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "sctppmtuprobe.h"
+
+#include <string.h>
+
+#define SCTP_COMMON_HEADER_LENGTH 12
+#define SCTP_CHUNK_HEARTBEAT 4
+#define SCTP_CHUNK_HEARTBEAT_ACK 5
+#define SCTP_CHUNK_PAD 0x84
+#define PMTU_PROBE_MAGIC 0x47535450 /* "GSTP" */
+/* HEARTBEAT chunk header, heartbeat info parameter header, then magic, size and sequence */
+#define PMTU_PROBE_HEARTBEAT_LENGTH (4 + 4 + 12)
+
+static void put_uint16_be(guint8 *data, guint16 value)
+{
+    data[0] = (guint8)(value >> 8);
+    data[1] = (guint8)value;
+}
+
+static void put_uint32_be(guint8 *data, guint32 value)
+{
+    data[0] = (guint8)(value >> 24);
+    data[1] = (guint8)(value >> 16);
+    data[2] = (guint8)(value >> 8);
+    data[3] = (guint8)value;
+}
+
+static guint16 get_uint16_be(const guint8 *data)
+{
+    return (guint16)((data[0] << 8) | data[1]);
+}
+
+static guint32 get_uint32_be(const guint8 *data)
+{
+    return ((guint32)data[0] << 24) | ((guint32)data[1] << 16) | ((guint32)data[2] << 8) | data[3];
+}
+
+void gst_sctp_pmtu_probe_build(guint8 *packet, guint size, guint16 src_port, guint16 dst_port,
+    guint32 vtag, guint32 seq)
+{
+    guint8 *chunk;
+
+    g_return_if_fail(packet);
+    g_return_if_fail(size >= GST_SCTP_PMTU_PROBE_MIN_SIZE && size <= G_MAXUINT16
+        && !(size & 3));
+
+    memset(packet, 0, size);
+    put_uint16_be(packet, src_port);
+    put_uint16_be(packet + 2, dst_port);
+    put_uint32_be(packet + 4, vtag);
+
+    chunk = packet + SCTP_COMMON_HEADER_LENGTH;
+    chunk[0] = SCTP_CHUNK_HEARTBEAT;
+    put_uint16_be(chunk + 2, PMTU_PROBE_HEARTBEAT_LENGTH);
+    put_uint16_be(chunk + 4, 1); /* Heartbeat Info */
+    put_uint16_be(chunk + 6, PMTU_PROBE_HEARTBEAT_LENGTH - 4);
+    put_uint32_be(chunk + 8, PMTU_PROBE_MAGIC);
+    put_uint32_be(chunk + 12, size);
+    put_uint32_be(chunk + 16, seq);
+
+    chunk += PMTU_PROBE_HEARTBEAT_LENGTH;
+    chunk[0] = SCTP_CHUNK_PAD;
+    put_uint16_be(chunk + 2, size - SCTP_COMMON_HEADER_LENGTH - PMTU_PROBE_HEARTBEAT_LENGTH);
+}
+
+guint gst_sctp_pmtu_probe_find_ack(const guint8 *packet, gsize length, guint32 *seq)
+{
+    gsize offset = SCTP_COMMON_HEADER_LENGTH;
+    guint16 chunk_length;
+
+    g_return_val_if_fail(packet || !length, 0);
+    g_return_val_if_fail(seq, 0);
+
+    while (offset + 4 <= length) {
+        chunk_length = get_uint16_be(packet + offset + 2);
+        if (chunk_length < 4 || offset + chunk_length > length)
+            break;
+
+        if (packet[offset] == SCTP_CHUNK_HEARTBEAT_ACK
+            && chunk_length == PMTU_PROBE_HEARTBEAT_LENGTH
+            && get_uint32_be(packet + offset + 8) == PMTU_PROBE_MAGIC) {
+            *seq = get_uint32_be(packet + offset + 16);
+            return get_uint32_be(packet + offset + 12);
+        }
+
+        offset += (chunk_length + 3) & ~3u;
+    }
+
+    return 0;
+}
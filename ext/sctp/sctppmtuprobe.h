@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2015, Ericsson AB. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef __GST_SCTP_PMTU_PROBE_H__
+#define __GST_SCTP_PMTU_PROBE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Common header, the probe's HEARTBEAT and an empty PAD chunk */
+#define GST_SCTP_PMTU_PROBE_MIN_SIZE (12 + 20 + 4)
+
+/* Writes a path MTU probe of size bytes (RFC 8899 section 6.2): a HEARTBEAT carrying the
+ * size and seq in its heartbeat info, padded with a PAD chunk (RFC 4820). size must be a
+ * multiple of 4. The checksum field is left zero. */
+void gst_sctp_pmtu_probe_build(guint8 *packet, guint size, guint16 src_port, guint16 dst_port,
+    guint32 vtag, guint32 seq);
+
+/* Returns the size of the probe acknowledged by a HEARTBEAT-ACK in the packet, or 0 */
+guint gst_sctp_pmtu_probe_find_ack(const guint8 *packet, gsize length, guint32 *seq);
+
+G_END_DECLS
+
+#endif /* __GST_SCTP_PMTU_PROBE_H__ */
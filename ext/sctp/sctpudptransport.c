@@ -0,0 +1,436 @@
+/*
+ * Copyright (c) 2015, Ericsson AB. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+/* sendmmsg() and recvmmsg() */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "sctpudptransport.h"
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+
+#if defined(__linux__)
+#define HAVE_MMSG 1
+#endif
+
+/* Most packets handed to the kernel in one system call */
+#define BATCH_SIZE 32
+/* How often a blocked receive wakes up to see if the transport is being freed */
+#define RECEIVE_TIMEOUT_MS 100
+
+typedef struct {
+    guint8 *data;
+    gsize size;
+    gsize length;
+} Packet;
+
+typedef struct {
+    Packet packets[BATCH_SIZE];
+    guint count;
+} PacketBatch;
+
+struct _GstSctpUdpTransport {
+    gint fd;
+    gsize max_packet_size;
+    gboolean dont_fragment;
+
+    GstSctpUdpTransportReceiveCb receive_cb;
+    gpointer user_data;
+
+    /* Packets are queued in pending while the send thread hands sending to the kernel.
+     * Only the send thread swaps the two. */
+    GMutex send_mutex;
+    GCond send_cond;
+    PacketBatch *pending;
+    PacketBatch *sending;
+    gboolean stopping;
+    guint64 dropped_packets;
+
+    GThread *send_thread;
+    GThread *receive_thread;
+};
+
+static gint open_socket(guint16 local_port, const gchar *remote_address, guint16 remote_port,
+    gboolean *dont_fragment);
+static gboolean set_dont_fragment(gint fd, gint family);
+static gpointer send_thread_func(GstSctpUdpTransport *transport);
+static gpointer receive_thread_func(GstSctpUdpTransport *transport);
+static void send_batch(GstSctpUdpTransport *transport, PacketBatch *batch);
+static void free_batch(PacketBatch *batch);
+
+GstSctpUdpTransport *gst_sctp_udp_transport_new(guint16 local_port, const gchar *remote_address,
+    guint16 remote_port, gsize max_packet_size, GstSctpUdpTransportReceiveCb receive_cb,
+    gpointer user_data)
+{
+    GstSctpUdpTransport *transport;
+    gboolean dont_fragment;
+    gint fd;
+
+    g_return_val_if_fail(remote_address != NULL, NULL);
+
+    if ((fd = open_socket(local_port, remote_address, remote_port, &dont_fragment)) < 0)
+        return NULL;
+
+    transport = g_new0(GstSctpUdpTransport, 1);
+    transport->fd = fd;
+    transport->dont_fragment = dont_fragment;
+    transport->max_packet_size = max_packet_size;
+    transport->receive_cb = receive_cb;
+    transport->user_data = user_data;
+
+    g_mutex_init(&transport->send_mutex);
+    g_cond_init(&transport->send_cond);
+    transport->pending = g_new0(PacketBatch, 1);
+    transport->sending = g_new0(PacketBatch, 1);
+    transport->stopping = FALSE;
+    transport->dropped_packets = 0;
+
+    transport->send_thread = g_thread_new("sctp_udp_send", (GThreadFunc)send_thread_func,
+        transport);
+    transport->receive_thread = g_thread_new("sctp_udp_receive",
+        (GThreadFunc)receive_thread_func, transport);
+
+    return transport;
+}
+
+/* Copies the packet, it is sent from the send thread together with whatever else was queued
+ * in the meantime. This is called from within usrsctp, so it never waits for the send
+ * thread: when a whole batch is already queued the packet is dropped like on a full
+ * interface queue, and SCTP retransmits it. */
+void gst_sctp_udp_transport_send(GstSctpUdpTransport *transport, const guint8 *data, gsize length)
+{
+    Packet *packet;
+
+    g_mutex_lock(&transport->send_mutex);
+    if (transport->stopping) {
+        g_mutex_unlock(&transport->send_mutex);
+        return;
+    }
+
+    if (transport->pending->count == BATCH_SIZE) {
+        transport->dropped_packets++;
+        g_mutex_unlock(&transport->send_mutex);
+        return;
+    }
+
+    packet = &transport->pending->packets[transport->pending->count++];
+    if (packet->size < length) {
+        packet->data = g_realloc(packet->data, length);
+        packet->size = length;
+    }
+    memcpy(packet->data, data, length);
+    packet->length = length;
+
+    if (transport->pending->count == 1)
+        g_cond_broadcast(&transport->send_cond);
+    g_mutex_unlock(&transport->send_mutex);
+}
+
+/* Whether the socket sets the don't fragment bit, so that a packet larger than the path MTU
+ * is lost instead of being fragmented on the way */
+gboolean gst_sctp_udp_transport_get_dont_fragment(GstSctpUdpTransport *transport)
+{
+    return transport->dont_fragment;
+}
+
+/* Packets dropped because the send thread had a full batch queued already */
+guint64 gst_sctp_udp_transport_get_dropped_packets(GstSctpUdpTransport *transport)
+{
+    guint64 dropped_packets;
+
+    g_mutex_lock(&transport->send_mutex);
+    dropped_packets = transport->dropped_packets;
+    g_mutex_unlock(&transport->send_mutex);
+
+    return dropped_packets;
+}
+
+/* Packets already queued are still sent */
+void gst_sctp_udp_transport_free(GstSctpUdpTransport *transport)
+{
+    g_mutex_lock(&transport->send_mutex);
+    transport->stopping = TRUE;
+    g_cond_broadcast(&transport->send_cond);
+    g_mutex_unlock(&transport->send_mutex);
+
+    g_thread_join(transport->send_thread);
+    g_thread_join(transport->receive_thread);
+
+    close(transport->fd);
+    free_batch(transport->pending);
+    free_batch(transport->sending);
+    g_cond_clear(&transport->send_cond);
+    g_mutex_clear(&transport->send_mutex);
+    g_free(transport);
+}
+
+static gint open_socket(guint16 local_port, const gchar *remote_address, guint16 remote_port,
+    gboolean *dont_fragment)
+{
+    struct addrinfo hints, *result = NULL, *ai;
+    struct sockaddr_storage local;
+    struct timeval timeout;
+    gchar service[6];
+    gint fd = -1, ret;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_NUMERICSERV;
+    g_snprintf(service, sizeof(service), "%u", remote_port);
+
+    if ((ret = getaddrinfo(remote_address, service, &hints, &result)) != 0) {
+        g_warning("Could not resolve %s: %s", remote_address, gai_strerror(ret));
+        return -1;
+    }
+
+    for (ai = result; ai; ai = ai->ai_next) {
+        if ((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0)
+            continue;
+
+        memset(&local, 0, sizeof(local));
+        if (ai->ai_family == AF_INET) {
+            ((struct sockaddr_in *)&local)->sin_family = AF_INET;
+            ((struct sockaddr_in *)&local)->sin_port = htons(local_port);
+            ((struct sockaddr_in *)&local)->sin_addr.s_addr = htonl(INADDR_ANY);
+        } else {
+            ((struct sockaddr_in6 *)&local)->sin6_family = AF_INET6;
+            ((struct sockaddr_in6 *)&local)->sin6_port = htons(local_port);
+            ((struct sockaddr_in6 *)&local)->sin6_addr = in6addr_any;
+        }
+
+        /* Connected, so that only the peer's packets are received and no address has to be
+         * passed for every send */
+        if ((local_port == 0 || bind(fd, (struct sockaddr *)&local, ai->ai_family == AF_INET ?
+            sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6)) == 0)
+            && connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+            break;
+
+        close(fd);
+        fd = -1;
+    }
+
+    if (fd < 0) {
+        freeaddrinfo(result);
+        g_warning("Could not set up UDP socket from port %u to %s:%u: (%u) %s", local_port,
+            remote_address, remote_port, errno, strerror(errno));
+        return -1;
+    }
+
+    *dont_fragment = set_dont_fragment(fd, ai->ai_family);
+    freeaddrinfo(result);
+    if (!*dont_fragment)
+        g_warning("Could not set the don't fragment bit on the UDP socket, path MTU probing is "
+            "disabled");
+
+    timeout.tv_sec = 0;
+    timeout.tv_usec = RECEIVE_TIMEOUT_MS * 1000;
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0)
+        g_warning("Could not set SO_RCVTIMEO on UDP socket");
+
+    return fd;
+}
+
+/* The packets are sized by the association's own path MTU probing, so they must be lost
+ * rather than fragmented when too large. IP_PMTUDISC_PROBE sets DF without limiting the
+ * packets to the path MTU the kernel has cached. */
+static gboolean set_dont_fragment(gint fd, gint family)
+{
+    gint value;
+
+    if (family == AF_INET) {
+#if defined(IP_MTU_DISCOVER) && defined(IP_PMTUDISC_PROBE)
+        value = IP_PMTUDISC_PROBE;
+        return setsockopt(fd, IPPROTO_IP, IP_MTU_DISCOVER, &value, sizeof(value)) == 0;
+#elif defined(IP_DONTFRAG)
+        value = 1;
+        return setsockopt(fd, IPPROTO_IP, IP_DONTFRAG, &value, sizeof(value)) == 0;
+#endif
+    } else if (family == AF_INET6) {
+#if defined(IPV6_MTU_DISCOVER) && defined(IPV6_PMTUDISC_PROBE)
+        value = IPV6_PMTUDISC_PROBE;
+        if (setsockopt(fd, IPPROTO_IPV6, IPV6_MTU_DISCOVER, &value, sizeof(value)) < 0)
+            return FALSE;
+#endif
+#if defined(IPV6_DONTFRAG)
+        value = 1;
+        return setsockopt(fd, IPPROTO_IPV6, IPV6_DONTFRAG, &value, sizeof(value)) == 0;
+#endif
+    }
+
+    (void)value;
+    return FALSE;
+}
+
+static gpointer send_thread_func(GstSctpUdpTransport *transport)
+{
+    PacketBatch *batch;
+
+    g_mutex_lock(&transport->send_mutex);
+    while (TRUE) {
+        while (transport->pending->count == 0 && !transport->stopping)
+            g_cond_wait(&transport->send_cond, &transport->send_mutex);
+        if (transport->pending->count == 0)
+            break;
+
+        batch = transport->pending;
+        transport->pending = transport->sending;
+        transport->sending = batch;
+        g_mutex_unlock(&transport->send_mutex);
+
+        send_batch(transport, batch);
+        batch->count = 0;
+
+        g_mutex_lock(&transport->send_mutex);
+    }
+    g_mutex_unlock(&transport->send_mutex);
+
+    return NULL;
+}
+
+/* Losing a packet here is no different from losing it on the network, SCTP retransmits it */
+static void send_batch(GstSctpUdpTransport *transport, PacketBatch *batch)
+{
+    guint sent = 0;
+    gint ret;
+#ifdef HAVE_MMSG
+    struct mmsghdr msgs[BATCH_SIZE];
+    struct iovec iovs[BATCH_SIZE];
+    guint i;
+
+    memset(msgs, 0, sizeof(struct mmsghdr) * batch->count);
+    for (i = 0; i < batch->count; i++) {
+        iovs[i].iov_base = batch->packets[i].data;
+        iovs[i].iov_len = batch->packets[i].length;
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    while (sent < batch->count) {
+        ret = sendmmsg(transport->fd, msgs + sent, batch->count - sent, 0);
+#else
+    while (sent < batch->count) {
+        ret = send(transport->fd, batch->packets[sent].data, batch->packets[sent].length, 0);
+        if (ret >= 0)
+            ret = 1;
+#endif
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            /* EMSGSIZE is a path MTU probe that was too large */
+            if (errno != ECONNREFUSED && errno != ENOBUFS && errno != EAGAIN && errno != EMSGSIZE)
+                g_warning("Error sending SCTP packets over UDP: (%u) %s", errno, strerror(errno));
+            /* Skip the packet that failed */
+            ret = 1;
+        }
+        sent += ret;
+    }
+}
+
+static gpointer receive_thread_func(GstSctpUdpTransport *transport)
+{
+    guint8 *buffers;
+    gsize size = transport->max_packet_size;
+    gint received, i;
+#ifdef HAVE_MMSG
+    struct mmsghdr msgs[BATCH_SIZE];
+    struct iovec iovs[BATCH_SIZE];
+
+    buffers = g_malloc(size * BATCH_SIZE);
+    memset(msgs, 0, sizeof(msgs));
+    for (i = 0; i < BATCH_SIZE; i++) {
+        iovs[i].iov_base = buffers + i * size;
+        iovs[i].iov_len = size;
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+#else
+    gssize length;
+
+    buffers = g_malloc(size);
+#endif
+
+    while (TRUE) {
+        g_mutex_lock(&transport->send_mutex);
+        if (transport->stopping) {
+            g_mutex_unlock(&transport->send_mutex);
+            break;
+        }
+        g_mutex_unlock(&transport->send_mutex);
+
+#ifdef HAVE_MMSG
+        /* Blocks for the first packet only, then takes what else is already there */
+        received = recvmmsg(transport->fd, msgs, BATCH_SIZE, MSG_WAITFORONE, NULL);
+#else
+        length = recv(transport->fd, buffers, size, MSG_TRUNC);
+        received = length < 0 ? -1 : 1;
+#endif
+        if (received < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && errno != ECONNREFUSED)
+                g_warning("Error receiving SCTP packets over UDP: (%u) %s", errno, strerror(errno));
+            continue;
+        }
+
+        for (i = 0; i < received; i++) {
+#ifdef HAVE_MMSG
+            if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                g_warning("Dropping SCTP packet larger than %" G_GSIZE_FORMAT " bytes", size);
+                continue;
+            }
+            transport->receive_cb(buffers + i * size, msgs[i].msg_len, transport->user_data);
+#else
+            if ((gsize)length > size) {
+                g_warning("Dropping SCTP packet larger than %" G_GSIZE_FORMAT " bytes", size);
+                continue;
+            }
+            transport->receive_cb(buffers, (gsize)length, transport->user_data);
+#endif
+        }
+    }
+
+    g_free(buffers);
+    return NULL;
+}
+
+static void free_batch(PacketBatch *batch)
+{
+    guint i;
+
+    for (i = 0; i < BATCH_SIZE; i++)
+        g_free(batch->packets[i].data);
+    g_free(batch);
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2015, Ericsson AB. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef __GST_SCTP_UDP_TRANSPORT_H__
+#define __GST_SCTP_UDP_TRANSPORT_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Carries the SCTP packets of an association directly over a UDP socket of its own, as in
+ * RFC 6951, instead of handing them to the pipeline. Packets are sent and received in
+ * batches, with sendmmsg()/recvmmsg() where available. */
+typedef struct _GstSctpUdpTransport GstSctpUdpTransport;
+
+typedef void (*GstSctpUdpTransportReceiveCb) (guint8 *data, gsize length, gpointer user_data);
+
+GstSctpUdpTransport *gst_sctp_udp_transport_new(guint16 local_port, const gchar *remote_address,
+    guint16 remote_port, gsize max_packet_size, GstSctpUdpTransportReceiveCb receive_cb,
+    gpointer user_data);
+void gst_sctp_udp_transport_send(GstSctpUdpTransport *transport, const guint8 *data, gsize length);
+gboolean gst_sctp_udp_transport_get_dont_fragment(GstSctpUdpTransport *transport);
+guint64 gst_sctp_udp_transport_get_dropped_packets(GstSctpUdpTransport *transport);
+void gst_sctp_udp_transport_free(GstSctpUdpTransport *transport);
+
+G_END_DECLS
+
+#endif /* __GST_SCTP_UDP_TRANSPORT_H__ */
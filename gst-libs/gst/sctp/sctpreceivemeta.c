@@ -60,6 +60,7 @@ static gboolean gst_sctp_receive_meta_init(GstMeta *meta, gpointer params, GstBu
 {
     GstSctpReceiveMeta *gst_sctp_receive_meta = (GstSctpReceiveMeta *)meta;
     gst_sctp_receive_meta->ppid = 0;
+    gst_sctp_receive_meta->flags = GST_SCTP_RECEIVE_META_FLAG_BEGIN | GST_SCTP_RECEIVE_META_FLAG_END;
     return TRUE;
 }
 
@@ -67,7 +68,10 @@ static gboolean gst_sctp_receive_meta_transform(GstBuffer *transbuf, GstMeta *me
     GQuark type, gpointer data)
 {
     GstSctpReceiveMeta *gst_sctp_receive_meta = (GstSctpReceiveMeta *)meta;
-    gst_sctp_buffer_add_receive_meta(transbuf, gst_sctp_receive_meta->ppid);
+    GstSctpReceiveMeta *new_meta;
+
+    new_meta = gst_sctp_buffer_add_receive_meta(transbuf, gst_sctp_receive_meta->ppid);
+    new_meta->flags = gst_sctp_receive_meta->flags;
     return TRUE;
 }
 
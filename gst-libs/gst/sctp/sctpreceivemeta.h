@@ -34,10 +34,18 @@ G_BEGIN_DECLS
 #define GST_SCTP_RECEIVE_META_INFO (gst_sctp_receive_meta_get_info())
 typedef struct _GstSctpReceiveMeta GstSctpReceiveMeta;
 
+/* With partial delivery a message may span several buffers. A buffer that begins a message
+ * while the previous one on the stream has not ended means that message was aborted. */
+typedef enum {
+  GST_SCTP_RECEIVE_META_FLAG_BEGIN = (1 << 0),
+  GST_SCTP_RECEIVE_META_FLAG_END = (1 << 1)
+} GstSctpReceiveMetaFlags;
+
 struct _GstSctpReceiveMeta {
   GstMeta meta;
 
   guint32 ppid;
+  GstSctpReceiveMetaFlags flags;
 };
 
 GType gst_sctp_receive_meta_api_get_type(void);
@@ -63,6 +63,7 @@ static gboolean gst_sctp_send_meta_init(GstMeta *meta, gpointer params, GstBuffe
     gst_sctp_send_meta->ordered = TRUE;
     gst_sctp_send_meta->pr = GST_SCTP_SEND_META_PARTIAL_RELIABILITY_NONE;
     gst_sctp_send_meta->pr_param = 0;
+    gst_sctp_send_meta->priority = -1;
     return TRUE;
 }
 
@@ -70,8 +71,11 @@ static gboolean gst_sctp_send_meta_transform(GstBuffer *transbuf, GstMeta *meta,
     GQuark type, gpointer data)
 {
     GstSctpSendMeta *gst_sctp_send_meta = (GstSctpSendMeta *)meta;
-    gst_sctp_buffer_add_send_meta(transbuf, gst_sctp_send_meta->ppid, gst_sctp_send_meta->ordered, gst_sctp_send_meta->pr,
+    GstSctpSendMeta *new_meta;
+
+    new_meta = gst_sctp_buffer_add_send_meta(transbuf, gst_sctp_send_meta->ppid, gst_sctp_send_meta->ordered, gst_sctp_send_meta->pr,
         gst_sctp_send_meta->pr_param);
+    new_meta->priority = gst_sctp_send_meta->priority;
     return TRUE;
 }
 
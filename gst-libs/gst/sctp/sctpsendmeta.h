@@ -49,6 +49,8 @@ struct _GstSctpSendMeta {
   gboolean ordered;
   GstSctpSendMetaPartiallyReliability pr;
   guint32 pr_param;
+  /* Scheduler priority of the stream from this buffer on, -1 keeps the current one */
+  gint priority;
 };
 
 GType gst_sctp_send_meta_api_get_type(void);
@@ -93,6 +93,20 @@
 /* Min pacing interval and min pacing rate*/
 #define MIN_PACE_INTERVAL 0.00f    /* s */
 #define MINIMUM_PACE_BANDWIDTH 50000.0f /* bps */
+/* Size of the RTP padding packets used to probe for bandwidth in fast start */
+#define PROBE_PACKET_SIZE 255
+/* Probing stops when the transmitted rate reaches this factor of the target bitrates */
+#define PROBE_RATE_HEADROOM 1.5f
+/* Packets due within this time are approved without waiting */
+#define DEFAULT_PACING_BURST_TIME 1000 /* us */
+/* Time within which the pacer tries to send a complete keyframe */
+#define DEFAULT_FRAME_LATENCY 20000 /* us */
+/* Keyframes may be paced at most this many times faster than cwnd/srtt, 1 disables it */
+#define DEFAULT_KEYFRAME_BURST 1.0f
+/* Frames this much larger than the average frame are treated as keyframes */
+#define KEYFRAME_SIZE_FACTOR 2.0f
+/* Weight of a new frame in the average frame size */
+#define FRAME_SIZE_AVG_WEIGHT 0.1f
 /* Initial MSS */
 #define INIT_MSS 100
 /* Initial CWND */
@@ -146,18 +160,16 @@ typedef struct {
     guint id;
 
     GstScreamQueueBitrateRequestedCb on_bitrate_callback;
-    GstScreamQueueNextPacketSizeCb get_next_packet_size_callback;
     GstScreamQueueApproveTransmitCb approve_transmit_callback;
     GstScreamQueueClearQueueCb clear_queue;
+    GstScreamQueueSendProbeCb send_probe_callback;
     gpointer user_data;
 
 
     guint last_rtp_timestamp;
     guint64 oldest_packet_enqueue_time;
     guint bytes_in_queue;
-    gfloat credit;                 /* Credit that is received if another stream gets */
-                                   /*  priority to transmit */
-    gfloat priority;               /* Stream priority */
+    gfloat priority;               /* Stream priority, the weight in the scheduler */
     guint bytes_transmitted;       /* Number of bytes transmitted */
     guint bytes_acked;             /* Number of ACKed bytes */
     gfloat rate_transmitted;       /* Transmitted rate */
@@ -170,7 +182,11 @@ typedef struct {
     gboolean was_fast_start;       /* Was fast start */
     gboolean loss_event_flag;      /* Was loss event */
     guint tx_size_bits_avg;        /* Avergage bits queued in RTP queue */
-    guint next_packet_size;        /* Size of next RTP packet in Queue */
+    guint next_packet_size;        /* Size of next RTP packet in Queue, pushed by the queue */
+    gdouble v_start;               /* Virtual start time of the next packet */
+    gdouble v_finish;              /* Virtual finish time of the next packet */
+    gdouble v_finish_last;         /* Virtual finish time of the last served packet */
+    gint schedule_index;           /* Position in the schedule heap, -1 when idle */
     guint n_loss;                  /* Number of losses, reported by receiver */
     guint64 t_last_rtp_q_clear_us; /* Last time RTP Q cleared */
     guint bytes_rtp;
@@ -187,8 +203,40 @@ typedef struct {
     guint64 last_target_bitrate_i_adjust_us;
 
     guint64 t_start_us;
+
+    /* Frame boundaries, from the RTP marker bit */
+    guint frame_bytes;             /* Enqueued bytes of the incomplete frame */
+    GQueue frames;                 /* Sizes of the complete frames in the RTP queue */
+    gfloat frame_size_avg;
+    guint64 frame_latency_us;      /* Time within which a keyframe should be sent */
+    gfloat keyframe_burst;         /* Max factor over the pacing rate for keyframes */
 } ScreamStream;
 
+/*
+ * Callbacks into the queues call back into the controller or emit signals to the
+ * application, so they are collected while the lock is held and made after it is
+ * released, see unlock_and_dispatch(). They carry copies of what they need, as the
+ * stream may be unregistered before they are made.
+ */
+typedef enum {
+    SCREAM_CALLBACK_BITRATE,
+    SCREAM_CALLBACK_CLEAR_QUEUE,
+    SCREAM_CALLBACK_APPROVE_TRANSMIT,
+    SCREAM_CALLBACK_SEND_PROBE
+} ScreamCallbackType;
+
+typedef struct {
+    ScreamCallbackType type;
+    guint stream_id;
+    GstScreamQueueBitrateRequestedCb on_bitrate_callback;
+    GstScreamQueueClearQueueCb clear_queue;
+    GstScreamQueueApproveTransmitCb approve_transmit_callback;
+    GstScreamQueueSendProbeCb send_probe_callback;
+    gpointer user_data;
+    guint bitrate;
+    guint size;
+} ScreamPendingCallback;
+
 typedef struct {
     GstScreamController *controller;
     guint stream_id;
@@ -208,12 +256,13 @@ static void gst_scream_controller_set_property(GObject *object, guint prop_id, c
 static void gst_scream_controller_get_property(GObject *object, guint prop_id, GValue *value,
     GParamSpec *pspec);
 
-static void add_credit(GstScreamController *self, ScreamStream *served_stream,
-    int transmitted_bytes);
-static void subtract_credit(ScreamStream *served_stream,
-    int transmitted_bytes);
 
+static void queue_callback(GstScreamController *self, ScreamStream *stream, ScreamCallbackType type);
+static void unlock_and_dispatch(GstScreamController *self);
 static guint bytes_in_flight(GstScreamController *self);
+static gfloat get_pacing_bitrate(GstScreamController *self, ScreamStream *stream,
+    gboolean end_of_frame);
+static void destroy_stream(ScreamStream *stream);
 static void update_bytes_in_flight_history(GstScreamController *self, guint64 time_us);
 static void update_rate(ScreamStream *stream, float t_delta);
 
@@ -222,6 +271,8 @@ static void update_target_stream_bitrate(GstScreamController *self, ScreamStream
 
 static void initialize(GstScreamController *self, guint64 time_us);
 static ScreamStream * get_prioritized_stream(GstScreamController *self);
+static void set_next_packet_size(GstScreamController *self, ScreamStream *stream, guint size);
+static void serve_stream(GstScreamController *self, ScreamStream *stream);
 
 static void update_cwnd(GstScreamController *self, guint64 time_us);
 
@@ -232,7 +283,8 @@ static void compute_sbd(GstScreamController *self);
 static guint estimate_owd(GstScreamController *self, guint64 time_us);
 static guint get_base_owd(GstScreamController *self);
 static gboolean is_competing_flows(GstScreamController *self);
-static guint get_next_packet_size(ScreamStream *stream);
+static guint64 send_probe(GstScreamController *self, guint64 time_us);
+static guint64 get_pacing_burst_time(GstScreamController *self, ScreamStream *stream);
 
 static void gst_scream_controller_class_init (GstScreamControllerClass *klass)
 {
@@ -295,8 +347,11 @@ static void gst_scream_controller_init (GstScreamController *self)
 
     self->in_fast_start = TRUE;
     self->n_fast_start = 1;
+    self->next_probe_t_us = 0;
 
     self->pacing_bitrate = 0.0;
+    self->pacing_burst_times = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+    self->transport_seq = 0;
 
     self->acc_bytes_in_flight_max = 0;
     self->n_acc_bytes_in_flight_max = 0;
@@ -320,17 +375,25 @@ static void gst_scream_controller_init (GstScreamController *self)
     self->last_rate_update_t_us = 0;
     self->last_congestion_detected_t_us = 0;
 
-    self->streams = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)g_free);
+    self->streams = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)destroy_stream);
+    self->probe_ssrcs = g_hash_table_new(NULL, NULL);
+    self->schedule = g_ptr_array_new();
+    self->v_time = 0.0;
 
 
     g_mutex_init(&self->lock);
-
+    self->pending_callbacks = g_array_new(FALSE, FALSE, sizeof(ScreamPendingCallback));
 }
 
 static void gst_scream_controller_finalize(GObject *object)
 {
     GstScreamController *self = GST_SCREAM_CONTROLLER(object);
+    g_ptr_array_free(self->schedule, TRUE);
     g_hash_table_unref(self->streams);
+    g_hash_table_unref(self->probe_ssrcs);
+    g_hash_table_unref(self->pacing_burst_times);
+    g_array_free(self->pending_callbacks, TRUE);
+    g_mutex_clear(&self->lock);
     G_OBJECT_CLASS(gst_scream_controller_parent_class)->finalize(object);
 }
 
@@ -386,9 +449,9 @@ GstScreamController *gst_scream_controller_get(guint32 controller_id)
 gboolean gst_scream_controller_register_new_stream(GstScreamController *controller,
     guint stream_id, gfloat priority, guint min_bitrate, guint max_bitrate,
     GstScreamQueueBitrateRequestedCb on_bitrate_callback,
-    GstScreamQueueNextPacketSizeCb get_next_packet_size_callback,
     GstScreamQueueApproveTransmitCb approve_transmit_callback,
     GstScreamQueueClearQueueCb clear_queue,
+    GstScreamQueueSendProbeCb send_probe_callback,
     gpointer user_data)
 {
     ScreamStream *stream;
@@ -402,9 +465,9 @@ gboolean gst_scream_controller_register_new_stream(GstScreamController *controll
 
     stream = g_new0(ScreamStream, 1);
     stream->on_bitrate_callback = on_bitrate_callback;
-    stream->get_next_packet_size_callback = get_next_packet_size_callback;
     stream->approve_transmit_callback = approve_transmit_callback;
     stream->clear_queue = clear_queue;
+    stream->send_probe_callback = send_probe_callback;
     stream->user_data = user_data;
 
     stream->id = stream_id;
@@ -414,6 +477,10 @@ gboolean gst_scream_controller_register_new_stream(GstScreamController *controll
     stream->target_bitrate = stream->min_bitrate;
     stream->target_bitrate_i = 1.0f;
     stream->loss_event_flag = FALSE;
+    g_queue_init(&stream->frames);
+    stream->frame_latency_us = DEFAULT_FRAME_LATENCY;
+    stream->keyframe_burst = DEFAULT_KEYFRAME_BURST;
+    stream->schedule_index = -1;
     /* Everything else is already zero-initialised */
 
     g_hash_table_insert(controller->streams, GUINT_TO_POINTER(stream_id), stream);
@@ -423,13 +490,90 @@ end:
     return ret;
 }
 
+gboolean gst_scream_controller_update_stream(GstScreamController *controller,
+    guint stream_id, gfloat priority, guint min_bitrate, guint max_bitrate)
+{
+    ScreamStream *stream;
+    gfloat target_bitrate;
+    gboolean ret = FALSE;
+
+    g_mutex_lock(&controller->lock);
+    stream = g_hash_table_lookup(controller->streams, GUINT_TO_POINTER(stream_id));
+    if (!stream) {
+        GST_WARNING("Failed to update scream stream %u, it is not registered.", stream_id);
+        goto end;
+    }
+
+    stream->priority = priority;
+    stream->min_bitrate = (gfloat)min_bitrate;
+    stream->max_bitrate = (gfloat)max_bitrate;
+
+    /* A waiting packet keeps its place in the schedule, but its finish time
+     * depends on the priority */
+    if (stream->schedule_index >= 0)
+        set_next_packet_size(controller, stream, stream->next_packet_size);
+
+    /* Pull the current target into the new bounds right away instead of
+     * waiting for the next rate update */
+    target_bitrate = MIN(stream->max_bitrate, MAX(stream->min_bitrate, stream->target_bitrate));
+    if (target_bitrate != stream->target_bitrate) {
+        stream->target_bitrate = target_bitrate;
+        queue_callback(controller, stream, SCREAM_CALLBACK_BITRATE);
+    }
+    ret = TRUE;
+end:
+    unlock_and_dispatch(controller);
+    return ret;
+}
+
+/*
+ * The stream leaves the schedule and its packets in flight are forgotten, as their
+ * feedback will not be handled. Callbacks already collected may still be made.
+ */
+void gst_scream_controller_unregister_stream(GstScreamController *self, guint stream_id)
+{
+    ScreamStream *stream;
+    GHashTableIter iter;
+    gpointer value;
+    gint n;
+
+    g_mutex_lock(&self->lock);
+    stream = g_hash_table_lookup(self->streams, GUINT_TO_POINTER(stream_id));
+    if (!stream) {
+        goto end;
+    }
+
+    if (stream->schedule_index >= 0)
+        schedule_remove(self, stream);
+
+    g_hash_table_iter_init(&iter, self->probe_ssrcs);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        if (value == stream)
+            g_hash_table_iter_remove(&iter);
+    }
+
+    for (n = 0; n < MAX_TX_PACKETS; n++) {
+        if (self->transmitted_packets[n].stream_id == stream_id)
+            self->transmitted_packets[n].is_used = FALSE;
+    }
+
+    g_hash_table_remove(self->streams, GUINT_TO_POINTER(stream_id));
+end:
+    g_mutex_unlock(&self->lock);
+}
+
+/*
+ * Probes are counted on the stream that sent them, but are numbered in the
+ * sequence space of their RTX SSRC and acknowledged by its feedback.
+ */
 guint64 gst_scream_controller_packet_transmitted(GstScreamController *self, guint stream_id,
-    guint size, guint16 seq, guint64 transmit_time_us)
+    guint ssrc, guint size, guint16 seq, gboolean end_of_frame, guint64 transmit_time_us)
 {
     int k = 0;
     int ix = -1;
     TransmittedRtpPacket *packet;
 
+    g_mutex_lock(&self->lock);
     while (k < MAX_TX_PACKETS) {
         if (self->transmitted_packets[k].is_used == FALSE) {
           ix = k;
@@ -453,6 +597,7 @@ guint64 gst_scream_controller_packet_transmitted(GstScreamController *self, guin
 
     packet = &self->transmitted_packets[ix];
     packet->stream_id = stream_id;
+    packet->ssrc = ssrc;
     packet->size = size;
     packet->seq = seq;
     packet->transmit_time_us = transmit_time_us;
@@ -464,7 +609,14 @@ guint64 gst_scream_controller_packet_transmitted(GstScreamController *self, guin
     ScreamStream *stream;
 
     stream = g_hash_table_lookup(self->streams, GUINT_TO_POINTER(stream_id));
+    if (!stream) {
+        /* Unregistered while the packet was on its way out */
+        packet->is_used = FALSE;
+        goto end;
+    }
     stream->bytes_transmitted += size;
+    if (ssrc != stream_id && !g_hash_table_contains(self->streams, GUINT_TO_POINTER(ssrc)))
+        g_hash_table_insert(self->probe_ssrcs, GUINT_TO_POINTER(ssrc), stream);
 
     if (OPEN_CWND) {
         time_until_approve_transmits_us = 0;
@@ -472,16 +624,6 @@ guint64 gst_scream_controller_packet_transmitted(GstScreamController *self, guin
     }
     self->last_transmit_t_us = transmit_time_us;
 
-    /*
-     * Add credit to unserved streams
-     */
-    add_credit(self, stream, size);
-
-    /*
-     * Reduce used credit for served streams
-     */
-    subtract_credit(stream, size);
-
     /*
      * Compute paceInterval, we assume a min bw of 50kbps and a min tp of 1ms
      * for stable operation
@@ -490,7 +632,7 @@ guint64 gst_scream_controller_packet_transmitted(GstScreamController *self, guin
 
     self->pacing_bitrate = MAX(MINIMUM_PACE_BANDWIDTH,
         self->cwnd * 8.0f / MAX(0.001f, self->srtt_us / 1000000.0));
-    time_next_transmit_us = (size * 8.0f) / self->pacing_bitrate;
+    time_next_transmit_us = (size * 8.0f) / get_pacing_bitrate(self, stream, end_of_frame);
     if (self->owd_fraction_avg > 0.1f && ENABLE_PACKET_PACING) {
         pace_interval = MAX(MIN_PACE_INTERVAL, time_next_transmit_us);
     }
@@ -501,6 +643,7 @@ guint64 gst_scream_controller_packet_transmitted(GstScreamController *self, guin
     time_until_approve_transmits_us = (guint64)(pace_interval * 1000000);
     self->next_transmit_t_us = transmit_time_us + time_until_approve_transmits_us;
 end:
+    g_mutex_unlock(&self->lock);
     return time_until_approve_transmits_us;
 }
 
@@ -512,6 +655,8 @@ guint64 gst_scream_controller_approve_transmits(GstScreamController *self, guint
     GList *it, *list;
     guint64 next_approve_time = DONT_APPROVE_TRANSMIT_TIME;
 
+    g_mutex_lock(&self->lock);
+
     /*
      * Update rateTransmitted and rateAcked if time for it
      * this is used in video rate computation
@@ -536,6 +681,7 @@ guint64 gst_scream_controller_approve_transmits(GstScreamController *self, guint
      */
     stream = get_prioritized_stream(self);
     if (!stream) {
+        next_approve_time = send_probe(self, time_us);
         goto end;
     } else
         GST_DEBUG("Current prioritized stream is %u", stream->id);
@@ -543,7 +689,8 @@ guint64 gst_scream_controller_approve_transmits(GstScreamController *self, guint
     /*
      * Enforce packet pacing
      */
-    if (self->next_transmit_t_us - time_us > 1000 && self->next_transmit_t_us > time_us) {
+    if (self->next_transmit_t_us - time_us > get_pacing_burst_time(self, stream) &&
+        self->next_transmit_t_us > time_us) {
         GST_DEBUG("Enforcing packet pacing: time: %" G_GUINT64_FORMAT
             ", next_transmit_t: %" G_GUINT64_FORMAT, time_us, self->next_transmit_t_us);
         next_approve_time = self->next_transmit_t_us - time_us;
@@ -554,11 +701,8 @@ guint64 gst_scream_controller_approve_transmits(GstScreamController *self, guint
      * Update bytes in flight history for congestion window validation
      */
     update_bytes_in_flight_history(self, time_us);
-    size_of_next_rtp = get_next_packet_size(stream);
-    if (!size_of_next_rtp) {
-        GST_DEBUG("Too many bytes in flight (avail: %u)", size_of_next_rtp);
-        goto end;
-    }
+    /* Only streams with a packet queued are scheduled */
+    size_of_next_rtp = stream->next_packet_size;
 
     exit = FALSE;
     /*
@@ -601,20 +745,80 @@ guint64 gst_scream_controller_approve_transmits(GstScreamController *self, guint
         /*
          * Return value 0.0 = RTP packet can be immediately transmitted
          */
-        stream->next_packet_size = 0;
-        stream->approve_transmit_callback(stream->id, stream->user_data);
+        serve_stream(self, stream);
+        /* The queue pushes the size of its next packet from the callback */
+        queue_callback(self, stream, SCREAM_CALLBACK_APPROVE_TRANSMIT);
     }
 
 end:
+    unlock_and_dispatch(self);
     return next_approve_time;
 }
 
+void gst_scream_controller_set_next_packet_size(GstScreamController *self, guint stream_id,
+    guint size)
+{
+    ScreamStream *stream;
+
+    g_mutex_lock(&self->lock);
+    stream = g_hash_table_lookup(self->streams, GUINT_TO_POINTER(stream_id));
+    if (stream) {
+        set_next_packet_size(self, stream, size);
+    }
+    g_mutex_unlock(&self->lock);
+}
+
+/* The burst time applies to the streams registered with the same user_data,
+ * so every queue on the controller keeps the tolerance of its own timer */
+void gst_scream_controller_set_pacing_burst_time(GstScreamController *self, gpointer user_data,
+    guint64 burst_time_us)
+{
+    guint64 *burst_time = g_new(guint64, 1);
+
+    *burst_time = burst_time_us;
+    g_mutex_lock(&self->lock);
+    g_hash_table_insert(self->pacing_burst_times, user_data, burst_time);
+    g_mutex_unlock(&self->lock);
+}
+
+void gst_scream_controller_clear_pacing_burst_time(GstScreamController *self, gpointer user_data)
+{
+    g_mutex_lock(&self->lock);
+    g_hash_table_remove(self->pacing_burst_times, user_data);
+    g_mutex_unlock(&self->lock);
+}
+
+guint16 gst_scream_controller_next_transport_seq(GstScreamController *self)
+{
+    guint16 seq;
+
+    g_mutex_lock(&self->lock);
+    seq = self->transport_seq++;
+    g_mutex_unlock(&self->lock);
+    return seq;
+}
+
+void gst_scream_controller_set_frame_pacing(GstScreamController *self, guint stream_id,
+    guint64 frame_latency_us, gfloat keyframe_burst)
+{
+    ScreamStream *stream;
+
+    g_mutex_lock(&self->lock);
+    stream = g_hash_table_lookup(self->streams, GUINT_TO_POINTER(stream_id));
+    if (stream) {
+        stream->frame_latency_us = MAX(frame_latency_us, 1);
+        stream->keyframe_burst = MAX(keyframe_burst, 1.0f);
+    }
+    g_mutex_unlock(&self->lock);
+}
+
 void gst_scream_controller_new_rtp_packet(GstScreamController *self, guint stream_id,
-    guint rtp_timestamp, guint64 time_us, guint bytes_in_queue, guint rtp_size)
+    guint rtp_timestamp, guint64 time_us, guint bytes_in_queue, guint rtp_size,
+    gboolean end_of_frame)
 {
     ScreamStream *stream;
-    guint32 size_of_next_rtp;
 
+    g_mutex_lock(&self->lock);
     if (!self->is_initialized) {
         initialize(self, time_us);
     }
@@ -627,6 +831,11 @@ void gst_scream_controller_new_rtp_packet(GstScreamController *self, guint strea
     }
 
     stream->bytes_rtp += rtp_size;
+    stream->frame_bytes += rtp_size;
+    if (end_of_frame) {
+        g_queue_push_tail(&stream->frames, GUINT_TO_POINTER(stream->frame_bytes));
+        stream->frame_bytes = 0;
+    }
     if (stream->last_rtp_timestamp == rtp_timestamp) {
         goto end;
     }
@@ -639,12 +848,65 @@ void gst_scream_controller_new_rtp_packet(GstScreamController *self, guint strea
     /*
      * Update MSS and min CWND
      */
-    size_of_next_rtp = get_next_packet_size(stream);
-    self->mss = MAX(self->mss, size_of_next_rtp);
+    self->mss = MAX(self->mss, rtp_size);
     self->cwnd_min = 3 * self->mss;
     self->cwnd = MAX(self->cwnd, self->cwnd_min);
 end:
-    return;
+    unlock_and_dispatch(self);
+}
+
+static void queue_callback(GstScreamController *self, ScreamStream *stream, ScreamCallbackType type)
+{
+    ScreamPendingCallback callback;
+
+    callback.type = type;
+    callback.stream_id = stream->id;
+    callback.on_bitrate_callback = stream->on_bitrate_callback;
+    callback.clear_queue = stream->clear_queue;
+    callback.approve_transmit_callback = stream->approve_transmit_callback;
+    callback.send_probe_callback = stream->send_probe_callback;
+    callback.user_data = stream->user_data;
+    callback.bitrate = (guint)stream->target_bitrate;
+    callback.size = type == SCREAM_CALLBACK_SEND_PROBE ? PROBE_PACKET_SIZE : 0;
+    g_array_append_val(self->pending_callbacks, callback);
+}
+
+static void unlock_and_dispatch(GstScreamController *self)
+{
+    GArray *callbacks = NULL;
+    ScreamPendingCallback *callback;
+    guint i;
+
+    if (self->pending_callbacks->len) {
+        callbacks = self->pending_callbacks;
+        self->pending_callbacks = g_array_new(FALSE, FALSE, sizeof(ScreamPendingCallback));
+    }
+    g_mutex_unlock(&self->lock);
+
+    if (!callbacks)
+        return;
+
+    for (i = 0; i < callbacks->len; i++) {
+        callback = &g_array_index(callbacks, ScreamPendingCallback, i);
+        switch (callback->type) {
+        case SCREAM_CALLBACK_BITRATE:
+            callback->on_bitrate_callback(callback->bitrate, callback->stream_id,
+                callback->user_data);
+            break;
+        case SCREAM_CALLBACK_CLEAR_QUEUE:
+            callback->clear_queue(callback->stream_id, callback->user_data);
+            break;
+        case SCREAM_CALLBACK_APPROVE_TRANSMIT:
+            callback->approve_transmit_callback(callback->stream_id, callback->user_data);
+            break;
+        case SCREAM_CALLBACK_SEND_PROBE:
+            if (!callback->send_probe_callback(callback->stream_id, callback->size,
+                    callback->user_data))
+                GST_DEBUG("Stream %u could not send a probe", callback->stream_id);
+            break;
+        }
+    }
+    g_array_free(callbacks, TRUE);
 }
 
 static void initialize(GstScreamController *self, guint64 time_us) {
@@ -662,87 +924,100 @@ static void initialize(GstScreamController *self, guint64 time_us) {
     self->is_initialized = TRUE;
 }
 
-static ScreamStream * get_prioritized_stream(GstScreamController *self)
+/*
+ * Streams with queued packets are scheduled by weighted fair queueing. The
+ * head-of-line packet of a stream gets a virtual finish time of
+ * start + size / priority, and the stream with the earliest finish time is
+ * served first. Backlogged streams are kept in a binary min-heap on that time,
+ * so picking a stream is O(1) and every update is O(log n).
+ */
+#define SCHEDULE_AT(self, i) ((ScreamStream *)g_ptr_array_index((self)->schedule, (i)))
+
+static void schedule_swap(GstScreamController *self, guint a, guint b)
 {
-    ScreamStream *it_stream, *stream = NULL;
-    GList *it, *list;
-    guint next_packet_size;
-    float max_prio = 0.0, max_credit = 1.0, priority;
+    ScreamStream *tmp = SCHEDULE_AT(self, a);
 
-    /*
-     * Pick a stream with credit higher or equal to
-     * the next RTP packet in queue for the given stream.
-     */
-    list = it = g_hash_table_get_values(self->streams);
-    while (it) {
-        it_stream = (ScreamStream *)it->data;
-        if (it_stream->bytes_in_queue) {
-            /*
-             * Pick stream if it has the highest credit so far
-             */
-            next_packet_size = get_next_packet_size(it_stream);
-            if (it_stream->credit >= MAX(max_credit, (float) next_packet_size)) {
-                stream = it_stream;
-                max_credit = stream->credit;
-            }
-        }
-        it = g_list_next(it);
+    g_ptr_array_index(self->schedule, a) = SCHEDULE_AT(self, b);
+    g_ptr_array_index(self->schedule, b) = tmp;
+    SCHEDULE_AT(self, a)->schedule_index = a;
+    tmp->schedule_index = b;
+}
+
+static void schedule_sift_up(GstScreamController *self, guint i)
+{
+    guint parent;
+
+    while (i > 0) {
+        parent = (i - 1) / 2;
+        if (SCHEDULE_AT(self, parent)->v_finish <= SCHEDULE_AT(self, i)->v_finish)
+            break;
+        schedule_swap(self, i, parent);
+        i = parent;
     }
-    g_list_free(list);
-    if (stream)
-        goto end;
+}
 
-    /*
-     * If the above doesn't work..
-     * Pick the stream with the highest priority that also
-     * has at least one RTP packets in queue,
-     * add credit to streams with RTP packets in queue that did not
-     * get served.
-     */
-    list = it = g_hash_table_get_values(self->streams);
-    while (it) {
-        it_stream = (ScreamStream *)it->data;
-        priority = it_stream->priority;
-        if (it_stream->bytes_in_queue > 0 && priority > max_prio) {
-            max_prio = priority;
-            stream = it_stream;
-        }
-        it = g_list_next(it);
+static void schedule_sift_down(GstScreamController *self, guint i)
+{
+    guint child, len = self->schedule->len;
+
+    while ((child = 2 * i + 1) < len) {
+        if (child + 1 < len &&
+            SCHEDULE_AT(self, child + 1)->v_finish < SCHEDULE_AT(self, child)->v_finish)
+            child++;
+        if (SCHEDULE_AT(self, i)->v_finish <= SCHEDULE_AT(self, child)->v_finish)
+            break;
+        schedule_swap(self, i, child);
+        i = child;
     }
-    g_list_free(list);
-end:
-    return stream;
+}
+
+static void schedule_remove(GstScreamController *self, ScreamStream *stream)
+{
+    guint i = stream->schedule_index, last = self->schedule->len - 1;
 
+    if (i != last)
+        schedule_swap(self, i, last);
+    g_ptr_array_remove_index(self->schedule, last);
+    stream->schedule_index = -1;
+
+    if (i < self->schedule->len) {
+        schedule_sift_up(self, i);
+        schedule_sift_down(self, i);
+    }
 }
 
-static void add_credit(GstScreamController *self, ScreamStream *served_stream,
-    int transmitted_bytes)
+static ScreamStream * get_prioritized_stream(GstScreamController *self)
 {
-    GList *it, *list;
-    ScreamStream *stream_it;
-    gfloat credit;
-    guint next_packet_size;
+    return self->schedule->len ? SCHEDULE_AT(self, 0) : NULL;
+}
 
-    list = it = g_hash_table_get_values(self->streams);
-    while (it) {
-        stream_it = (ScreamStream *)it->data;
-        if (stream_it->id != served_stream->id) {
-            credit = transmitted_bytes * stream_it->priority / served_stream->priority;
-            next_packet_size = get_next_packet_size(stream_it);
-            if (next_packet_size > 0)
-                stream_it->credit += credit;
-            else
-                stream_it->credit = MIN((float) (2*self->mss), stream_it->credit + credit);
-            }
-        it = g_list_next(it);
+static void set_next_packet_size(GstScreamController *self, ScreamStream *stream, guint size)
+{
+    stream->next_packet_size = size;
+    if (!size) {
+        if (stream->schedule_index >= 0)
+            schedule_remove(self, stream);
+        return;
+    }
+
+    stream->v_start = MAX(self->v_time, stream->v_finish_last);
+    stream->v_finish = stream->v_start + size / MAX(stream->priority, 0.001f);
+    if (stream->schedule_index < 0) {
+        stream->schedule_index = self->schedule->len;
+        g_ptr_array_add(self->schedule, stream);
+        schedule_sift_up(self, stream->schedule_index);
+    } else {
+        schedule_sift_up(self, stream->schedule_index);
+        schedule_sift_down(self, stream->schedule_index);
     }
-    g_list_free(list);
 }
 
-static void subtract_credit(ScreamStream *served_stream,
-    int transmitted_bytes)
+/* The queue pushes the size of its new head-of-line packet from the approve callback */
+static void serve_stream(GstScreamController *self, ScreamStream *stream)
 {
-    served_stream->credit = MAX(0.0f, served_stream->credit - transmitted_bytes);
+    self->v_time = stream->v_start;
+    stream->v_finish_last = stream->v_finish;
+    set_next_packet_size(self, stream, 0);
 }
 
 static guint bytes_in_flight(GstScreamController *self)
@@ -967,10 +1242,12 @@ static void update_target_stream_bitrate(GstScreamController *self, ScreamStream
             time_us - stream->t_last_rtp_q_clear_us > 5 * MAX_RTP_QUEUE_TIME * 1000000) {
             GST_DEBUG("Target bitrate :  RTP queue delay ~ %f. Clear RTP queue \n",
                     stream->tx_size_bits_avg / MAX(br,stream->target_bitrate));
-            stream->next_packet_size = 0;
+            set_next_packet_size(self, stream, 0);
             stream->bytes_in_queue = 0;
             stream->tx_size_bits_avg = 0;
-            stream->clear_queue(stream->id, stream->user_data);
+            stream->frame_bytes = 0;
+            g_queue_clear(&stream->frames);
+            queue_callback(self, stream, SCREAM_CALLBACK_CLEAR_QUEUE);
             stream->t_last_rtp_q_clear_us = time_us;
         } else if (self->in_fast_start && (tx_size_bits / stream->target_bitrate < 0.1)) {
             increment = 0.0f;
@@ -1097,7 +1374,7 @@ static void update_target_stream_bitrate(GstScreamController *self, ScreamStream
             self->in_fast_start, self->delta_t/1000.0f);
     }
     if (stream->on_bitrate_callback)
-        stream->on_bitrate_callback((guint)stream->target_bitrate, stream->id, stream->user_data);
+        queue_callback(self, stream, SCREAM_CALLBACK_BITRATE);
 }
 
 void gst_scream_controller_incoming_feedback(GstScreamController *self, guint stream_id,
@@ -1108,12 +1385,19 @@ void gst_scream_controller_incoming_feedback(GstScreamController *self, guint st
     guint64 rtt_us;
     ScreamStream *stream;
     guint32 highest_seq_ext, seq_ext;
+    gboolean probe_feedback = FALSE;
     gint n;
 
     SCREAM_UNUSED(n_ecn);
     SCREAM_UNUSED(q_bit);
 
+    g_mutex_lock(&self->lock);
     stream = g_hash_table_lookup(self->streams, GUINT_TO_POINTER(stream_id));
+    if (!stream) {
+        /* Only acknowledges the probes, losses are counted on the media SSRC */
+        stream = g_hash_table_lookup(self->probe_ssrcs, GUINT_TO_POINTER(stream_id));
+        probe_feedback = TRUE;
+    }
     if (!stream) {
         GST_WARNING("Received feedback for an unknown stream.");
         goto end;
@@ -1128,7 +1412,7 @@ void gst_scream_controller_incoming_feedback(GstScreamController *self, guint st
         packet = &self->transmitted_packets[n];
 
         if (packet->is_used==TRUE) {
-            if (stream_id == packet->stream_id) {
+            if (stream_id == packet->ssrc) {
                 if (packet->seq == highest_seq) {
                     self->acked_owd = timestamp - (guint)(packet->transmit_time_us / 1000);
                     rtt_us = time_us - packet->transmit_time_us;
@@ -1170,7 +1454,7 @@ void gst_scream_controller_incoming_feedback(GstScreamController *self, guint st
     /*
      * Determine if a loss event has occurred
      */
-    if (stream->n_loss < n_loss) {
+    if (!probe_feedback && stream->n_loss < n_loss) {
         /*
          * The loss counter has increased
          */
@@ -1195,8 +1479,7 @@ void gst_scream_controller_incoming_feedback(GstScreamController *self, guint st
     }
     update_cwnd(self, time_us);
 end:
-    return;
-
+    g_mutex_unlock(&self->lock);
 }
 
 static void update_cwnd(GstScreamController *self, guint64 time_us)
@@ -1516,9 +1799,122 @@ static gboolean is_competing_flows(GstScreamController *self) {
 }
 
 
-static guint get_next_packet_size(ScreamStream *stream)
+/*
+ * While in fast start the window can only be validated as fast as the media
+ * coder produces data. When the RTP queues are empty, ask a stream to send
+ * a padding packet so that cwnd and the target bitrates can ramp up anyway.
+ */
+static guint64 send_probe(GstScreamController *self, guint64 time_us)
+{
+    ScreamStream *it_stream, *stream = NULL;
+    GList *it, *list;
+    gfloat target_bitrate_sum = 0.0f, probe_rate;
+    guint64 next_approve_time = DONT_APPROVE_TRANSMIT_TIME;
+
+    if (!self->in_fast_start) {
+        goto end;
+    }
+
+    if (self->next_probe_t_us > time_us) {
+        next_approve_time = self->next_probe_t_us - time_us;
+        goto end;
+    }
+
+    /*
+     * Probe on the stream with the highest priority that still has room
+     * to grow
+     */
+    list = it = g_hash_table_get_values(self->streams);
+    while (it) {
+        it_stream = (ScreamStream *)it->data;
+        target_bitrate_sum += it_stream->target_bitrate;
+        if (it_stream->send_probe_callback && it_stream->target_bitrate < it_stream->max_bitrate &&
+            (!stream || it_stream->priority > stream->priority)) {
+            stream = it_stream;
+        }
+        it = g_list_next(it);
+    }
+    g_list_free(list);
+    if (!stream) {
+        goto end;
+    }
+
+    probe_rate = MAX(MINIMUM_PACE_BANDWIDTH, PROBE_RATE_HEADROOM * target_bitrate_sum);
+    if (self->rate_transmitted >= probe_rate) {
+        /*
+         * Enough is already transmitted, check again when the rates are updated
+         */
+        next_approve_time = RATE_UPDATE_INTERVAL;
+        goto end;
+    }
+
+    if (bytes_in_flight(self) + PROBE_PACKET_SIZE > self->cwnd) {
+        /*
+         * Feedback will open the window again
+         */
+        goto end;
+    }
+
+    /*
+     * Made after the lock is released. A stream that cannot probe yet is
+     * asked again at the next probe time.
+     */
+    queue_callback(self, stream, SCREAM_CALLBACK_SEND_PROBE);
+    GST_DEBUG("Probing on stream %u, probe rate %f", stream->id, probe_rate);
+    next_approve_time = (guint64)(PROBE_PACKET_SIZE * 8.0f * 1000000 / probe_rate);
+    self->next_probe_t_us = time_us + next_approve_time;
+
+end:
+    return next_approve_time;
+}
+
+static guint64 get_pacing_burst_time(GstScreamController *self, ScreamStream *stream)
+{
+    guint64 *burst_time = g_hash_table_lookup(self->pacing_burst_times, stream->user_data);
+
+    return burst_time ? *burst_time : DEFAULT_PACING_BURST_TIME;
+}
+
+static void destroy_stream(ScreamStream *stream)
 {
-    stream->next_packet_size = stream->next_packet_size != 0 ?
-        stream->next_packet_size : stream->get_next_packet_size_callback(stream->id, stream->user_data);
-    return stream->next_packet_size;
+    g_queue_clear(&stream->frames);
+    g_free(stream);
+}
+
+/*
+ * Packets are paced at cwnd/srtt, except for keyframes. A keyframe is paced
+ * fast enough to reach the receiver within frame_latency_us, but never faster
+ * than keyframe_burst times the normal pacing rate. Both are set per stream.
+ */
+static gfloat get_pacing_bitrate(GstScreamController *self, ScreamStream *stream,
+    gboolean end_of_frame)
+{
+    gfloat bitrate = self->pacing_bitrate, frame_size;
+    gboolean is_keyframe;
+
+    if (g_queue_is_empty(&stream->frames)) {
+        /* The end of the frame has not been enqueued yet */
+        goto end;
+    }
+
+    frame_size = (gfloat)GPOINTER_TO_UINT(g_queue_peek_head(&stream->frames));
+    is_keyframe = stream->frame_size_avg == 0.0f ||
+        frame_size > KEYFRAME_SIZE_FACTOR * stream->frame_size_avg;
+    if (is_keyframe && stream->keyframe_burst > 1.0f) {
+        bitrate = MAX(bitrate, frame_size * 8.0f * 1000000.0f / stream->frame_latency_us);
+        bitrate = MIN(bitrate, self->pacing_bitrate * stream->keyframe_burst);
+    }
+
+    if (end_of_frame) {
+        g_queue_pop_head(&stream->frames);
+        if (stream->frame_size_avg == 0.0f) {
+            stream->frame_size_avg = frame_size;
+        } else {
+            stream->frame_size_avg = (1.0f - FRAME_SIZE_AVG_WEIGHT) * stream->frame_size_avg +
+                FRAME_SIZE_AVG_WEIGHT * frame_size;
+        }
+    }
+
+end:
+    return bitrate;
 }
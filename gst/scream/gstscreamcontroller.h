@@ -49,6 +49,7 @@ typedef struct _GstScreamControllerClass   GstScreamControllerClass;
 
 typedef struct {
     guint stream_id;
+    guint ssrc; /* Sequence space of seq, the RTX SSRC for probes */
     guint size;
     guint seq;
     guint64 transmit_time_us;
@@ -56,9 +57,9 @@ typedef struct {
 } TransmittedRtpPacket;
 
 typedef void (*GstScreamQueueBitrateRequestedCb) (guint bitrate, guint stream_id, gpointer user_data);
-typedef guint (*GstScreamQueueNextPacketSizeCb) (guint stream_id, gpointer user_data);
 typedef void (*GstScreamQueueApproveTransmitCb) (guint stream_id, gpointer user_data);
 typedef void (*GstScreamQueueClearQueueCb) (guint stream_id, gpointer user_data);
+typedef gboolean (*GstScreamQueueSendProbeCb) (guint stream_id, guint size, gpointer user_data);
 
 #define MAX_TX_PACKETS 1000
 #define BASE_OWD_HIST_SIZE 50
@@ -70,8 +71,13 @@ struct _GstScreamController
 {
     GObject parent_instance;
 
+    /* Protects everything below, the controller is shared by the queues of a session */
     GMutex lock;
+    GArray *pending_callbacks;
     GHashTable *streams;
+    GHashTable *probe_ssrcs; /* RTX SSRC -> stream that probes on it */
+    GPtrArray *schedule;
+    gdouble v_time;
 
     gint maxTxPackets;
     gboolean approve_timer_running;
@@ -121,9 +127,14 @@ struct _GstScreamController
     // Fast start
     gboolean in_fast_start;
     guint n_fast_start;
+    guint64 next_probe_t_us;
 
     // Transmission scheduling*/
     gfloat pacing_bitrate;
+    GHashTable *pacing_burst_times; /* user_data -> burst time in us, for queues that set one */
+
+    /* Shared by all queues of the session, the receiver sees one transport-wide sequence */
+    guint16 transport_seq;
 
 	gboolean is_initialized;
 	// These need to be initialized when time_us is known
@@ -154,19 +165,38 @@ GstScreamController *gst_scream_controller_get(guint32 controller_id);
 gboolean gst_scream_controller_register_new_stream(GstScreamController *controller,
     guint stream_id, gfloat priority, guint min_bitrate, guint max_bitrate,
     GstScreamQueueBitrateRequestedCb on_bitrate_callback,
-    GstScreamQueueNextPacketSizeCb get_next_packet_size_callback,
     GstScreamQueueApproveTransmitCb approve_transmit_callback,
     GstScreamQueueClearQueueCb clear_queue,
+    GstScreamQueueSendProbeCb send_probe_callback,
     gpointer user_data);
 
+gboolean gst_scream_controller_update_stream(GstScreamController *controller,
+    guint stream_id, gfloat priority, guint min_bitrate, guint max_bitrate);
+
+void gst_scream_controller_unregister_stream(GstScreamController *self, guint stream_id);
+
 guint64 gst_scream_controller_packet_transmitted(GstScreamController *self, guint stream_id,
-    guint size, guint16 seq, guint64 transmit_time_us);
+    guint ssrc, guint size, guint16 seq, gboolean end_of_frame, guint64 transmit_time_us);
 
 void gst_scream_controller_new_rtp_packet(GstScreamController *self, guint stream_id,
-    guint rtp_timestamp, guint64 monotonic_time, guint bytes_in_queue, guint rtp_size);
+    guint rtp_timestamp, guint64 monotonic_time, guint bytes_in_queue, guint rtp_size,
+    gboolean end_of_frame);
 
 guint64 gst_scream_controller_approve_transmits(GstScreamController *self, guint64 time_us);
 
+void gst_scream_controller_set_next_packet_size(GstScreamController *self, guint stream_id,
+    guint size);
+
+void gst_scream_controller_set_pacing_burst_time(GstScreamController *self, gpointer user_data,
+    guint64 burst_time_us);
+
+void gst_scream_controller_clear_pacing_burst_time(GstScreamController *self, gpointer user_data);
+
+void gst_scream_controller_set_frame_pacing(GstScreamController *self, guint stream_id,
+    guint64 frame_latency_us, gfloat keyframe_burst);
+
+guint16 gst_scream_controller_next_transport_seq(GstScreamController *self);
+
 void gst_scream_controller_incoming_feedback(GstScreamController *self, guint stream_id,
     guint64 time_us, guint timestamp, guint highest_seq, guint n_loss, guint n_ecn, gboolean q_bit);
 
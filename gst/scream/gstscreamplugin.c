@@ -28,6 +28,7 @@
 #endif
 
 #include "gstscreamqueue.h"
+#include "gstscreamrx.h"
 
 #include "gstscreamcontroller.h"
 
@@ -35,7 +36,8 @@
 
 static gboolean plugin_init(GstPlugin *plugin)
 {
-    return gst_element_register(plugin, "screamqueue", GST_RANK_NONE, GST_TYPE_SCREAM_QUEUE);
+    return gst_element_register(plugin, "screamqueue", GST_RANK_NONE, GST_TYPE_SCREAM_QUEUE) &&
+        gst_element_register(plugin, "screamrx", GST_RANK_NONE, GST_TYPE_SCREAM_RX);
 }
 
 
@@ -27,10 +27,14 @@
 #endif
 
 #include "gstscreamqueue.h"
+#include "gstscreamrtpext.h"
 
 #include <gst/rtp/gstrtpbuffer.h>
 #include <gst/video/video.h>
 
+#include <stdio.h>
+#include <string.h>
+
 GST_DEBUG_CATEGORY(gst_scream_queue_debug_category);
 #define GST_CAT_DEFAULT gst_scream_queue_debug_category
 
@@ -43,6 +47,19 @@ static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE("sink", GST_
 static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE("src", GST_PAD_SRC,
     GST_PAD_ALWAYS, GST_STATIC_CAPS("application/x-rtp"));
 
+/*
+ * Every requested sink pad gets a source pad with the same id. All pads of the
+ * element share one scheduler thread and one controller.
+ */
+static GstStaticPadTemplate sink_request_template = GST_STATIC_PAD_TEMPLATE("sink_%u",
+    GST_PAD_SINK, GST_PAD_REQUEST, GST_STATIC_CAPS("application/x-rtp"));
+
+static GstStaticPadTemplate src_request_template = GST_STATIC_PAD_TEMPLATE("src_%u",
+    GST_PAD_SRC, GST_PAD_SOMETIMES, GST_STATIC_CAPS("application/x-rtp"));
+
+/* Set on sink pads with media=video caps, where the marker bit ends a frame */
+static GQuark video_pad_quark;
+
 typedef enum
 {
     GST_SCREAM_DATA_QUEUE_ITEM_TYPE_RTP,
@@ -68,6 +85,9 @@ typedef struct {
     gboolean rtp_marker;
     guint rtp_payload_size;
     guint64 enqueued_time;
+    gboolean probe;
+    guint32 probe_ssrc;
+    GstPad *src_pad;
 } GstScreamDataQueueRtpItem;
 
 typedef struct {
@@ -84,15 +104,45 @@ typedef struct {
 
 typedef struct {
     guint ssrc, pt;
+    GstPad *sink_pad, *src_pad;
     GstAtomicQueue *packet_queue;
     guint enqueued_payload_size;
     guint enqueued_packets;
+
+    /* Probes reuse the timestamp of the last media packet */
+    guint32 last_ts_out;
+    gboolean has_sent;
 } GstScreamStream;
 
+/*
+ * Probes are sent as padding-only RTX packets. The media sequence numbers are
+ * left alone, the probes take numbers in the RTX sequence space and the RTX
+ * packets from upstream are shifted behind them.
+ */
+typedef struct {
+    guint32 ssrc;
+    guint rtx_ssrc;
+    guint rtx_pt;
+
+    guint16 seq_offset;
+    guint16 last_seq_out;
+    gboolean has_sent;
+    gboolean upstream_seen;
+} GstScreamRtxStream;
+
+typedef struct {
+    guint min_bitrate;
+    guint max_bitrate;
+    gfloat priority;
+} GstScreamStreamConfig;
+
 enum {
     SIGNAL_BITRATE_CHANGE,
     SIGNAL_PAYLOAD_ADAPTATION_REQUEST,
     SIGNAL_INCOMING_FEEDBACK,
+    SIGNAL_SET_SSRC_CONFIG,
+    SIGNAL_SET_PAYLOAD_CONFIG,
+    SIGNAL_SET_RTX_CONFIG,
     NUM_SIGNALS
 
 };
@@ -104,6 +154,14 @@ enum {
 
     PROP_GST_SCREAM_CONTROLLER_ID,
     PROP_PASS_THROUGH,
+    PROP_PROBING,
+    PROP_PACING_MODE,
+    PROP_PACING_RESOLUTION,
+    PROP_PACING_STATS,
+    PROP_FRAME_LATENCY,
+    PROP_KEYFRAME_BURST,
+    PROP_ABS_SEND_TIME_ID,
+    PROP_TRANSPORT_CC_ID,
 
     NUM_PROPERTIES
 };
@@ -113,8 +171,41 @@ static GParamSpec *properties[NUM_PROPERTIES];
 #define DEFAULT_GST_SCREAM_CONTROLLER_ID 1
 #define DEFAULT_PRIORITY 1.0
 #define DEFAULT_PASS_THROUGH FALSE
+#define DEFAULT_PROBING FALSE
 #define SCREAM_MAX_BITRATE 5000000
 #define SCREAM_MIN_BITRATE 64000
+#define DEFAULT_PACING_MODE GST_SCREAM_QUEUE_PACING_MODE_TIMEOUT
+#define DEFAULT_PACING_RESOLUTION 1000 /* us */
+#define DEFAULT_FRAME_LATENCY 20000 /* us */
+#define DEFAULT_KEYFRAME_BURST 1.0f
+#define DEFAULT_ABS_SEND_TIME_ID 0
+#define DEFAULT_TRANSPORT_CC_ID 0
+#define MAX_ONE_BYTE_EXTENSION_ID 14
+#define NO_CLOCK_WAIT_US 100000
+
+/* Upper bounds (us) of the buckets in the pacing error histogram */
+static const guint64 pacing_hist_bounds[GST_SCREAM_QUEUE_PACING_HIST_SIZE] = {
+    50, 100, 250, 500, 1000, 2000, 5000, G_MAXUINT64
+};
+
+#define GST_TYPE_SCREAM_QUEUE_PACING_MODE (gst_scream_queue_pacing_mode_get_type())
+static GType gst_scream_queue_pacing_mode_get_type(void)
+{
+    static const GEnumValue values[] = {
+        {GST_SCREAM_QUEUE_PACING_MODE_TIMEOUT, "Wait on the incoming queue with a timeout", "timeout"},
+        {GST_SCREAM_QUEUE_PACING_MODE_CLOCK, "Wait on absolute clock deadlines", "clock"},
+        {0, NULL, NULL}
+    };
+    static volatile GType id = 0;
+
+    if (g_once_init_enter((gsize *) & id)) {
+        GType _id;
+        _id = g_enum_register_static("GstScreamQueuePacingMode", values);
+        g_once_init_leave((gsize *) & id, _id);
+    }
+
+    return id;
+}
 
 GType gst_scream_queue_pad_get_type(void);
 
@@ -126,23 +217,54 @@ static void gst_scream_queue_get_property(GObject *object, guint prop_id, GValue
     GParamSpec *pspec);
 static GstStateChangeReturn gst_scream_queue_change_state(GstElement *element,
     GstStateChange transition);
+static gboolean gst_scream_queue_set_clock(GstElement *element, GstClock *clock);
+static GstPad * gst_scream_queue_request_new_pad(GstElement *element, GstPadTemplate *templ,
+    const gchar *name, const GstCaps *caps);
+static void gst_scream_queue_release_pad(GstElement *element, GstPad *pad);
+static GstIterator * gst_scream_queue_iterate_internal_links(GstPad *pad, GstObject *parent);
 static GstFlowReturn gst_scream_queue_sink_chain(GstPad *pad, GstObject *parent, GstBuffer *buffer);
 static gboolean gst_scream_queue_sink_event(GstPad *pad, GstObject *parent, GstEvent *event);
 static gboolean gst_scream_queue_src_event(GstPad *pad, GstObject *parent, GstEvent *event);
 
 static void gst_scream_queue_srcpad_loop(GstScreamQueue *self);
-static GstScreamStream * get_stream(GstScreamQueue *self, guint ssrc, guint pt);
-
-static guint get_next_packet_rtp_payload_size(guint stream_id, GstScreamQueue *self);
+static void gst_scream_queue_srcpad_loop_clock(GstScreamQueue *self);
+static gint push_approved_packets(GstScreamQueue *self, guint64 time_now_us,
+    guint64 *time_until_next_approve);
+static void handle_incoming_item(GstScreamQueue *self, GstScreamDataQueueItem *item,
+    guint64 time_now_us);
+static void start_srcpad_task(GstScreamQueue *self);
+static gboolean pause_if_flushing(GstScreamQueue *self);
+static void wait_for_deadline(GstScreamQueue *self, guint64 deadline_us);
+static void wait_for_clock(GstScreamQueue *self);
+static void unschedule_pacing_wait(GstScreamQueue *self);
+static void set_pacing_flushing(GstScreamQueue *self, gboolean flushing);
+static GstStructure * get_pacing_stats(GstScreamQueue *self);
+static gboolean adapt_stream(GstScreamQueue *self, guint ssrc, guint pt, GstPad *src_pad);
+static void release_streams(GstScreamQueue *self, GstPad *src_pad);
 
 static gboolean configure(GstScreamQueue *self);
 static void on_bitrate_change(guint bitrate, guint stream_id, GstScreamQueue *self);
 static void approve_transmit_cb(guint stream_id, GstScreamQueue *self);
 static void clear_queue(guint stream_id, GstScreamQueue *self);
+static gboolean send_probe_cb(guint stream_id, guint size, GstScreamQueue *self);
+static GstBuffer * update_departing_packet(GstScreamQueue *self,
+    GstScreamDataQueueRtpItem *rtp_item, GstBuffer *buffer);
+static GstBuffer * stamp_header_extensions(GstScreamQueue *self, GstBuffer *buffer,
+    guint64 time_now_us);
 
 static void gst_scream_queue_incoming_feedback(GstScreamQueue *self, guint ssrc,
     guint timestamp, guint highest_seq, guint n_loss, guint n_ecn, gboolean qbit);
+static void gst_scream_queue_set_ssrc_config(GstScreamQueue *self, guint ssrc,
+    guint min_bitrate, guint max_bitrate, gfloat priority);
+static void gst_scream_queue_set_payload_config(GstScreamQueue *self, guint pt,
+    guint min_bitrate, guint max_bitrate, gfloat priority);
+static void gst_scream_queue_set_rtx_config(GstScreamQueue *self, guint ssrc, guint rtx_ssrc,
+    guint rtx_pt);
+static void get_stream_config(GstScreamQueue *self, guint ssrc, guint pt,
+    GstScreamStreamConfig *config);
 static guint64 get_gst_time_us(GstScreamQueue *self);
+static void update_pacing_burst_time(GstScreamQueue *self);
+static void update_frame_pacing(GstScreamQueue *self);
 
 static void gst_scream_queue_class_init(GstScreamQueueClass *klass)
 {
@@ -154,17 +276,25 @@ static void gst_scream_queue_class_init(GstScreamQueueClass *klass)
 
     GST_DEBUG_CATEGORY_INIT(gst_scream_queue_debug_category,
         "screamqueue", 0, "debug category for screamqueue element");
+    video_pad_quark = g_quark_from_static_string("gst-scream-queue-video-pad");
 
     gst_element_class_add_pad_template(GST_ELEMENT_CLASS(klass),
         gst_static_pad_template_get(&src_template));
     gst_element_class_add_pad_template(GST_ELEMENT_CLASS(klass),
         gst_static_pad_template_get(&sink_template));
+    gst_element_class_add_pad_template(GST_ELEMENT_CLASS(klass),
+        gst_static_pad_template_get(&src_request_template));
+    gst_element_class_add_pad_template(GST_ELEMENT_CLASS(klass),
+        gst_static_pad_template_get(&sink_request_template));
 
     gobject_class->finalize = GST_DEBUG_FUNCPTR(gst_scream_queue_finalize);
     gobject_class->set_property = GST_DEBUG_FUNCPTR(gst_scream_queue_set_property);
     gobject_class->get_property = GST_DEBUG_FUNCPTR(gst_scream_queue_get_property);
 
     element_class->change_state = GST_DEBUG_FUNCPTR(gst_scream_queue_change_state);
+    element_class->set_clock = GST_DEBUG_FUNCPTR(gst_scream_queue_set_clock);
+    element_class->request_new_pad = GST_DEBUG_FUNCPTR(gst_scream_queue_request_new_pad);
+    element_class->release_pad = GST_DEBUG_FUNCPTR(gst_scream_queue_release_pad);
 
     signals[SIGNAL_BITRATE_CHANGE] = g_signal_new("on-bitrate-change", G_TYPE_FROM_CLASS(klass),
         G_SIGNAL_RUN_LAST,
@@ -182,7 +312,27 @@ static void gst_scream_queue_class_init(GstScreamQueueClass *klass)
         g_cclosure_marshal_generic, G_TYPE_NONE, 6, G_TYPE_UINT, G_TYPE_UINT, G_TYPE_UINT,
         G_TYPE_UINT, G_TYPE_UINT, G_TYPE_BOOLEAN);
 
+    signals[SIGNAL_SET_SSRC_CONFIG] = g_signal_new("set-ssrc-config", G_TYPE_FROM_CLASS(klass),
+        G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+        G_STRUCT_OFFSET(GstScreamQueueClass, gst_scream_queue_set_ssrc_config), NULL, NULL,
+        g_cclosure_marshal_generic, G_TYPE_NONE, 4, G_TYPE_UINT, G_TYPE_UINT, G_TYPE_UINT,
+        G_TYPE_FLOAT);
+
+    signals[SIGNAL_SET_PAYLOAD_CONFIG] = g_signal_new("set-payload-config", G_TYPE_FROM_CLASS(klass),
+        G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+        G_STRUCT_OFFSET(GstScreamQueueClass, gst_scream_queue_set_payload_config), NULL, NULL,
+        g_cclosure_marshal_generic, G_TYPE_NONE, 4, G_TYPE_UINT, G_TYPE_UINT, G_TYPE_UINT,
+        G_TYPE_FLOAT);
+
+    signals[SIGNAL_SET_RTX_CONFIG] = g_signal_new("set-rtx-config", G_TYPE_FROM_CLASS(klass),
+        G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+        G_STRUCT_OFFSET(GstScreamQueueClass, gst_scream_queue_set_rtx_config), NULL, NULL,
+        g_cclosure_marshal_generic, G_TYPE_NONE, 3, G_TYPE_UINT, G_TYPE_UINT, G_TYPE_UINT);
+
     klass->gst_scream_queue_incoming_feedback = GST_DEBUG_FUNCPTR(gst_scream_queue_incoming_feedback);
+    klass->gst_scream_queue_set_ssrc_config = GST_DEBUG_FUNCPTR(gst_scream_queue_set_ssrc_config);
+    klass->gst_scream_queue_set_payload_config = GST_DEBUG_FUNCPTR(gst_scream_queue_set_payload_config);
+    klass->gst_scream_queue_set_rtx_config = GST_DEBUG_FUNCPTR(gst_scream_queue_set_rtx_config);
 
     properties[PROP_GST_SCREAM_CONTROLLER_ID] =
         g_param_spec_uint("scream-controller-id",
@@ -198,7 +348,69 @@ static void gst_scream_queue_class_init(GstScreamQueueClass *klass)
             "If set to true all packets will just pass through the plugin",
             DEFAULT_PASS_THROUGH, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
+    properties[PROP_PROBING] =
+        g_param_spec_boolean("probing",
+            "Probing",
+            "If set to true the controller may send padding-only RTX packets to probe for "
+            "bandwidth during fast start. Only streams with an RTX SSRC set through "
+            "set-rtx-config are probed on. This value must be set before going to PAUSED.",
+            DEFAULT_PROBING, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_PACING_MODE] =
+        g_param_spec_enum("pacing-mode",
+            "Pacing mode",
+            "How the scheduler waits for the next transmission. \"clock\" waits on absolute "
+            "deadlines of the element clock and is woken up by incoming packets.",
+            GST_TYPE_SCREAM_QUEUE_PACING_MODE, DEFAULT_PACING_MODE,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_PACING_RESOLUTION] =
+        g_param_spec_uint("pacing-resolution",
+            "Pacing resolution",
+            "In clock pacing mode, packets that are due within this many microseconds are sent "
+            "in the same burst instead of waiting for another timer wakeup.",
+            0, G_MAXUINT, DEFAULT_PACING_RESOLUTION,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_PACING_STATS] =
+        g_param_spec_boxed("pacing-stats",
+            "Pacing statistics",
+            "Histogram of the difference (in microseconds) between planned and actual wakeups "
+            "in clock pacing mode, and the end-of-frame latency (in microseconds) of the "
+            "adapted streams",
+            GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_FRAME_LATENCY] =
+        g_param_spec_uint("frame-latency",
+            "Frame latency",
+            "Time (us) within which the pacer tries to send a keyframe, from the moment its "
+            "last packet is queued. Only used when keyframe-burst is larger than 1.",
+            1, G_MAXUINT, DEFAULT_FRAME_LATENCY,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
+    properties[PROP_KEYFRAME_BURST] =
+        g_param_spec_float("keyframe-burst",
+            "Keyframe burst",
+            "How many times faster than the normal pacing rate a keyframe may be sent to meet "
+            "frame-latency. Applies to the streams of this queue, 1 disables it.",
+            1.0f, G_MAXFLOAT, DEFAULT_KEYFRAME_BURST,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_ABS_SEND_TIME_ID] =
+        g_param_spec_uint("abs-send-time-id",
+            "abs-send-time extension id",
+            "One-byte RTP header extension id used to stamp every departing packet with "
+            "abs-send-time, 0 disables it. Must differ from transport-cc-id",
+            0, MAX_ONE_BYTE_EXTENSION_ID, DEFAULT_ABS_SEND_TIME_ID,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_TRANSPORT_CC_ID] =
+        g_param_spec_uint("transport-cc-id",
+            "Transport-wide sequence number extension id",
+            "One-byte RTP header extension id used to stamp every departing packet with a "
+            "transport-wide sequence number, 0 disables it. Must differ from abs-send-time-id",
+            0, MAX_ONE_BYTE_EXTENSION_ID, DEFAULT_TRANSPORT_CC_ID,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
     g_object_class_install_properties(gobject_class, NUM_PROPERTIES, properties);
 
@@ -226,6 +438,9 @@ static void gst_scream_data_queue_rtp_item_free(GstScreamDataQueueRtpItem *item)
     if (((GstDataQueueItem *)item)->object) {
         gst_mini_object_unref(((GstDataQueueItem *)item)->object);
     }
+    if (item->src_pad) {
+        gst_object_unref(item->src_pad);
+    }
     g_slice_free(GstScreamDataQueueRtpItem, item);
 }
 
@@ -247,27 +462,56 @@ static void destroy_stream(GstScreamStream *stream)
 {
     clear_packet_queue(stream->packet_queue);
     gst_atomic_queue_unref(stream->packet_queue);
+    gst_object_unref(stream->sink_pad);
+    gst_object_unref(stream->src_pad);
 
     g_free(stream);
 }
 
+/* Creates a linked sink and source pair, the source pad is added first */
+static GstPad * add_pad_pair(GstScreamQueue *self, GstPadTemplate *sink_templ,
+    GstPadTemplate *src_templ, const gchar *sink_name, const gchar *src_name, GstPad **src_pad)
+{
+    GstPad *sink_pad;
+
+    *src_pad = gst_pad_new_from_template(src_templ, src_name);
+    gst_pad_set_event_function(*src_pad, GST_DEBUG_FUNCPTR(gst_scream_queue_src_event));
+    gst_pad_set_iterate_internal_links_function(*src_pad,
+        GST_DEBUG_FUNCPTR(gst_scream_queue_iterate_internal_links));
+    GST_PAD_SET_PROXY_CAPS(*src_pad);
+
+    sink_pad = gst_pad_new_from_template(sink_templ, sink_name);
+    gst_pad_set_chain_function(sink_pad, GST_DEBUG_FUNCPTR(gst_scream_queue_sink_chain));
+    gst_pad_set_event_function(sink_pad, GST_DEBUG_FUNCPTR(gst_scream_queue_sink_event));
+    gst_pad_set_iterate_internal_links_function(sink_pad,
+        GST_DEBUG_FUNCPTR(gst_scream_queue_iterate_internal_links));
+    GST_PAD_SET_PROXY_CAPS(sink_pad);
+
+    gst_pad_set_element_private(sink_pad, *src_pad);
+    gst_pad_set_element_private(*src_pad, sink_pad);
+
+    gst_element_add_pad(GST_ELEMENT(self), *src_pad);
+    gst_element_add_pad(GST_ELEMENT(self), sink_pad);
+    return sink_pad;
+}
+
 static void gst_scream_queue_init(GstScreamQueue *self)
 {
-    self->sink_pad = gst_pad_new_from_static_template(&sink_template, "sink");
-    gst_pad_set_chain_function(self->sink_pad, GST_DEBUG_FUNCPTR(gst_scream_queue_sink_chain));
-    gst_pad_set_event_function(self->sink_pad, GST_DEBUG_FUNCPTR(gst_scream_queue_sink_event));
-    GST_PAD_SET_PROXY_CAPS(self->sink_pad);
-    gst_element_add_pad(GST_ELEMENT(self), self->sink_pad);
+    GstElementClass *element_class = GST_ELEMENT_GET_CLASS(self);
 
-    self->src_pad = gst_pad_new_from_static_template(&src_template, "src");
-    gst_pad_set_event_function(self->src_pad, GST_DEBUG_FUNCPTR(gst_scream_queue_src_event));
-    GST_PAD_SET_PROXY_CAPS(self->src_pad);
-    gst_element_add_pad(GST_ELEMENT(self), self->src_pad);
+    self->sink_pad = add_pad_pair(self,
+        gst_element_class_get_pad_template(element_class, "sink"),
+        gst_element_class_get_pad_template(element_class, "src"),
+        "sink", "src", &self->src_pad);
+    self->next_pad_id = 0;
 
     g_rw_lock_init(&self->lock);
     self->streams = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify) destroy_stream);
-    self->adapted_stream_ids = g_hash_table_new(NULL, NULL);
     self->ignored_stream_ids = g_hash_table_new(NULL, NULL);
+    self->ssrc_configs = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+    self->pt_configs = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+    self->rtx_streams = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+    self->rtx_ssrcs = g_hash_table_new(NULL, NULL);
 
     self->scream_controller_id = DEFAULT_GST_SCREAM_CONTROLLER_ID;
     self->scream_controller = NULL;
@@ -279,7 +523,28 @@ static void gst_scream_queue_init(GstScreamQueue *self)
 
     self->priority = DEFAULT_PRIORITY;
     self->pass_through = DEFAULT_PASS_THROUGH;
+    self->probing = DEFAULT_PROBING;
     self->next_approve_time = 0;
+
+    self->clock = NULL;
+    self->pacing_mode = DEFAULT_PACING_MODE;
+    self->pacing_resolution = DEFAULT_PACING_RESOLUTION;
+    g_mutex_init(&self->pacing_lock);
+    g_cond_init(&self->pacing_cond);
+    self->pacing_clock_id = NULL;
+    self->pacing_flushing = FALSE;
+    self->pacing_wakeups = 0;
+    self->pacing_error_max = 0;
+    memset(self->pacing_error_hist, 0, sizeof(self->pacing_error_hist));
+
+    self->frame_latency = DEFAULT_FRAME_LATENCY;
+    self->keyframe_burst = DEFAULT_KEYFRAME_BURST;
+    self->frames_sent = 0;
+    self->frame_latency_sum = 0;
+    self->frame_latency_max = 0;
+
+    self->abs_send_time_id = DEFAULT_ABS_SEND_TIME_ID;
+    self->transport_cc_id = DEFAULT_TRANSPORT_CC_ID;
 }
 
 static void gst_scream_queue_finalize(GObject *object)
@@ -300,13 +565,21 @@ static void gst_scream_queue_finalize(GObject *object)
     g_async_queue_unref(self->incoming_packets);
 
     g_hash_table_unref(self->streams);
-    g_hash_table_unref(self->adapted_stream_ids);
     g_hash_table_unref(self->ignored_stream_ids);
+    g_hash_table_unref(self->ssrc_configs);
+    g_hash_table_unref(self->pt_configs);
+    g_hash_table_unref(self->rtx_ssrcs);
+    g_hash_table_unref(self->rtx_streams);
 
     if (self->scream_controller) {
+        gst_scream_controller_clear_pacing_burst_time(self->scream_controller, self);
         g_object_unref(self->scream_controller);
     }
 
+    gst_object_replace((GstObject **)&self->clock, NULL);
+    g_cond_clear(&self->pacing_cond);
+    g_mutex_clear(&self->pacing_lock);
+
     G_OBJECT_CLASS(parent_class)->finalize (object);
 }
 
@@ -314,6 +587,7 @@ static void gst_scream_queue_set_property(GObject *object, guint prop_id, const
     GParamSpec *pspec)
 {
     GstScreamQueue *self = GST_SCREAM_QUEUE(object);
+    guint id;
 
     switch (prop_id) {
     case PROP_GST_SCREAM_CONTROLLER_ID:
@@ -322,6 +596,41 @@ static void gst_scream_queue_set_property(GObject *object, guint prop_id, const
     case PROP_PASS_THROUGH:
         self->pass_through = g_value_get_boolean(value);
         break;
+    case PROP_PROBING:
+        self->probing = g_value_get_boolean(value);
+        break;
+    case PROP_PACING_MODE:
+        self->pacing_mode = g_value_get_enum(value);
+        update_pacing_burst_time(self);
+        break;
+    case PROP_PACING_RESOLUTION:
+        self->pacing_resolution = g_value_get_uint(value);
+        update_pacing_burst_time(self);
+        break;
+    case PROP_FRAME_LATENCY:
+        self->frame_latency = g_value_get_uint(value);
+        update_frame_pacing(self);
+        break;
+    case PROP_KEYFRAME_BURST:
+        self->keyframe_burst = g_value_get_float(value);
+        update_frame_pacing(self);
+        break;
+    case PROP_ABS_SEND_TIME_ID:
+        id = g_value_get_uint(value);
+        if (id && id == self->transport_cc_id) {
+            GST_WARNING_OBJECT(self, "abs-send-time-id %u is already used by transport-cc-id", id);
+            break;
+        }
+        self->abs_send_time_id = id;
+        break;
+    case PROP_TRANSPORT_CC_ID:
+        id = g_value_get_uint(value);
+        if (id && id == self->abs_send_time_id) {
+            GST_WARNING_OBJECT(self, "transport-cc-id %u is already used by abs-send-time-id", id);
+            break;
+        }
+        self->transport_cc_id = id;
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(self, prop_id, pspec);
         break;
@@ -340,6 +649,30 @@ static void gst_scream_queue_get_property(GObject *object, guint prop_id, GValue
     case PROP_PASS_THROUGH:
         g_value_set_boolean(value, self->pass_through);
         break;
+    case PROP_PROBING:
+        g_value_set_boolean(value, self->probing);
+        break;
+    case PROP_PACING_MODE:
+        g_value_set_enum(value, self->pacing_mode);
+        break;
+    case PROP_PACING_RESOLUTION:
+        g_value_set_uint(value, self->pacing_resolution);
+        break;
+    case PROP_PACING_STATS:
+        g_value_take_boxed(value, get_pacing_stats(self));
+        break;
+    case PROP_FRAME_LATENCY:
+        g_value_set_uint(value, self->frame_latency);
+        break;
+    case PROP_KEYFRAME_BURST:
+        g_value_set_float(value, self->keyframe_burst);
+        break;
+    case PROP_ABS_SEND_TIME_ID:
+        g_value_set_uint(value, self->abs_send_time_id);
+        break;
+    case PROP_TRANSPORT_CC_ID:
+        g_value_set_uint(value, self->transport_cc_id);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(self, prop_id, pspec);
         break;
@@ -359,9 +692,8 @@ static GstStateChangeReturn gst_scream_queue_change_state(GstElement *element,
 
     case GST_STATE_CHANGE_READY_TO_PAUSED:
         if (configure(GST_SCREAM_QUEUE(element))) {
-            gst_pad_start_task(self->src_pad, (GstTaskFunction)gst_scream_queue_srcpad_loop,
-            self, NULL);
-
+            set_pacing_flushing(self, FALSE);
+            start_srcpad_task(self);
         } else {
             GST_WARNING_OBJECT(self, "Failed to change state!");
             res = FALSE;
@@ -372,6 +704,9 @@ static GstStateChangeReturn gst_scream_queue_change_state(GstElement *element,
         break;
 
     case GST_STATE_CHANGE_PAUSED_TO_READY:
+        /* The task may be waiting for a deadline well in the future */
+        set_pacing_flushing(self, TRUE);
+        gst_pad_stop_task(self->src_pad);
         break;
 
     case GST_STATE_CHANGE_READY_TO_NULL:
@@ -386,6 +721,111 @@ static GstStateChangeReturn gst_scream_queue_change_state(GstElement *element,
     return ret;
 }
 
+static gboolean gst_scream_queue_set_clock(GstElement *element, GstClock *clock)
+{
+    GstScreamQueue *self = GST_SCREAM_QUEUE(element);
+
+    /* Keep our own reference so that timestamping does not need to ref the element clock */
+    GST_OBJECT_LOCK(self);
+    gst_object_replace((GstObject **)&self->clock, (GstObject *)clock);
+    GST_OBJECT_UNLOCK(self);
+
+    unschedule_pacing_wait(self);
+
+    return GST_ELEMENT_CLASS(parent_class)->set_clock(element, clock);
+}
+
+static gint compare_pad_name(GstPad *pad, const gchar *name)
+{
+    return g_strcmp0(GST_OBJECT_NAME(pad), name);
+}
+
+static GstPad * gst_scream_queue_request_new_pad(GstElement *element, GstPadTemplate *templ,
+    const gchar *name, const GstCaps *caps)
+{
+    GstScreamQueue *self = GST_SCREAM_QUEUE(element);
+    GstElementClass *element_class = GST_ELEMENT_GET_CLASS(element);
+    GstPad *sink_pad = NULL, *src_pad;
+    gchar *sink_name, *src_name;
+    guint pad_id;
+    gboolean exists;
+
+    SCREAM_UNUSED(caps);
+
+    if (templ != gst_element_class_get_pad_template(element_class, "sink_%u")) {
+        goto end;
+    }
+
+    GST_OBJECT_LOCK(self);
+    if (!name || sscanf(name, "sink_%u", &pad_id) != 1) {
+        pad_id = self->next_pad_id;
+    }
+    sink_name = g_strdup_printf("sink_%u", pad_id);
+    exists = g_list_find_custom(element->sinkpads, sink_name,
+        (GCompareFunc)compare_pad_name) != NULL;
+    if (!exists) {
+        self->next_pad_id = MAX(self->next_pad_id, pad_id + 1);
+    }
+    GST_OBJECT_UNLOCK(self);
+
+    if (exists) {
+        GST_WARNING_OBJECT(self, "Pad %s already exists", sink_name);
+        g_free(sink_name);
+        goto end;
+    }
+
+    src_name = g_strdup_printf("src_%u", pad_id);
+    sink_pad = add_pad_pair(self, templ,
+        gst_element_class_get_pad_template(element_class, "src_%u"),
+        sink_name, src_name, &src_pad);
+    GST_DEBUG_OBJECT(self, "Added pads %s and %s", sink_name, src_name);
+
+    g_free(sink_name);
+    g_free(src_name);
+end:
+    return sink_pad;
+}
+
+static void gst_scream_queue_release_pad(GstElement *element, GstPad *pad)
+{
+    GstScreamQueue *self = GST_SCREAM_QUEUE(element);
+    GstPad *src_pad;
+
+    GST_OBJECT_LOCK(element);
+    src_pad = gst_pad_get_element_private(pad);
+    gst_pad_set_element_private(pad, NULL);
+    if (src_pad) {
+        gst_pad_set_element_private(src_pad, NULL);
+    }
+    GST_OBJECT_UNLOCK(element);
+
+    /* Packets already approved keep their own pad references */
+    if (src_pad) {
+        gst_element_remove_pad(element, src_pad);
+        release_streams(self, src_pad);
+    }
+    gst_element_remove_pad(element, pad);
+}
+
+static GstIterator * gst_scream_queue_iterate_internal_links(GstPad *pad, GstObject *parent)
+{
+    GstIterator *it = NULL;
+    GstPad *other;
+    GValue val = G_VALUE_INIT;
+
+    GST_OBJECT_LOCK(parent);
+    other = gst_pad_get_element_private(pad);
+    if (other) {
+        g_value_init(&val, GST_TYPE_PAD);
+        g_value_set_object(&val, other);
+        it = gst_iterator_new_single(GST_TYPE_PAD, &val);
+        g_value_unset(&val);
+    }
+    GST_OBJECT_UNLOCK(parent);
+
+    return it;
+}
+
 
 static GstFlowReturn gst_scream_queue_sink_chain(GstPad *pad, GstObject *parent, GstBuffer *buffer)
 {
@@ -393,13 +833,26 @@ static GstFlowReturn gst_scream_queue_sink_chain(GstPad *pad, GstObject *parent,
     GstRTPBuffer rtp_buffer = GST_RTP_BUFFER_INIT;
     GstFlowReturn flow_ret = GST_FLOW_OK;
     GstScreamDataQueueRtpItem *rtp_item;
+    GstPad *src_pad;
 
     if (GST_PAD_IS_FLUSHING(pad)) {
         flow_ret = GST_FLOW_FLUSHING;
         goto end;
     }
 
+    GST_OBJECT_LOCK(self);
+    src_pad = gst_pad_get_element_private(pad);
+    if (src_pad) {
+        gst_object_ref(src_pad);
+    }
+    GST_OBJECT_UNLOCK(self);
+    if (!src_pad) { /* released */
+        flow_ret = GST_FLOW_FLUSHING;
+        goto end;
+    }
+
     if (!gst_rtp_buffer_map(buffer, GST_MAP_READ, &rtp_buffer)) {
+        gst_object_unref(src_pad);
         flow_ret = GST_FLOW_ERROR;
         goto end;
     }
@@ -417,20 +870,27 @@ static GstFlowReturn gst_scream_queue_sink_chain(GstPad *pad, GstObject *parent,
     rtp_item->gst_ts = GST_BUFFER_PTS(buffer);
     rtp_item->rtp_seq = gst_rtp_buffer_get_seq(&rtp_buffer);
     rtp_item->rtp_ts = gst_rtp_buffer_get_timestamp(&rtp_buffer);
-    rtp_item->rtp_marker = gst_rtp_buffer_get_marker(&rtp_buffer);
+    /* For audio the marker starts a talkspurt, it only ends a frame for video */
+    rtp_item->rtp_marker = g_object_get_qdata(G_OBJECT(pad), video_pad_quark) &&
+        gst_rtp_buffer_get_marker(&rtp_buffer);
     rtp_item->rtp_payload_size = gst_rtp_buffer_get_payload_len(&rtp_buffer);
     rtp_item->enqueued_time = get_gst_time_us(self);
+    rtp_item->probe = FALSE;
+    rtp_item->probe_ssrc = 0;
+    rtp_item->src_pad = src_pad;
     gst_rtp_buffer_unmap(&rtp_buffer);
 
     if (self->pass_through) {
         rtp_item->adapted = FALSE;
         GST_LOG_OBJECT(self, "passing through: pt = %u, seq: %u, pass: %u", rtp_item->rtp_pt, rtp_item->rtp_seq, self->pass_through);
         gst_data_queue_push(self->approved_packets, (GstDataQueueItem *)rtp_item);
+        unschedule_pacing_wait(self);
         goto end;
     }
 
     GST_LOG_OBJECT(self, "queuing: pt = %u, seq: %u, pass: %u", rtp_item->rtp_pt, rtp_item->rtp_seq, self->pass_through);
     g_async_queue_push(self->incoming_packets, (gpointer)rtp_item);
+    unschedule_pacing_wait(self);
 
 end:
     return flow_ret;
@@ -438,11 +898,32 @@ end:
 
 static gboolean gst_scream_queue_sink_event(GstPad *pad, GstObject *parent, GstEvent *event)
 {
+    GstScreamQueue *self = GST_SCREAM_QUEUE(parent);
     gboolean ret;
 
     switch (GST_EVENT_TYPE(event)) {
-        case GST_EVENT_CAPS:
+        case GST_EVENT_FLUSH_START:
+            /* Wake the task so that it sees the flush and pauses itself */
+            set_pacing_flushing(self, TRUE);
+            ret = gst_pad_event_default(pad, parent, event);
+            break;
         case GST_EVENT_FLUSH_STOP:
+            set_pacing_flushing(self, FALSE);
+            ret = gst_pad_event_default(pad, parent, event);
+            start_srcpad_task(self);
+            break;
+        case GST_EVENT_CAPS: {
+            GstCaps *caps;
+            const gchar *media;
+
+            /* Serialized with the buffers, so the chain function reads it unlocked */
+            gst_event_parse_caps(event, &caps);
+            media = gst_structure_get_string(gst_caps_get_structure(caps, 0), "media");
+            g_object_set_qdata(G_OBJECT(pad), video_pad_quark,
+                GINT_TO_POINTER(!g_strcmp0(media, "video")));
+            ret = gst_pad_event_default(pad, parent, event);
+            break;
+        }
         case GST_EVENT_STREAM_START:
         case GST_EVENT_SEGMENT:
         default:
@@ -473,14 +954,20 @@ static gboolean gst_scream_queue_src_event(GstPad *pad, GstObject *parent, GstEv
 static void gst_scream_queue_srcpad_loop(GstScreamQueue *self)
 {
     GstScreamDataQueueItem *item;
-    GstScreamDataQueueRtpItem *rtp_item;
-    GstScreamStream *stream;
-    guint stream_id;
     guint64 time_now_us, time_until_next_approve = 0;
-    GstBuffer *buffer;
+
+    if (pause_if_flushing(self)) {
+        goto end;
+    }
+
+    if (self->pacing_mode == GST_SCREAM_QUEUE_PACING_MODE_CLOCK) {
+        gst_scream_queue_srcpad_loop_clock(self);
+        goto end;
+    }
 
     time_now_us = get_gst_time_us(self);
     if (G_UNLIKELY(time_now_us == 0)) {
+        wait_for_clock(self);
         goto end;
     }
 
@@ -493,15 +980,93 @@ static void gst_scream_queue_srcpad_loop(GstScreamQueue *self)
     }
 
     /* Send all approved packets */
+    if (push_approved_packets(self, time_now_us, &time_until_next_approve) < 0) {
+        goto end; /* flushing */
+    }
+    self->next_approve_time = time_now_us + time_until_next_approve;
+
+    GST_LOG_OBJECT(self, "Popping or waiting %" G_GUINT64_FORMAT, time_until_next_approve);
+    item = (GstScreamDataQueueItem *)g_async_queue_timeout_pop(self->incoming_packets, time_until_next_approve);
+    if (!item) {
+        goto end;
+    }
+
+    handle_incoming_item(self, item, time_now_us);
+
+end:
+    return;
+
+}
+
+static void gst_scream_queue_srcpad_loop_clock(GstScreamQueue *self)
+{
+    GstScreamDataQueueItem *item;
+    guint64 time_now_us, time_until_next_approve;
+    gint n_pushed;
+
+    time_now_us = get_gst_time_us(self);
+    if (G_UNLIKELY(time_now_us == 0)) {
+        wait_for_clock(self);
+        goto end;
+    }
+
+    while ((item = (GstScreamDataQueueItem *)g_async_queue_try_pop(self->incoming_packets))) {
+        handle_incoming_item(self, item, time_now_us);
+    }
+
+    /*
+     * Packets that are due within the pacing resolution are sent in the same burst,
+     * sleeping for less than that only adds wakeup jitter
+     */
+    do {
+        time_until_next_approve = gst_scream_controller_approve_transmits(self->scream_controller,
+            time_now_us);
+        n_pushed = push_approved_packets(self, time_now_us, &time_until_next_approve);
+    } while (n_pushed > 0 && time_until_next_approve < self->pacing_resolution);
+
+    if (n_pushed < 0) {
+        goto end; /* flushing */
+    }
+    self->next_approve_time = time_now_us + time_until_next_approve;
+
+    GST_LOG_OBJECT(self, "Waiting until %" G_GUINT64_FORMAT, self->next_approve_time);
+    wait_for_deadline(self, self->next_approve_time);
+
+end:
+    return;
+}
+
+/* Time from when the last packet of a frame was queued until it was sent */
+static void record_frame_latency(GstScreamQueue *self, guint64 latency_us)
+{
+    g_mutex_lock(&self->pacing_lock);
+    self->frames_sent++;
+    self->frame_latency_sum += latency_us;
+    self->frame_latency_max = MAX(self->frame_latency_max, latency_us);
+    g_mutex_unlock(&self->pacing_lock);
+}
+
+static gint push_approved_packets(GstScreamQueue *self, guint64 time_now_us,
+    guint64 *time_until_next_approve)
+{
+    GstScreamDataQueueRtpItem *rtp_item;
+    GstBuffer *buffer;
+    guint stream_id;
+    gint n_pushed = 0;
+
     while (!gst_data_queue_is_empty(self->approved_packets)) {
         if (G_UNLIKELY(!gst_data_queue_pop(self->approved_packets,
             (GstDataQueueItem **)&rtp_item))) {
             GST_WARNING_OBJECT(self, "Failed to pop from approved packets queue. Flushing?");
-            goto end; /* flushing */
+            return -1;
         }
 
         buffer = GST_BUFFER(((GstDataQueueItem *)rtp_item)->object);
-        gst_pad_push(self->src_pad, buffer);
+        buffer = update_departing_packet(self, rtp_item, buffer);
+        /* Same time as given to packet_transmitted() below */
+        buffer = stamp_header_extensions(self, buffer, time_now_us);
+        gst_pad_push(rtp_item->src_pad, buffer);
+        gst_object_unref(rtp_item->src_pad);
 
         GST_LOG_OBJECT(self, "pushing: pt = %u, seq: %u, pass: %u", rtp_item->rtp_pt, rtp_item->rtp_seq, self->pass_through);
 
@@ -509,36 +1074,66 @@ static void gst_scream_queue_srcpad_loop(GstScreamQueue *self)
             guint tmp_time;
             stream_id = ((GstScreamDataQueueItem *)rtp_item)->rtp_ssrc;
             tmp_time = gst_scream_controller_packet_transmitted(self->scream_controller, stream_id,
-                rtp_item->rtp_payload_size, rtp_item->rtp_seq, time_now_us);
-            time_until_next_approve = MIN(time_until_next_approve, tmp_time);
+                rtp_item->probe ? rtp_item->probe_ssrc : stream_id, rtp_item->rtp_payload_size,
+                rtp_item->rtp_seq, rtp_item->rtp_marker, time_now_us);
+            *time_until_next_approve = MIN(*time_until_next_approve, tmp_time);
+
+            if (rtp_item->rtp_marker && !rtp_item->probe) {
+                record_frame_latency(self, time_now_us - MIN(time_now_us, rtp_item->enqueued_time));
+            }
         }
         g_slice_free(GstScreamDataQueueRtpItem, rtp_item);
+        n_pushed++;
     }
-    self->next_approve_time = time_now_us + time_until_next_approve;
 
-    GST_LOG_OBJECT(self, "Popping or waiting %" G_GUINT64_FORMAT, time_until_next_approve);
-    item = (GstScreamDataQueueItem *)g_async_queue_timeout_pop(self->incoming_packets, time_until_next_approve);
-    if (!item) {
-        goto end;
-    }
+    return n_pushed;
+}
+
+static void handle_incoming_item(GstScreamQueue *self, GstScreamDataQueueItem *item,
+    guint64 time_now_us)
+{
+    GstScreamStream *stream = NULL;
+    guint stream_id;
 
     stream_id = item->rtp_ssrc;
     if (item->type == GST_SCREAM_DATA_QUEUE_ITEM_TYPE_RTP) {
         GstScreamDataQueueRtpItem *rtp_item = (GstScreamDataQueueRtpItem *)item;
-        stream = get_stream(self, item->rtp_ssrc, rtp_item->rtp_pt);
+        /* Copied, the item may be approved and sent by another queue once it is enqueued */
+        guint32 rtp_ts = rtp_item->rtp_ts;
+        guint64 enqueued_time = rtp_item->enqueued_time;
+        guint payload_size = rtp_item->rtp_payload_size;
+        gboolean marker = rtp_item->rtp_marker;
+        guint enqueued_payload_size = 0;
+        gboolean head_of_line = FALSE;
+
+        if (adapt_stream(self, item->rtp_ssrc, rtp_item->rtp_pt, rtp_item->src_pad)) {
+            /* The pad of the stream may be released at any time, see release_streams() */
+            g_rw_lock_writer_lock(&self->lock);
+            stream = g_hash_table_lookup(self->streams, GUINT_TO_POINTER(stream_id));
+            if (stream) {
+                rtp_item->adapted = TRUE;
+                gst_atomic_queue_push(stream->packet_queue, rtp_item);
+                stream->enqueued_payload_size += payload_size;
+                stream->enqueued_packets++;
+                enqueued_payload_size = stream->enqueued_payload_size;
+                head_of_line = stream->enqueued_packets == 1;
+            }
+            g_rw_lock_writer_unlock(&self->lock);
+        }
+
         if (!stream) {
             rtp_item->adapted = FALSE;
             GST_LOG_OBJECT(self, "!adapted, approving: pt = %u, seq: %u, pass: %u",
                     rtp_item->rtp_pt, rtp_item->rtp_seq, self->pass_through);
             gst_data_queue_push(self->approved_packets, (GstDataQueueItem *)item);
         } else {
-            gst_atomic_queue_push(stream->packet_queue, rtp_item);
-            stream->enqueued_payload_size += rtp_item->rtp_payload_size;
-            stream->enqueued_packets++;
-            rtp_item->adapted = TRUE;
             self->next_approve_time = 0;
-            gst_scream_controller_new_rtp_packet(self->scream_controller, stream_id, rtp_item->rtp_ts,
-                rtp_item->enqueued_time, stream->enqueued_payload_size, rtp_item->rtp_payload_size);
+            if (head_of_line) {
+                gst_scream_controller_set_next_packet_size(self->scream_controller, stream_id,
+                    payload_size);
+            }
+            gst_scream_controller_new_rtp_packet(self->scream_controller, stream_id, rtp_ts,
+                enqueued_time, enqueued_payload_size, payload_size, marker);
         }
     } else { /* item->type == GST_SCREAM_DATA_QUEUE_ITEM_TYPE_RTCP */
         GstScreamDataQueueRtcpItem *rtcp_item = (GstScreamDataQueueRtcpItem *)item;
@@ -548,81 +1143,260 @@ static void gst_scream_queue_srcpad_loop(GstScreamQueue *self)
 
         ((GstDataQueueItem *)item)->destroy(item);
     }
+}
+
+static void start_srcpad_task(GstScreamQueue *self)
+{
+    gst_pad_start_task(self->src_pad, (GstTaskFunction)gst_scream_queue_srcpad_loop, self, NULL);
+}
+
+/* The task is started again on FLUSH_STOP */
+static gboolean pause_if_flushing(GstScreamQueue *self)
+{
+    gboolean flushing;
+
+    g_mutex_lock(&self->pacing_lock);
+    flushing = self->pacing_flushing;
+    g_mutex_unlock(&self->pacing_lock);
+
+    if (flushing) {
+        gst_pad_pause_task(self->src_pad);
+    }
+    return flushing;
+}
+
+static void wait_for_deadline(GstScreamQueue *self, guint64 deadline_us)
+{
+    GstClock *clock;
+    GstClockID clock_id;
+    GstClockReturn clock_ret = GST_CLOCK_UNSCHEDULED;
+    gboolean flushing;
+    gint64 error_us;
+    guint i;
+
+    GST_OBJECT_LOCK(self);
+    clock = self->clock ? gst_object_ref(self->clock) : NULL;
+    GST_OBJECT_UNLOCK(self);
+
+    if (G_UNLIKELY(!clock)) {
+        wait_for_clock(self);
+        goto end;
+    }
+
+    clock_id = gst_clock_new_single_shot_id(clock, deadline_us * GST_USECOND);
+    g_mutex_lock(&self->pacing_lock);
+    self->pacing_clock_id = clock_id;
+    flushing = self->pacing_flushing;
+    g_mutex_unlock(&self->pacing_lock);
+
+    /* Anything queued before the id was published could not unschedule it */
+    if (!flushing && g_async_queue_length(self->incoming_packets) <= 0
+        && gst_data_queue_is_empty(self->approved_packets)) {
+        clock_ret = gst_clock_id_wait(clock_id, NULL);
+    }
+
+    g_mutex_lock(&self->pacing_lock);
+    self->pacing_clock_id = NULL;
+    if (clock_ret == GST_CLOCK_OK) {
+        error_us = (gint64)(gst_clock_get_time(clock) / GST_USECOND) - (gint64)deadline_us;
+        error_us = MAX(0, error_us);
+        i = 0;
+        while ((guint64)error_us > pacing_hist_bounds[i])
+            i++;
+        self->pacing_error_hist[i]++;
+        self->pacing_error_max = MAX(self->pacing_error_max, (guint64)error_us);
+        self->pacing_wakeups++;
+    }
+    g_mutex_unlock(&self->pacing_lock);
+
+    gst_clock_id_unref(clock_id);
+    gst_object_unref(clock);
 
 end:
     return;
+}
 
+/* Without a clock there is nothing to pace against, so sleep until one is set */
+static void wait_for_clock(GstScreamQueue *self)
+{
+    gint64 end_time = g_get_monotonic_time() + NO_CLOCK_WAIT_US;
+    gboolean has_clock;
+
+    g_mutex_lock(&self->pacing_lock);
+    while (!self->pacing_flushing) {
+        GST_OBJECT_LOCK(self);
+        has_clock = self->clock != NULL;
+        GST_OBJECT_UNLOCK(self);
+        if (has_clock || !g_cond_wait_until(&self->pacing_cond, &self->pacing_lock, end_time)) {
+            break;
+        }
+    }
+    g_mutex_unlock(&self->pacing_lock);
+}
+
+static void unschedule_pacing_wait(GstScreamQueue *self)
+{
+    g_mutex_lock(&self->pacing_lock);
+    if (self->pacing_clock_id) {
+        gst_clock_id_unschedule(self->pacing_clock_id);
+    }
+    g_cond_broadcast(&self->pacing_cond);
+    g_mutex_unlock(&self->pacing_lock);
 }
 
+static void set_pacing_flushing(GstScreamQueue *self, gboolean flushing)
+{
+    g_mutex_lock(&self->pacing_lock);
+    self->pacing_flushing = flushing;
+    g_mutex_unlock(&self->pacing_lock);
+
+    if (flushing) {
+        unschedule_pacing_wait(self);
+    }
+}
 
-static GstScreamStream * get_stream(GstScreamQueue *self, guint ssrc, guint pt)
+static GstStructure * get_pacing_stats(GstScreamQueue *self)
+{
+    GstStructure *stats;
+    GValue bounds = G_VALUE_INIT, hist = G_VALUE_INIT, value = G_VALUE_INIT;
+    guint i;
+
+    g_value_init(&bounds, GST_TYPE_ARRAY);
+    g_value_init(&hist, GST_TYPE_ARRAY);
+    g_value_init(&value, G_TYPE_UINT64);
+
+    g_mutex_lock(&self->pacing_lock);
+    for (i = 0; i < GST_SCREAM_QUEUE_PACING_HIST_SIZE; i++) {
+        g_value_set_uint64(&value, pacing_hist_bounds[i]);
+        gst_value_array_append_value(&bounds, &value);
+        g_value_set_uint64(&value, self->pacing_error_hist[i]);
+        gst_value_array_append_value(&hist, &value);
+    }
+    stats = gst_structure_new("application/x-scream-pacing-stats",
+        "wakeups", G_TYPE_UINT64, self->pacing_wakeups,
+        "max-error", G_TYPE_UINT64, self->pacing_error_max,
+        "frames", G_TYPE_UINT64, self->frames_sent,
+        "frame-latency-avg", G_TYPE_UINT64,
+        self->frames_sent ? self->frame_latency_sum / self->frames_sent : (guint64)0,
+        "frame-latency-max", G_TYPE_UINT64, self->frame_latency_max,
+        NULL);
+    g_mutex_unlock(&self->pacing_lock);
+
+    gst_structure_take_value(stats, "histogram-bounds", &bounds);
+    gst_structure_take_value(stats, "histogram", &hist);
+    g_value_unset(&value);
+
+    return stats;
+}
+
+
+/*
+ * Whether the packets of ssrc are adapted, the stream is registered with the
+ * controller the first time. A stream whose pad was released is asked about again.
+ */
+static gboolean adapt_stream(GstScreamQueue *self, guint ssrc, guint pt, GstPad *src_pad)
 {
     GstScreamStream *stream = NULL;
-    gboolean adapt_stream = FALSE;
+    GstScreamStreamConfig config;
+    gboolean adapt = FALSE, adapted;
     guint stream_id = ssrc;
 
-    if (G_LIKELY(g_hash_table_contains(self->adapted_stream_ids, GUINT_TO_POINTER(stream_id)))) {
-        g_rw_lock_reader_lock(&self->lock);
-        stream = g_hash_table_lookup(self->streams, GUINT_TO_POINTER(stream_id));
-        g_rw_lock_reader_unlock(&self->lock);
+    g_rw_lock_reader_lock(&self->lock);
+    adapted = g_hash_table_contains(self->streams, GUINT_TO_POINTER(stream_id));
+    g_rw_lock_reader_unlock(&self->lock);
+
+    if (G_LIKELY(adapted)) {
+        /* DO NOTHING */
     } else if (g_hash_table_contains(self->ignored_stream_ids, GUINT_TO_POINTER(stream_id))) {
         /* DO NOTHING */
+    } else if (GST_OBJECT_PARENT(src_pad) != GST_OBJECT(self)) {
+        /* Still queued from a released pad */
     } else {
-        g_signal_emit_by_name(self, "on-payload-adaptation-request", pt, &adapt_stream);
-        if (!adapt_stream) {
+        g_signal_emit_by_name(self, "on-payload-adaptation-request", pt, &adapt);
+        if (!adapt) {
             GST_DEBUG_OBJECT(self, "Ignoring adaptation for payload %u for ssrc %u", pt, stream_id);
             g_hash_table_add(self->ignored_stream_ids, GUINT_TO_POINTER(stream_id));
         } else {
+            /* Looked up after the request so the handler can configure the stream */
+            get_stream_config(self, ssrc, pt, &config);
             if (gst_scream_controller_register_new_stream(self->scream_controller,
-                    stream_id, self->priority, SCREAM_MIN_BITRATE, SCREAM_MAX_BITRATE,
+                    stream_id, config.priority, config.min_bitrate, config.max_bitrate,
                     (GstScreamQueueBitrateRequestedCb)on_bitrate_change,
-                    (GstScreamQueueNextPacketSizeCb)get_next_packet_rtp_payload_size,
                     (GstScreamQueueApproveTransmitCb)approve_transmit_cb,
                     (GstScreamQueueClearQueueCb)clear_queue,
+                    self->probing ? (GstScreamQueueSendProbeCb)send_probe_cb : NULL,
                     (gpointer)self)) {
 
                 stream = g_new0(GstScreamStream, 1);
                 stream->ssrc = ssrc;
                 stream->pt = pt;
+                stream->src_pad = gst_object_ref(src_pad);
+                GST_OBJECT_LOCK(self);
+                stream->sink_pad = gst_object_ref(gst_pad_get_element_private(src_pad) ?
+                    gst_pad_get_element_private(src_pad) : self->sink_pad);
+                GST_OBJECT_UNLOCK(self);
                 stream->packet_queue = gst_atomic_queue_new(0);
                 stream->enqueued_payload_size = 0;
                 stream->enqueued_packets = 0;
+                stream->has_sent = FALSE;
                 g_rw_lock_writer_lock(&self->lock);
                 g_hash_table_insert(self->streams, GUINT_TO_POINTER(stream_id), stream);
                 g_rw_lock_writer_unlock(&self->lock);
-                g_hash_table_add(self->adapted_stream_ids, GUINT_TO_POINTER(stream_id));
+                /* After the insert, so that a concurrent property change is not missed */
+                gst_scream_controller_set_frame_pacing(self->scream_controller, stream_id,
+                    self->frame_latency, self->keyframe_burst);
+                adapted = TRUE;
             } else {
                 GST_WARNING_OBJECT(self, "Failed to register new stream\n");
             }
         }
     }
-    return stream;
+    return adapted;
 }
 
-
-
-static guint get_next_packet_rtp_payload_size(guint stream_id, GstScreamQueue *self)
+/*
+ * The streams of a released pad leave the controller and their queued packets are
+ * dropped. Callbacks from the controller may still arrive for them, so the streams
+ * are only used with the lock held.
+ */
+static void release_streams(GstScreamQueue *self, GstPad *src_pad)
 {
-    GstScreamDataQueueRtpItem *item;
     GstScreamStream *stream;
-    guint size = 0;
+    GHashTableIter iter;
+    gpointer value;
+    GList *released = NULL, *it;
+
+    g_rw_lock_writer_lock(&self->lock);
+    g_hash_table_iter_init(&iter, self->streams);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        stream = value;
+        if (stream->src_pad == src_pad) {
+            g_hash_table_iter_steal(&iter);
+            released = g_list_prepend(released, stream);
+        }
+    }
+    g_rw_lock_writer_unlock(&self->lock);
 
-    g_rw_lock_reader_lock(&self->lock);
-    stream = g_hash_table_lookup(self->streams, GUINT_TO_POINTER(stream_id));
-    g_rw_lock_reader_unlock(&self->lock);
-    if ((item = gst_atomic_queue_peek(stream->packet_queue))) {
-        size = item->rtp_payload_size;
+    for (it = released; it; it = it->next) {
+        stream = it->data;
+        GST_DEBUG_OBJECT(self, "Releasing stream %u", stream->ssrc);
+        if (self->scream_controller) {
+            gst_scream_controller_unregister_stream(self->scream_controller, stream->ssrc);
+        }
+        destroy_stream(stream);
     }
-    return size;
+    g_list_free(released);
 }
 
 
+
 static gboolean configure(GstScreamQueue *self) {
     gboolean res = TRUE;
     GstScreamController *controller = gst_scream_controller_get(self->scream_controller_id);
 
     if (controller) {
         self->scream_controller = controller;
+        update_pacing_burst_time(self);
     } else {
         res = FALSE;
         GST_WARNING_OBJECT(self, "Could not create Scream Controller");
@@ -631,51 +1405,285 @@ static gboolean configure(GstScreamQueue *self) {
     return res;
 }
 
+/* Only the clock mode releases packets in bursts, the timeout mode keeps the
+ * controller's default tolerance */
+static void update_pacing_burst_time(GstScreamQueue *self)
+{
+    if (!self->scream_controller) {
+        return;
+    }
+
+    if (self->pacing_mode == GST_SCREAM_QUEUE_PACING_MODE_CLOCK) {
+        gst_scream_controller_set_pacing_burst_time(self->scream_controller, self,
+            self->pacing_resolution);
+    } else {
+        gst_scream_controller_clear_pacing_burst_time(self->scream_controller, self);
+    }
+}
+
+/* Frame pacing is kept per stream in the controller, other queues may pace differently */
+static void update_frame_pacing(GstScreamQueue *self)
+{
+    GHashTableIter iter;
+    gpointer key;
+    GArray *stream_ids;
+    guint i;
+
+    if (!self->scream_controller) {
+        return;
+    }
+
+    stream_ids = g_array_new(FALSE, FALSE, sizeof(guint));
+    g_rw_lock_reader_lock(&self->lock);
+    g_hash_table_iter_init(&iter, self->streams);
+    while (g_hash_table_iter_next(&iter, &key, NULL)) {
+        guint stream_id = GPOINTER_TO_UINT(key);
+        g_array_append_val(stream_ids, stream_id);
+    }
+    g_rw_lock_reader_unlock(&self->lock);
+
+    for (i = 0; i < stream_ids->len; i++) {
+        gst_scream_controller_set_frame_pacing(self->scream_controller,
+            g_array_index(stream_ids, guint, i), self->frame_latency, self->keyframe_burst);
+    }
+    g_array_free(stream_ids, TRUE);
+}
+
 static void on_bitrate_change(guint bitrate, guint stream_id, GstScreamQueue *self)
 {
     GstScreamStream *stream;
+    guint ssrc = 0, pt = 0;
 
     GST_DEBUG_OBJECT(self, "Updating bitrate of stream %u to %u bps", stream_id, bitrate);
 
     g_rw_lock_reader_lock(&self->lock);
     stream = g_hash_table_lookup(self->streams, GUINT_TO_POINTER(stream_id));
+    if (stream) {
+        ssrc = stream->ssrc;
+        pt = stream->pt;
+    }
     g_rw_lock_reader_unlock(&self->lock);
 
-    g_signal_emit_by_name(self, "on-bitrate-change", bitrate, stream->ssrc, stream->pt);
+    if (stream) {
+        g_signal_emit_by_name(self, "on-bitrate-change", bitrate, ssrc, pt);
+    }
 }
 
 
 static void approve_transmit_cb(guint stream_id, GstScreamQueue *self) {
     GstScreamDataQueueRtpItem *item;
     GstScreamStream *stream;
+    gboolean approved = FALSE;
+    guint next_size = 0;
 
-    g_rw_lock_reader_lock(&self->lock);
+    /* The counters are also updated by the task of the queue */
+    g_rw_lock_writer_lock(&self->lock);
     stream = g_hash_table_lookup(self->streams, GUINT_TO_POINTER(stream_id));
-    g_rw_lock_reader_unlock(&self->lock);
-
-    if ((item = gst_atomic_queue_pop(stream->packet_queue))) {
+    if (stream && (item = gst_atomic_queue_pop(stream->packet_queue))) {
         stream->enqueued_payload_size -= item->rtp_payload_size;
         stream->enqueued_packets--;
         GST_LOG_OBJECT(self, "approving: pt = %u, seq: %u, pass: %u",
                 item->rtp_pt, item->rtp_seq, self->pass_through);
         gst_data_queue_push(self->approved_packets, (GstDataQueueItem *)item);
+
+        item = gst_atomic_queue_peek(stream->packet_queue);
+        next_size = item ? item->rtp_payload_size : 0;
+        approved = TRUE;
+    }
+    g_rw_lock_writer_unlock(&self->lock);
+
+    if (approved) {
+        /* Tell the scheduler about the new head of line */
+        gst_scream_controller_set_next_packet_size(self->scream_controller, stream_id, next_size);
     } else
-        GST_LOG_OBJECT(self, "Got approve callback on an empty queue, or flushing");
+        GST_LOG_OBJECT(self, "Got approve callback on an empty queue, released stream, or flushing");
 }
 
 static void clear_queue(guint stream_id, GstScreamQueue *self)
 {
     GstScreamStream *stream;
+    GstPad *sink_pad = NULL;
+
+    g_rw_lock_writer_lock(&self->lock);
+    stream = g_hash_table_lookup(self->streams, GUINT_TO_POINTER(stream_id));
+    if (stream) {
+        clear_packet_queue(stream->packet_queue);
+        stream->enqueued_payload_size = 0;
+        stream->enqueued_packets = 0;
+        sink_pad = gst_object_ref(stream->sink_pad);
+    }
+    g_rw_lock_writer_unlock(&self->lock);
+
+    if (sink_pad) {
+        gst_pad_push_event(sink_pad,
+            gst_video_event_new_upstream_force_key_unit(GST_CLOCK_TIME_NONE, FALSE, 0));
+        gst_object_unref(sink_pad);
+    }
+}
+
+
+static gboolean send_probe_cb(guint stream_id, guint size, GstScreamQueue *self)
+{
+    GstScreamDataQueueRtpItem *rtp_item;
+    GstScreamStream *stream;
+    GstScreamRtxStream *rtx_stream;
+    GstRTPBuffer rtp_buffer = GST_RTP_BUFFER_INIT;
+    GstBuffer *buffer;
+    GstPad *src_pad = NULL;
+    guint ssrc = 0, rtx_ssrc = 0, rtx_pt = 0;
+    guint8 pad_len;
+
     g_rw_lock_reader_lock(&self->lock);
     stream = g_hash_table_lookup(self->streams, GUINT_TO_POINTER(stream_id));
+    rtx_stream = g_hash_table_lookup(self->rtx_streams, GUINT_TO_POINTER(stream_id));
+    /* The probe takes the timestamp of the last media packet, so we need one first */
+    if (stream && stream->has_sent && rtx_stream) {
+        ssrc = stream->ssrc;
+        src_pad = gst_object_ref(stream->src_pad);
+        rtx_ssrc = rtx_stream->rtx_ssrc;
+        rtx_pt = rtx_stream->rtx_pt;
+    }
     g_rw_lock_reader_unlock(&self->lock);
-    clear_packet_queue(stream->packet_queue);
-    stream->enqueued_payload_size = 0;
-    stream->enqueued_packets = 0;
-    gst_pad_push_event(self->sink_pad,
-        gst_video_event_new_upstream_force_key_unit(GST_CLOCK_TIME_NONE, FALSE, 0));
+
+    if (!src_pad) {
+        return FALSE;
+    }
+
+    pad_len = (guint8)CLAMP(size, 1, G_MAXUINT8);
+    buffer = gst_rtp_buffer_new_allocate(0, pad_len, 0);
+    gst_rtp_buffer_map(buffer, GST_MAP_WRITE, &rtp_buffer);
+    gst_rtp_buffer_set_ssrc(&rtp_buffer, rtx_ssrc);
+    gst_rtp_buffer_set_payload_type(&rtp_buffer, rtx_pt);
+    gst_rtp_buffer_unmap(&rtp_buffer);
+
+    rtp_item = g_slice_new(GstScreamDataQueueRtpItem);
+    ((GstDataQueueItem *)rtp_item)->object = GST_MINI_OBJECT(buffer);
+    ((GstDataQueueItem *)rtp_item)->size = gst_buffer_get_size(buffer);
+    ((GstDataQueueItem *)rtp_item)->visible = TRUE;
+    ((GstDataQueueItem *)rtp_item)->duration = GST_CLOCK_TIME_NONE;
+    ((GstDataQueueItem *)rtp_item)->destroy = (GDestroyNotify) gst_scream_data_queue_rtp_item_free;
+
+    ((GstScreamDataQueueItem *)rtp_item)->type = GST_SCREAM_DATA_QUEUE_ITEM_TYPE_RTP;
+    ((GstScreamDataQueueItem *)rtp_item)->rtp_ssrc = ssrc;
+    rtp_item->rtp_pt = rtx_pt;
+    rtp_item->gst_ts = GST_CLOCK_TIME_NONE;
+    rtp_item->adapted = TRUE;
+    /* Sequence number and timestamp are assigned when the packet departs */
+    rtp_item->rtp_seq = 0;
+    rtp_item->rtp_ts = 0;
+    rtp_item->rtp_marker = FALSE;
+    rtp_item->rtp_payload_size = pad_len;
+    rtp_item->enqueued_time = 0;
+    rtp_item->probe = TRUE;
+    rtp_item->probe_ssrc = rtx_ssrc;
+    rtp_item->src_pad = src_pad;
+
+    GST_LOG_OBJECT(self, "probing: ssrc = %u, rtx ssrc = %u, size = %u", ssrc, rtx_ssrc,
+        pad_len);
+    gst_data_queue_push(self->approved_packets, (GstDataQueueItem *)rtp_item);
+
+    return TRUE;
 }
 
+/*
+ * Media packets leave with the sequence numbers they came with. A probe takes
+ * the next number on its RTX SSRC, and the RTX packets that upstream sends on
+ * the same SSRC are shifted by the probes sent so far. The stream state is
+ * written to, so the lock is taken for writing.
+ */
+static GstBuffer * update_departing_packet(GstScreamQueue *self,
+    GstScreamDataQueueRtpItem *rtp_item, GstBuffer *buffer)
+{
+    GstScreamStream *stream = NULL;
+    GstScreamRtxStream *rtx_stream;
+    gboolean rewrite = FALSE;
+    guint32 ssrc;
+
+    g_rw_lock_writer_lock(&self->lock);
+    if (rtp_item->adapted) {
+        /* NULL if the pad of the stream was released after the packet was approved */
+        stream = g_hash_table_lookup(self->streams,
+            GUINT_TO_POINTER(((GstScreamDataQueueItem *)rtp_item)->rtp_ssrc));
+    }
+    if (stream && !rtp_item->probe) {
+        stream->last_ts_out = rtp_item->rtp_ts;
+        stream->has_sent = TRUE;
+    }
+
+    ssrc = rtp_item->probe ? rtp_item->probe_ssrc : ((GstScreamDataQueueItem *)rtp_item)->rtp_ssrc;
+    rtx_stream = g_hash_table_lookup(self->rtx_ssrcs, GUINT_TO_POINTER(ssrc));
+    if (!rtx_stream) {
+        goto end;
+    }
+
+    if (rtp_item->probe) {
+        rtp_item->rtp_seq = rtx_stream->has_sent ? rtx_stream->last_seq_out + 1 :
+            (guint16)g_random_int();
+        rtp_item->rtp_ts = stream ? stream->last_ts_out : 0;
+        rtx_stream->seq_offset++;
+    } else {
+        if (!rtx_stream->upstream_seen) {
+            /* Continue after the probes that were sent before the first RTX packet */
+            rtx_stream->seq_offset = rtx_stream->has_sent ?
+                (guint16)(rtx_stream->last_seq_out + 1 - rtp_item->rtp_seq) : 0;
+            rtx_stream->upstream_seen = TRUE;
+        }
+        rtp_item->rtp_seq += rtx_stream->seq_offset;
+    }
+    rtx_stream->last_seq_out = rtp_item->rtp_seq;
+    rtx_stream->has_sent = TRUE;
+    rewrite = rtp_item->probe || rtx_stream->seq_offset;
+
+end:
+    g_rw_lock_writer_unlock(&self->lock);
+
+    if (rewrite) {
+        buffer = gst_buffer_make_writable(buffer);
+        gst_scream_rtp_set_seq_timestamp(buffer, rtp_item->rtp_seq, rtp_item->rtp_ts);
+    }
+    return buffer;
+}
+
+/*
+ * Only the header memory is written to, payload memories are left shared with
+ * upstream. Buffers produced by the payloaders are normally already writable.
+ * The transport-wide sequence number comes from the controller, so that it is
+ * shared with the other queues of the session.
+ */
+static GstBuffer * stamp_header_extensions(GstScreamQueue *self, GstBuffer *buffer,
+    guint64 time_now_us)
+{
+    GstScreamRtpExtension extensions[2];
+    guint8 abs_send_time[3], transport_seq[2];
+    guint n_extensions = 0;
+
+    if (self->abs_send_time_id) {
+        GST_WRITE_UINT24_BE(abs_send_time, gst_scream_rtp_abs_send_time(time_now_us));
+        extensions[n_extensions].id = self->abs_send_time_id;
+        extensions[n_extensions].data = abs_send_time;
+        extensions[n_extensions].size = sizeof(abs_send_time);
+        n_extensions++;
+    }
+    if (self->transport_cc_id) {
+        GST_WRITE_UINT16_BE(transport_seq,
+            gst_scream_controller_next_transport_seq(self->scream_controller));
+        extensions[n_extensions].id = self->transport_cc_id;
+        extensions[n_extensions].data = transport_seq;
+        extensions[n_extensions].size = sizeof(transport_seq);
+        n_extensions++;
+    }
+    if (!n_extensions) {
+        goto end;
+    }
+
+    buffer = gst_buffer_make_writable(buffer);
+    if (!gst_scream_rtp_write_extensions(buffer, extensions, n_extensions)) {
+        GST_WARNING_OBJECT(self, "Failed to write header extensions");
+    }
+
+end:
+    return buffer;
+}
 
 static void gst_scream_queue_incoming_feedback(GstScreamQueue *self, guint ssrc,
     guint timestamp, guint highest_seq, guint n_loss, guint n_ecn, gboolean qbit)
@@ -696,17 +1704,148 @@ static void gst_scream_queue_incoming_feedback(GstScreamQueue *self, guint ssrc,
     rtcp_item->qbit = qbit;
 
     g_async_queue_push(self->incoming_packets, (gpointer)rtcp_item);
+    unschedule_pacing_wait(self);
 }
 
 static guint64 get_gst_time_us(GstScreamQueue *self)
 {
-    GstClock *clock = NULL;
     GstClockTime time = 0;
 
-    clock = gst_element_get_clock(GST_ELEMENT(self));
-    if (G_LIKELY(clock)) {
-        time = gst_clock_get_time(clock);
-        gst_object_unref (clock);
+    GST_OBJECT_LOCK(self);
+    if (G_LIKELY(self->clock)) {
+        time = gst_clock_get_time(self->clock);
     }
+    GST_OBJECT_UNLOCK(self);
     return time / 1000;
 }
+
+static void get_stream_config(GstScreamQueue *self, guint ssrc, guint pt,
+    GstScreamStreamConfig *config)
+{
+    GstScreamStreamConfig *found;
+
+    GST_OBJECT_LOCK(self);
+    found = g_hash_table_lookup(self->ssrc_configs, GUINT_TO_POINTER(ssrc));
+    if (!found) {
+        found = g_hash_table_lookup(self->pt_configs, GUINT_TO_POINTER(pt));
+    }
+    if (found) {
+        *config = *found;
+    } else {
+        config->min_bitrate = SCREAM_MIN_BITRATE;
+        config->max_bitrate = SCREAM_MAX_BITRATE;
+        config->priority = self->priority;
+    }
+    GST_OBJECT_UNLOCK(self);
+}
+
+static gboolean store_stream_config(GstScreamQueue *self, GHashTable *configs, guint key,
+    guint min_bitrate, guint max_bitrate, gfloat priority)
+{
+    GstScreamStreamConfig *config;
+
+    if (min_bitrate > max_bitrate || priority <= 0.0f) {
+        GST_WARNING_OBJECT(self, "Invalid stream config: min = %u, max = %u, priority = %f",
+            min_bitrate, max_bitrate, priority);
+        return FALSE;
+    }
+
+    config = g_new0(GstScreamStreamConfig, 1);
+    config->min_bitrate = min_bitrate;
+    config->max_bitrate = max_bitrate;
+    config->priority = priority;
+
+    GST_OBJECT_LOCK(self);
+    g_hash_table_insert(configs, GUINT_TO_POINTER(key), config);
+    GST_OBJECT_UNLOCK(self);
+    return TRUE;
+}
+
+/* Push the current configuration of every registered stream to the controller */
+static void update_stream_configs(GstScreamQueue *self)
+{
+    GstScreamStreamConfig config;
+    GstScreamStream *stream;
+    GHashTableIter iter;
+    GArray *keys;
+    guint i;
+
+    if (!self->scream_controller) {
+        return;
+    }
+
+    keys = g_array_new(FALSE, FALSE, sizeof(guint));
+    g_rw_lock_reader_lock(&self->lock);
+    g_hash_table_iter_init(&iter, self->streams);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&stream)) {
+        g_array_append_val(keys, stream->ssrc);
+        g_array_append_val(keys, stream->pt);
+    }
+    g_rw_lock_reader_unlock(&self->lock);
+
+    for (i = 0; i + 1 < keys->len; i += 2) {
+        get_stream_config(self, g_array_index(keys, guint, i), g_array_index(keys, guint, i + 1),
+            &config);
+        gst_scream_controller_update_stream(self->scream_controller, g_array_index(keys, guint, i),
+            config.priority, config.min_bitrate, config.max_bitrate);
+    }
+    g_array_free(keys, TRUE);
+}
+
+static void gst_scream_queue_set_ssrc_config(GstScreamQueue *self, guint ssrc,
+    guint min_bitrate, guint max_bitrate, gfloat priority)
+{
+    GST_DEBUG_OBJECT(self, "ssrc %u: min = %u, max = %u, priority = %f", ssrc, min_bitrate,
+        max_bitrate, priority);
+    if (store_stream_config(self, self->ssrc_configs, ssrc, min_bitrate, max_bitrate, priority)) {
+        update_stream_configs(self);
+    }
+}
+
+static void gst_scream_queue_set_payload_config(GstScreamQueue *self, guint pt,
+    guint min_bitrate, guint max_bitrate, gfloat priority)
+{
+    GST_DEBUG_OBJECT(self, "pt %u: min = %u, max = %u, priority = %f", pt, min_bitrate,
+        max_bitrate, priority);
+    if (store_stream_config(self, self->pt_configs, pt, min_bitrate, max_bitrate, priority)) {
+        update_stream_configs(self);
+    }
+}
+
+static void gst_scream_queue_set_rtx_config(GstScreamQueue *self, guint ssrc, guint rtx_ssrc,
+    guint rtx_pt)
+{
+    GstScreamRtxStream *rtx_stream;
+
+    GST_DEBUG_OBJECT(self, "ssrc %u: rtx ssrc = %u, rtx pt = %u", ssrc, rtx_ssrc, rtx_pt);
+    if (rtx_ssrc == ssrc || rtx_pt > 127) {
+        GST_WARNING_OBJECT(self, "Invalid rtx config: ssrc = %u, rtx ssrc = %u, rtx pt = %u",
+            ssrc, rtx_ssrc, rtx_pt);
+        return;
+    }
+
+    g_rw_lock_writer_lock(&self->lock);
+    rtx_stream = g_hash_table_lookup(self->rtx_ssrcs, GUINT_TO_POINTER(rtx_ssrc));
+    if (rtx_stream && rtx_stream->ssrc != ssrc) {
+        GST_WARNING_OBJECT(self, "rtx ssrc %u is already used for ssrc %u", rtx_ssrc,
+            rtx_stream->ssrc);
+        goto end;
+    }
+
+    rtx_stream = g_hash_table_lookup(self->rtx_streams, GUINT_TO_POINTER(ssrc));
+    if (rtx_stream && rtx_stream->rtx_ssrc != rtx_ssrc) {
+        g_hash_table_remove(self->rtx_ssrcs, GUINT_TO_POINTER(rtx_stream->rtx_ssrc));
+        g_hash_table_remove(self->rtx_streams, GUINT_TO_POINTER(ssrc));
+        rtx_stream = NULL;
+    }
+    if (!rtx_stream) {
+        rtx_stream = g_new0(GstScreamRtxStream, 1);
+        rtx_stream->ssrc = ssrc;
+        rtx_stream->rtx_ssrc = rtx_ssrc;
+        g_hash_table_insert(self->rtx_streams, GUINT_TO_POINTER(ssrc), rtx_stream);
+        g_hash_table_insert(self->rtx_ssrcs, GUINT_TO_POINTER(rtx_ssrc), rtx_stream);
+    }
+    rtx_stream->rtx_pt = rtx_pt;
+end:
+    g_rw_lock_writer_unlock(&self->lock);
+}
@@ -42,12 +42,21 @@ typedef struct _GstScreamQueue GstScreamQueue;
 typedef struct _GstScreamQueueClass GstScreamQueueClass;
 typedef struct _GstScreamQueuePrivate GstScreamQueuePrivate;
 
+typedef enum {
+    GST_SCREAM_QUEUE_PACING_MODE_TIMEOUT,
+    GST_SCREAM_QUEUE_PACING_MODE_CLOCK
+} GstScreamQueuePacingMode;
+
+#define GST_SCREAM_QUEUE_PACING_HIST_SIZE 8
+
 struct _GstScreamQueue {
     GstElement element;
 
     GstPad *sink_pad;
     GstPad *src_pad;
+    guint next_pad_id;
     gboolean pass_through;
+    gboolean probing;
 
     guint scream_controller_id;
     GstScreamController *scream_controller;
@@ -55,13 +64,45 @@ struct _GstScreamQueue {
 
     GRWLock lock;
     GHashTable *streams;
-    GHashTable *adapted_stream_ids;
     GHashTable *ignored_stream_ids;
 
+    /* Bitrate bounds and priority per ssrc and per payload type,
+     * protected by the object lock */
+    GHashTable *ssrc_configs;
+    GHashTable *pt_configs;
+
+    /* RTX streams that probes are sent on, by media ssrc and by rtx ssrc,
+     * protected by lock. The sequence state is only used by the src task. */
+    GHashTable *rtx_streams;
+    GHashTable *rtx_ssrcs;
+
     /*GstDataQueue *incoming_packets;*/
     GAsyncQueue *incoming_packets;
     GstDataQueue *approved_packets;
     guint64 next_approve_time;
+
+    GstClock *clock;
+    GstScreamQueuePacingMode pacing_mode;
+    guint pacing_resolution;
+
+    /* One-byte header extension ids stamped at departure, 0 when disabled */
+    guint abs_send_time_id;
+    guint transport_cc_id;
+
+    /* pacing_cond wakes the source pad task when it waits without a clock */
+    GMutex pacing_lock;
+    GCond pacing_cond;
+    GstClockID pacing_clock_id;
+    gboolean pacing_flushing;
+    guint64 pacing_wakeups;
+    guint64 pacing_error_max;
+    guint64 pacing_error_hist[GST_SCREAM_QUEUE_PACING_HIST_SIZE];
+
+    guint frame_latency;
+    gfloat keyframe_burst;
+    guint64 frames_sent;
+    guint64 frame_latency_sum;
+    guint64 frame_latency_max;
 };
 
 struct _GstScreamQueueClass {
@@ -71,6 +112,12 @@ struct _GstScreamQueueClass {
     gboolean (*gst_scream_queue_on_adaptation_request)(GstElement *element, guint pt);
     void (*gst_scream_queue_incoming_feedback)(GstScreamQueue *self, guint ssrc, guint timestamp,
         guint highestSeqNr, guint n_loss, guint n_ecn, gboolean qBit);
+    void (*gst_scream_queue_set_ssrc_config)(GstScreamQueue *self, guint ssrc,
+        guint min_bitrate, guint max_bitrate, gfloat priority);
+    void (*gst_scream_queue_set_payload_config)(GstScreamQueue *self, guint pt,
+        guint min_bitrate, guint max_bitrate, gfloat priority);
+    void (*gst_scream_queue_set_rtx_config)(GstScreamQueue *self, guint ssrc, guint rtx_ssrc,
+        guint rtx_pt);
 };
 
 GType gst_scream_queue_get_type(void);
@@ -0,0 +1,213 @@
+/*
+* Copyright (c) 2015, Ericsson AB. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice, this
+* list of conditions and the following disclaimer in the documentation and/or other
+* materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+* OF SUCH DAMAGE.
+*/
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstscreamrtpext.h"
+
+#include <string.h>
+
+#define RTP_HEADER_LEN 12
+#define ONE_BYTE_PROFILE 0xBEDE
+#define ONE_BYTE_MAX_ID 14
+#define ONE_BYTE_MAX_SIZE 16
+#define ABS_SEND_TIME_PERIOD_US (64 * G_USEC_PER_SEC)
+
+/* Locates the header extension, FALSE unless the whole header is in the given memory */
+static gboolean parse_header(const guint8 *data, gsize size, guint *ext_offset, guint *ext_len)
+{
+    if (size < RTP_HEADER_LEN || (data[0] >> 6) != 2)
+        return FALSE;
+
+    *ext_offset = RTP_HEADER_LEN + (data[0] & 0x0f) * 4;
+    *ext_len = 0;
+    if (!(data[0] & 0x10))
+        return size >= *ext_offset;
+
+    if (size < *ext_offset + 4)
+        return FALSE;
+    *ext_len = 4 + GST_READ_UINT16_BE(data + *ext_offset + 2) * 4;
+    return size >= *ext_offset + *ext_len;
+}
+
+static gboolean is_written(guint id, const GstScreamRtpExtension *extensions, guint n_extensions)
+{
+    guint i;
+
+    for (i = 0; i < n_extensions; i++) {
+        if (extensions[i].id == id)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/*
+ * Walks the elements of a one-byte extension block. Returns the offset of the data
+ * of element id, or -1. When out is set, the elements that are not about to be
+ * written are copied to it and n_copied is set to the number of bytes copied.
+ */
+static gint walk_elements(const guint8 *elements, guint len, guint id, guint *size,
+    const GstScreamRtpExtension *extensions, guint n_extensions, guint8 *out, guint *n_copied)
+{
+    guint i = 0, element_id, element_size;
+    gint found = -1;
+
+    if (n_copied)
+        *n_copied = 0;
+
+    while (i < len) {
+        if (!elements[i]) {
+            i++; /* Padding */
+            continue;
+        }
+        element_id = elements[i] >> 4;
+        element_size = (elements[i] & 0x0f) + 1;
+        if (element_id == 15 || i + 1 + element_size > len)
+            break;
+
+        if (element_id == id && found < 0) {
+            found = (gint)i + 1;
+            *size = element_size;
+        }
+        if (n_copied && !is_written(element_id, extensions, n_extensions)) {
+            if (out)
+                memcpy(out + *n_copied, elements + i, 1 + element_size);
+            *n_copied += 1 + element_size;
+        }
+        i += 1 + element_size;
+    }
+    return found;
+}
+
+gboolean gst_scream_rtp_write_extensions(GstBuffer *buffer,
+    const GstScreamRtpExtension *extensions, guint n_extensions)
+{
+    GstMapInfo map, out_map;
+    GstMemory *memory;
+    const guint8 *elements = NULL;
+    guint8 *out;
+    guint ext_offset, ext_len, elements_len = 0, new_len, copied, size = 0, i;
+    gint offset;
+    gboolean in_place = TRUE, ret = FALSE;
+
+    g_return_val_if_fail(gst_buffer_is_writable(buffer), FALSE);
+    for (i = 0; i < n_extensions; i++) {
+        g_return_val_if_fail(extensions[i].id >= 1 && extensions[i].id <= ONE_BYTE_MAX_ID, FALSE);
+        g_return_val_if_fail(extensions[i].size >= 1 && extensions[i].size <= ONE_BYTE_MAX_SIZE,
+            FALSE);
+    }
+
+    if (!gst_buffer_n_memory(buffer) || !gst_buffer_map_range(buffer, 0, 1, &map, GST_MAP_READ))
+        return FALSE;
+
+    if (!parse_header(map.data, map.size, &ext_offset, &ext_len))
+        goto end;
+    if (ext_len) {
+        if (GST_READ_UINT16_BE(map.data + ext_offset) != ONE_BYTE_PROFILE)
+            goto end;
+        elements = map.data + ext_offset + 4;
+        elements_len = ext_len - 4;
+    }
+
+    for (i = 0; i < n_extensions && in_place; i++) {
+        in_place = walk_elements(elements, elements_len, extensions[i].id, &size, NULL, 0, NULL,
+            NULL) >= 0 && size == extensions[i].size;
+    }
+
+    if (in_place) {
+        /* Elements of the same size are overwritten, the header memory keeps its layout */
+        gst_buffer_unmap(buffer, &map);
+        if (!gst_buffer_map_range(buffer, 0, 1, &map, GST_MAP_WRITE))
+            return FALSE;
+        for (i = 0; i < n_extensions; i++) {
+            offset = walk_elements(map.data + ext_offset + 4, elements_len, extensions[i].id, &size,
+                NULL, 0, NULL, NULL);
+            memcpy(map.data + ext_offset + 4 + offset, extensions[i].data, size);
+        }
+        ret = TRUE;
+        goto end;
+    }
+
+    /* Otherwise the header memory is rebuilt with the kept elements followed by the new ones */
+    walk_elements(elements, elements_len, 0, &size, extensions, n_extensions, NULL, &new_len);
+    for (i = 0; i < n_extensions; i++)
+        new_len += 1 + extensions[i].size;
+    new_len = GST_ROUND_UP_4(new_len);
+
+    memory = gst_allocator_alloc(NULL, map.size - ext_len + 4 + new_len, NULL);
+    gst_memory_map(memory, &out_map, GST_MAP_WRITE);
+    out = out_map.data;
+    memcpy(out, map.data, ext_offset);
+    out[0] |= 0x10;
+    GST_WRITE_UINT16_BE(out + ext_offset, ONE_BYTE_PROFILE);
+    GST_WRITE_UINT16_BE(out + ext_offset + 2, new_len / 4);
+
+    out += ext_offset + 4;
+    walk_elements(elements, elements_len, 0, &size, extensions, n_extensions, out, &copied);
+    out += copied;
+    for (i = 0; i < n_extensions; i++) {
+        *out++ = (guint8)((extensions[i].id << 4) | (extensions[i].size - 1));
+        memcpy(out, extensions[i].data, extensions[i].size);
+        out += extensions[i].size;
+    }
+    memset(out, 0, out_map.data + ext_offset + 4 + new_len - out);
+    memcpy(out_map.data + ext_offset + 4 + new_len, map.data + ext_offset + ext_len,
+        map.size - ext_offset - ext_len);
+    gst_memory_unmap(memory, &out_map);
+
+    gst_buffer_unmap(buffer, &map);
+    gst_buffer_replace_memory(buffer, 0, memory);
+    return TRUE;
+
+end:
+    gst_buffer_unmap(buffer, &map);
+    return ret;
+}
+
+gboolean gst_scream_rtp_set_seq_timestamp(GstBuffer *buffer, guint16 seq, guint32 timestamp)
+{
+    GstMapInfo map;
+    gboolean ret = FALSE;
+
+    g_return_val_if_fail(gst_buffer_is_writable(buffer), FALSE);
+
+    if (!gst_buffer_n_memory(buffer) || !gst_buffer_map_range(buffer, 0, 1, &map, GST_MAP_WRITE))
+        return FALSE;
+
+    if (map.size >= RTP_HEADER_LEN) {
+        GST_WRITE_UINT16_BE(map.data + 2, seq);
+        GST_WRITE_UINT32_BE(map.data + 4, timestamp);
+        ret = TRUE;
+    }
+    gst_buffer_unmap(buffer, &map);
+    return ret;
+}
+
+guint32 gst_scream_rtp_abs_send_time(guint64 time_us)
+{
+    /* The value wraps every 64 seconds, reduce first so that the shift cannot overflow */
+    return (guint32)(((time_us % ABS_SEND_TIME_PERIOD_US) << 18) / G_USEC_PER_SEC);
+}
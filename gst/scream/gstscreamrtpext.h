@@ -0,0 +1,54 @@
+/*
+* Copyright (c) 2015, Ericsson AB. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice, this
+* list of conditions and the following disclaimer in the documentation and/or other
+* materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+* OF SUCH DAMAGE.
+*/
+#ifndef gstscreamrtpext_h
+#define gstscreamrtpext_h
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct {
+    guint id;
+    const guint8 *data;
+    guint size;
+} GstScreamRtpExtension;
+
+/*
+ * Writes one-byte header extensions (RFC 8285) into the RTP header of a writable buffer.
+ * Elements with the same id are replaced. Only the memory that holds the header is
+ * made writable, so payload memories stay shared with upstream.
+ */
+gboolean gst_scream_rtp_write_extensions(GstBuffer *buffer,
+    const GstScreamRtpExtension *extensions, guint n_extensions);
+
+/* Sets the sequence number and timestamp of a writable buffer, touching only the header memory */
+gboolean gst_scream_rtp_set_seq_timestamp(GstBuffer *buffer, guint16 seq, guint32 timestamp);
+
+/* The 24 bit abs-send-time value, 6.18 fixed point seconds */
+guint32 gst_scream_rtp_abs_send_time(guint64 time_us);
+
+G_END_DECLS
+
+#endif /* gstscreamrtpext_h */
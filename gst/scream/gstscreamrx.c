@@ -0,0 +1,626 @@
+/*
+* Copyright (c) 2015, Ericsson AB. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice, this
+* list of conditions and the following disclaimer in the documentation and/or other
+* materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+* OF SUCH DAMAGE.
+*/
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstscreamrx.h"
+
+#include "gstscreamcontroller.h"
+
+#include <gst/rtp/gstrtpbuffer.h>
+#include <gst/rtp/gstrtcpbuffer.h>
+
+GST_DEBUG_CATEGORY(gst_scream_rx_debug_category);
+#define GST_CAT_DEFAULT gst_scream_rx_debug_category
+
+#define gst_scream_rx_parent_class parent_class
+G_DEFINE_TYPE(GstScreamRx, gst_scream_rx, GST_TYPE_ELEMENT);
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE("sink", GST_PAD_SINK,
+    GST_PAD_ALWAYS, GST_STATIC_CAPS("application/x-rtp"));
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE("src", GST_PAD_SRC,
+    GST_PAD_ALWAYS, GST_STATIC_CAPS("application/x-rtp"));
+
+static GstStaticPadTemplate rtcp_src_template = GST_STATIC_PAD_TEMPLATE("rtcp_src", GST_PAD_SRC,
+    GST_PAD_ALWAYS, GST_STATIC_CAPS("application/x-rtcp"));
+
+typedef struct {
+    guint32 ssrc;
+    guint32 base_seq;       /* Extended sequence number of the first packet */
+    guint32 highest_seq;    /* Highest extended sequence number */
+    guint32 n_received;
+    guint timestamp;        /* Arrival time (ms) of the highest sequence number */
+    gboolean pending;
+} GstScreamRxStream;
+
+typedef struct {
+    guint32 ssrc;
+    guint timestamp;
+    guint highest_seq;
+    guint n_loss;
+    guint n_ecn;
+    gboolean qbit;
+} GstScreamRxFeedback;
+
+enum {
+    SIGNAL_ON_FEEDBACK,
+    NUM_SIGNALS
+};
+
+static guint signals[NUM_SIGNALS];
+
+enum {
+    PROP_0,
+
+    PROP_SENDER_SSRC,
+    PROP_FEEDBACK_PACKETS,
+    PROP_MIN_FEEDBACK_INTERVAL,
+    PROP_MAX_FEEDBACK_INTERVAL,
+
+    NUM_PROPERTIES
+};
+
+static GParamSpec *properties[NUM_PROPERTIES];
+
+#define DEFAULT_FEEDBACK_PACKETS 4
+#define DEFAULT_MIN_FEEDBACK_INTERVAL 1 /* ms */
+#define DEFAULT_MAX_FEEDBACK_INTERVAL 10 /* ms */
+
+/* Words of feedback control information: seq/flags, timestamp, n_loss, n_ecn */
+#define FEEDBACK_FCI_LENGTH 4
+#define FEEDBACK_QBIT 0x0001
+#define FEEDBACK_MTU 1400
+
+
+static void gst_scream_rx_finalize(GObject *object);
+static void gst_scream_rx_set_property(GObject *object, guint prop_id, const GValue *value,
+    GParamSpec *pspec);
+static void gst_scream_rx_get_property(GObject *object, guint prop_id, GValue *value,
+    GParamSpec *pspec);
+static GstStateChangeReturn gst_scream_rx_change_state(GstElement *element,
+    GstStateChange transition);
+static GstFlowReturn gst_scream_rx_sink_chain(GstPad *pad, GstObject *parent, GstBuffer *buffer);
+static gboolean gst_scream_rx_sink_event(GstPad *pad, GstObject *parent, GstEvent *event);
+static GstIterator * gst_scream_rx_iterate_internal_links(GstPad *pad, GstObject *parent);
+
+static void gst_scream_rx_rtcp_loop(GstScreamRx *self);
+static void reset_rtcp(GstScreamRx *self);
+static void push_rtcp_eos(GstScreamRx *self);
+static void update_stream(GstScreamRx *self, guint32 ssrc, guint16 seq, guint timestamp);
+static void send_feedback(GstScreamRx *self, GArray *feedback);
+static guint get_gst_time_ms(GstScreamRx *self);
+
+static void gst_scream_rx_class_init(GstScreamRxClass *klass)
+{
+    GObjectClass *gobject_class;
+    GstElementClass *element_class;
+
+    gobject_class = (GObjectClass *) klass;
+    element_class = (GstElementClass *) klass;
+
+    GST_DEBUG_CATEGORY_INIT(gst_scream_rx_debug_category, "screamrx", 0,
+        "debug category for screamrx element");
+
+    gst_element_class_add_pad_template(element_class,
+        gst_static_pad_template_get(&src_template));
+    gst_element_class_add_pad_template(element_class,
+        gst_static_pad_template_get(&rtcp_src_template));
+    gst_element_class_add_pad_template(element_class,
+        gst_static_pad_template_get(&sink_template));
+
+    gobject_class->finalize = GST_DEBUG_FUNCPTR(gst_scream_rx_finalize);
+    gobject_class->set_property = GST_DEBUG_FUNCPTR(gst_scream_rx_set_property);
+    gobject_class->get_property = GST_DEBUG_FUNCPTR(gst_scream_rx_get_property);
+
+    element_class->change_state = GST_DEBUG_FUNCPTR(gst_scream_rx_change_state);
+
+    signals[SIGNAL_ON_FEEDBACK] = g_signal_new("on-feedback", G_TYPE_FROM_CLASS(klass),
+        G_SIGNAL_RUN_LAST,
+        G_STRUCT_OFFSET(GstScreamRxClass, gst_scream_rx_on_feedback), NULL, NULL,
+        g_cclosure_marshal_generic, G_TYPE_NONE, 6, G_TYPE_UINT, G_TYPE_UINT, G_TYPE_UINT,
+        G_TYPE_UINT, G_TYPE_UINT, G_TYPE_BOOLEAN);
+
+    properties[PROP_SENDER_SSRC] =
+        g_param_spec_uint("sender-ssrc",
+            "Sender SSRC",
+            "The SSRC used as packet sender in the feedback RTCP packets",
+            0, G_MAXUINT32, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_FEEDBACK_PACKETS] =
+        g_param_spec_uint("feedback-packets",
+            "Feedback packets",
+            "Send feedback after this many received RTP packets, once min-feedback-interval "
+            "has passed",
+            1, G_MAXUINT, DEFAULT_FEEDBACK_PACKETS,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_MIN_FEEDBACK_INTERVAL] =
+        g_param_spec_uint("min-feedback-interval",
+            "Minimum feedback interval",
+            "Minimum time (ms) between two feedback packets",
+            0, G_MAXUINT, DEFAULT_MIN_FEEDBACK_INTERVAL,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    properties[PROP_MAX_FEEDBACK_INTERVAL] =
+        g_param_spec_uint("max-feedback-interval",
+            "Maximum feedback interval",
+            "Maximum time (ms) that a received RTP packet waits to be reported",
+            1, G_MAXUINT, DEFAULT_MAX_FEEDBACK_INTERVAL,
+            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+    g_object_class_install_properties(gobject_class, NUM_PROPERTIES, properties);
+
+    gst_element_class_set_static_metadata(element_class,
+        "SCREAM Receiver",
+        "Network/Adaptation",
+        "Generates SCREAM feedback for received RTP streams",
+        "Daniel Lindström <daniel.lindstrom@ericsson.com>");
+}
+
+static void gst_scream_rx_init(GstScreamRx *self)
+{
+    self->sink_pad = gst_pad_new_from_static_template(&sink_template, "sink");
+    gst_pad_set_chain_function(self->sink_pad, GST_DEBUG_FUNCPTR(gst_scream_rx_sink_chain));
+    gst_pad_set_event_function(self->sink_pad, GST_DEBUG_FUNCPTR(gst_scream_rx_sink_event));
+    gst_pad_set_iterate_internal_links_function(self->sink_pad,
+        GST_DEBUG_FUNCPTR(gst_scream_rx_iterate_internal_links));
+    GST_PAD_SET_PROXY_CAPS(self->sink_pad);
+    gst_element_add_pad(GST_ELEMENT(self), self->sink_pad);
+
+    self->src_pad = gst_pad_new_from_static_template(&src_template, "src");
+    gst_pad_set_iterate_internal_links_function(self->src_pad,
+        GST_DEBUG_FUNCPTR(gst_scream_rx_iterate_internal_links));
+    GST_PAD_SET_PROXY_CAPS(self->src_pad);
+    gst_element_add_pad(GST_ELEMENT(self), self->src_pad);
+
+    self->rtcp_src_pad = gst_pad_new_from_static_template(&rtcp_src_template, "rtcp_src");
+    gst_pad_use_fixed_caps(self->rtcp_src_pad);
+    gst_element_add_pad(GST_ELEMENT(self), self->rtcp_src_pad);
+
+    self->sender_ssrc = g_random_int();
+    self->feedback_packets = DEFAULT_FEEDBACK_PACKETS;
+    self->min_feedback_interval = DEFAULT_MIN_FEEDBACK_INTERVAL;
+    self->max_feedback_interval = DEFAULT_MAX_FEEDBACK_INTERVAL;
+
+    g_mutex_init(&self->lock);
+    g_cond_init(&self->cond);
+    self->active = FALSE;
+    self->flushing = TRUE;
+    self->eos = FALSE;
+    self->need_stream_start = TRUE;
+    self->streams = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+    self->packets_since_feedback = 0;
+    self->last_feedback_time = 0;
+}
+
+static void gst_scream_rx_finalize(GObject *object)
+{
+    GstScreamRx *self = GST_SCREAM_RX(object);
+
+    g_hash_table_unref(self->streams);
+    g_cond_clear(&self->cond);
+    g_mutex_clear(&self->lock);
+
+    G_OBJECT_CLASS(parent_class)->finalize(object);
+}
+
+static void gst_scream_rx_set_property(GObject *object, guint prop_id, const GValue *value,
+    GParamSpec *pspec)
+{
+    GstScreamRx *self = GST_SCREAM_RX(object);
+
+    switch (prop_id) {
+    case PROP_SENDER_SSRC:
+        self->sender_ssrc = g_value_get_uint(value);
+        break;
+    case PROP_FEEDBACK_PACKETS:
+        self->feedback_packets = g_value_get_uint(value);
+        break;
+    case PROP_MIN_FEEDBACK_INTERVAL:
+        self->min_feedback_interval = g_value_get_uint(value);
+        break;
+    case PROP_MAX_FEEDBACK_INTERVAL:
+        self->max_feedback_interval = g_value_get_uint(value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(self, prop_id, pspec);
+        break;
+    }
+}
+
+static void gst_scream_rx_get_property(GObject *object, guint prop_id, GValue *value,
+    GParamSpec *pspec)
+{
+    GstScreamRx *self = GST_SCREAM_RX(object);
+
+    switch (prop_id) {
+    case PROP_SENDER_SSRC:
+        g_value_set_uint(value, self->sender_ssrc);
+        break;
+    case PROP_FEEDBACK_PACKETS:
+        g_value_set_uint(value, self->feedback_packets);
+        break;
+    case PROP_MIN_FEEDBACK_INTERVAL:
+        g_value_set_uint(value, self->min_feedback_interval);
+        break;
+    case PROP_MAX_FEEDBACK_INTERVAL:
+        g_value_set_uint(value, self->max_feedback_interval);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(self, prop_id, pspec);
+        break;
+    }
+}
+
+static GstStateChangeReturn gst_scream_rx_change_state(GstElement *element,
+    GstStateChange transition)
+{
+    GstScreamRx *self = GST_SCREAM_RX(element);
+    GstStateChangeReturn ret;
+
+    switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+        g_mutex_lock(&self->lock);
+        self->active = TRUE;
+        g_mutex_unlock(&self->lock);
+        reset_rtcp(self);
+        break;
+
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+        g_mutex_lock(&self->lock);
+        self->active = FALSE;
+        self->flushing = TRUE;
+        g_cond_signal(&self->cond);
+        g_mutex_unlock(&self->lock);
+        break;
+
+    default:
+        break;
+    }
+
+    ret = GST_ELEMENT_CLASS(parent_class)->change_state(element, transition);
+
+    switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+        gst_pad_stop_task(self->rtcp_src_pad);
+        g_mutex_lock(&self->lock);
+        g_hash_table_remove_all(self->streams);
+        g_mutex_unlock(&self->lock);
+        break;
+
+    default:
+        break;
+    }
+
+    return ret;
+}
+
+static GstFlowReturn gst_scream_rx_sink_chain(GstPad *pad, GstObject *parent, GstBuffer *buffer)
+{
+    GstScreamRx *self = GST_SCREAM_RX(parent);
+    GstRTPBuffer rtp_buffer = GST_RTP_BUFFER_INIT;
+    guint32 ssrc;
+    guint16 seq;
+
+    SCREAM_UNUSED(pad);
+
+    if (gst_rtp_buffer_map(buffer, GST_MAP_READ, &rtp_buffer)) {
+        ssrc = gst_rtp_buffer_get_ssrc(&rtp_buffer);
+        seq = gst_rtp_buffer_get_seq(&rtp_buffer);
+        gst_rtp_buffer_unmap(&rtp_buffer);
+
+        update_stream(self, ssrc, seq, get_gst_time_ms(self));
+    } else {
+        GST_WARNING_OBJECT(self, "Received an invalid RTP packet");
+    }
+
+    return gst_pad_push(self->src_pad, buffer);
+}
+
+/*
+ * The feedback pad has a stream of its own, but it ends and flushes together with
+ * the incoming stream. EOS is pushed from the rtcp task after the last feedback.
+ */
+static gboolean gst_scream_rx_sink_event(GstPad *pad, GstObject *parent, GstEvent *event)
+{
+    GstScreamRx *self = GST_SCREAM_RX(parent);
+    gboolean reset_time;
+
+    SCREAM_UNUSED(pad);
+
+    switch (GST_EVENT_TYPE(event)) {
+    case GST_EVENT_EOS:
+        g_mutex_lock(&self->lock);
+        self->eos = TRUE;
+        g_cond_signal(&self->cond);
+        g_mutex_unlock(&self->lock);
+        break;
+
+    case GST_EVENT_FLUSH_START:
+        g_mutex_lock(&self->lock);
+        self->flushing = TRUE;
+        g_cond_signal(&self->cond);
+        g_mutex_unlock(&self->lock);
+        gst_pad_push_event(self->rtcp_src_pad, gst_event_new_flush_start());
+        gst_pad_pause_task(self->rtcp_src_pad);
+        break;
+
+    case GST_EVENT_FLUSH_STOP:
+        gst_event_parse_flush_stop(event, &reset_time);
+        gst_pad_push_event(self->rtcp_src_pad, gst_event_new_flush_stop(reset_time));
+        reset_rtcp(self);
+        break;
+
+    default:
+        break;
+    }
+
+    return gst_pad_push_event(self->src_pad, event);
+}
+
+static GstIterator * gst_scream_rx_iterate_internal_links(GstPad *pad, GstObject *parent)
+{
+    GstScreamRx *self = GST_SCREAM_RX(parent);
+    GstIterator *it;
+    GValue val = G_VALUE_INIT;
+
+    g_value_init(&val, GST_TYPE_PAD);
+    g_value_set_object(&val, pad == self->sink_pad ? self->src_pad : self->sink_pad);
+    it = gst_iterator_new_single(GST_TYPE_PAD, &val);
+    g_value_unset(&val);
+
+    return it;
+}
+
+static void update_stream(GstScreamRx *self, guint32 ssrc, guint16 seq, guint timestamp)
+{
+    GstScreamRxStream *stream;
+    gint16 delta;
+
+    g_mutex_lock(&self->lock);
+    stream = g_hash_table_lookup(self->streams, GUINT_TO_POINTER(ssrc));
+    if (!stream) {
+        stream = g_new0(GstScreamRxStream, 1);
+        stream->ssrc = ssrc;
+        stream->base_seq = seq;
+        stream->highest_seq = seq;
+        stream->timestamp = timestamp;
+        g_hash_table_insert(self->streams, GUINT_TO_POINTER(ssrc), stream);
+    } else {
+        delta = (gint16)(seq - (guint16)stream->highest_seq);
+        if (delta > 0) {
+            stream->highest_seq += delta;
+            stream->timestamp = timestamp;
+        }
+    }
+    stream->n_received++;
+    stream->pending = TRUE;
+
+    self->packets_since_feedback++;
+    if (self->packets_since_feedback == 1 ||
+        self->packets_since_feedback == self->feedback_packets) {
+        g_cond_signal(&self->cond);
+    }
+    g_mutex_unlock(&self->lock);
+}
+
+/*
+ * Feedback goes out once feedback-packets have arrived, but never faster than
+ * min-feedback-interval. At low packet rates max-feedback-interval takes over,
+ * so the interval follows the rate of the incoming streams.
+ */
+static void gst_scream_rx_rtcp_loop(GstScreamRx *self)
+{
+    GstScreamRxStream *stream;
+    GstScreamRxFeedback feedback;
+    GHashTableIter iter;
+    GArray *feedbacks;
+    gint64 now = 0, deadline;
+    guint32 expected;
+    gboolean eos;
+
+    g_mutex_lock(&self->lock);
+    while (!self->flushing && !self->eos) {
+        if (!self->packets_since_feedback) {
+            g_cond_wait(&self->cond, &self->lock);
+            continue;
+        }
+
+        if (self->packets_since_feedback >= self->feedback_packets) {
+            deadline = self->last_feedback_time + self->min_feedback_interval * G_TIME_SPAN_MILLISECOND;
+        } else {
+            deadline = self->last_feedback_time + self->max_feedback_interval * G_TIME_SPAN_MILLISECOND;
+        }
+        now = g_get_monotonic_time();
+        if (now >= deadline) {
+            break;
+        }
+        g_cond_wait_until(&self->cond, &self->lock, deadline);
+    }
+
+    if (self->flushing) {
+        g_mutex_unlock(&self->lock);
+        gst_pad_pause_task(self->rtcp_src_pad);
+        goto end;
+    }
+    eos = self->eos;
+    if (eos) {
+        now = g_get_monotonic_time();
+    }
+
+    feedbacks = g_array_new(FALSE, FALSE, sizeof(GstScreamRxFeedback));
+    g_hash_table_iter_init(&iter, self->streams);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&stream)) {
+        if (!stream->pending) {
+            continue;
+        }
+        expected = stream->highest_seq - stream->base_seq + 1;
+        feedback.ssrc = stream->ssrc;
+        feedback.timestamp = stream->timestamp;
+        feedback.highest_seq = stream->highest_seq & 0xffff;
+        feedback.n_loss = expected > stream->n_received ? expected - stream->n_received : 0;
+        /* ECN marks are not visible in the buffers we get */
+        feedback.n_ecn = 0;
+        feedback.qbit = FALSE;
+        g_array_append_val(feedbacks, feedback);
+        stream->pending = FALSE;
+    }
+    self->packets_since_feedback = 0;
+    self->last_feedback_time = now;
+    g_mutex_unlock(&self->lock);
+
+    send_feedback(self, feedbacks);
+    g_array_free(feedbacks, TRUE);
+
+    if (eos) {
+        push_rtcp_eos(self);
+    }
+
+end:
+    return;
+}
+
+/* Starts feedback on a new stream, after going to PAUSED and after a flush */
+static void reset_rtcp(GstScreamRx *self)
+{
+    g_mutex_lock(&self->lock);
+    if (!self->active) {
+        g_mutex_unlock(&self->lock);
+        return;
+    }
+    self->flushing = FALSE;
+    self->eos = FALSE;
+    self->need_stream_start = TRUE;
+    self->packets_since_feedback = 0;
+    self->last_feedback_time = g_get_monotonic_time();
+    g_mutex_unlock(&self->lock);
+
+    gst_pad_start_task(self->rtcp_src_pad, (GstTaskFunction)gst_scream_rx_rtcp_loop,
+        self, NULL);
+}
+
+static void push_stream_start(GstScreamRx *self)
+{
+    GstSegment segment;
+    GstCaps *caps;
+    gchar *stream_id;
+
+    stream_id = gst_pad_create_stream_id(self->rtcp_src_pad, GST_ELEMENT(self), "rtcp");
+    gst_pad_push_event(self->rtcp_src_pad, gst_event_new_stream_start(stream_id));
+    g_free(stream_id);
+
+    caps = gst_static_pad_template_get_caps(&rtcp_src_template);
+    gst_pad_push_event(self->rtcp_src_pad, gst_event_new_caps(caps));
+    gst_caps_unref(caps);
+
+    gst_segment_init(&segment, GST_FORMAT_TIME);
+    gst_pad_push_event(self->rtcp_src_pad, gst_event_new_segment(&segment));
+}
+
+static void push_rtcp_eos(GstScreamRx *self)
+{
+    if (self->need_stream_start) {
+        push_stream_start(self);
+        self->need_stream_start = FALSE;
+    }
+    gst_pad_push_event(self->rtcp_src_pad, gst_event_new_eos());
+    gst_pad_pause_task(self->rtcp_src_pad);
+}
+
+static void send_feedback(GstScreamRx *self, GArray *feedbacks)
+{
+    GstRTCPBuffer rtcp_buffer = GST_RTCP_BUFFER_INIT;
+    GstRTCPPacket packet;
+    GstScreamRxFeedback *feedback;
+    GstBuffer *buffer;
+    GstFlowReturn flow_ret;
+    guint8 *fci;
+    guint i;
+
+    if (!feedbacks->len) {
+        return;
+    }
+
+    if (self->need_stream_start) {
+        push_stream_start(self);
+        self->need_stream_start = FALSE;
+    }
+
+    buffer = gst_rtcp_buffer_new(FEEDBACK_MTU);
+    gst_rtcp_buffer_map(buffer, GST_MAP_READWRITE, &rtcp_buffer);
+    for (i = 0; i < feedbacks->len; i++) {
+        feedback = &g_array_index(feedbacks, GstScreamRxFeedback, i);
+
+        if (!gst_rtcp_buffer_add_packet(&rtcp_buffer, GST_RTCP_TYPE_RTPFB, &packet)) {
+            GST_WARNING_OBJECT(self, "Feedback for %u streams does not fit in one packet",
+                feedbacks->len);
+            break;
+        }
+        if (!gst_rtcp_packet_fb_set_fci_length(&packet, FEEDBACK_FCI_LENGTH)) {
+            gst_rtcp_packet_remove(&packet);
+            GST_WARNING_OBJECT(self, "Feedback for %u streams does not fit in one packet",
+                feedbacks->len);
+            break;
+        }
+        gst_rtcp_packet_fb_set_type(&packet, GST_SCREAM_RX_RTPFB_TYPE);
+        gst_rtcp_packet_fb_set_sender_ssrc(&packet, self->sender_ssrc);
+        gst_rtcp_packet_fb_set_media_ssrc(&packet, feedback->ssrc);
+        fci = gst_rtcp_packet_fb_get_fci(&packet);
+        GST_WRITE_UINT16_BE(fci, feedback->highest_seq);
+        GST_WRITE_UINT16_BE(fci + 2, feedback->qbit ? FEEDBACK_QBIT : 0);
+        GST_WRITE_UINT32_BE(fci + 4, feedback->timestamp);
+        GST_WRITE_UINT32_BE(fci + 8, feedback->n_loss);
+        GST_WRITE_UINT32_BE(fci + 12, feedback->n_ecn);
+
+        GST_LOG_OBJECT(self, "feedback: ssrc = %u, seq = %u, ts = %u, loss = %u", feedback->ssrc,
+            feedback->highest_seq, feedback->timestamp, feedback->n_loss);
+        g_signal_emit(self, signals[SIGNAL_ON_FEEDBACK], 0, feedback->ssrc, feedback->timestamp,
+            feedback->highest_seq, feedback->n_loss, feedback->n_ecn, feedback->qbit);
+    }
+    gst_rtcp_buffer_unmap(&rtcp_buffer);
+
+    flow_ret = gst_pad_push(self->rtcp_src_pad, buffer);
+    if (flow_ret == GST_FLOW_FLUSHING) {
+        gst_pad_pause_task(self->rtcp_src_pad);
+    } else if (flow_ret != GST_FLOW_OK && flow_ret != GST_FLOW_NOT_LINKED) {
+        GST_WARNING_OBJECT(self, "Failed to push feedback: %s", gst_flow_get_name(flow_ret));
+    }
+}
+
+static guint get_gst_time_ms(GstScreamRx *self)
+{
+    GstClockTime time = 0;
+    GstClock *clock;
+
+    GST_OBJECT_LOCK(self);
+    clock = GST_ELEMENT_CLOCK(self);
+    if (G_LIKELY(clock)) {
+        time = gst_clock_get_time(clock);
+    }
+    GST_OBJECT_UNLOCK(self);
+    return (guint)(time / GST_MSECOND);
+}
@@ -0,0 +1,78 @@
+/*
+* Copyright (c) 2015, Ericsson AB. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice, this
+* list of conditions and the following disclaimer in the documentation and/or other
+* materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+* OF SUCH DAMAGE.
+*/
+#ifndef gstscreamrx_h
+#define gstscreamrx_h
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_SCREAM_RX (gst_scream_rx_get_type())
+#define GST_SCREAM_RX(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_SCREAM_RX, GstScreamRx))
+#define GST_SCREAM_RX_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_SCREAM_RX, GstScreamRxClass))
+#define GST_IS_SCREAM_RX(obj) (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_SCREAM_RX))
+#define GST_IS_SCREAM_RX_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_SCREAM_RX))
+
+/* RTPFB feedback message type carrying SCReAM feedback */
+#define GST_SCREAM_RX_RTPFB_TYPE 18
+
+typedef struct _GstScreamRx GstScreamRx;
+typedef struct _GstScreamRxClass GstScreamRxClass;
+
+struct _GstScreamRx {
+    GstElement element;
+
+    GstPad *sink_pad;
+    GstPad *src_pad;
+    GstPad *rtcp_src_pad;
+
+    guint32 sender_ssrc;
+    guint feedback_packets;
+    guint min_feedback_interval;
+    guint max_feedback_interval;
+
+    GMutex lock;
+    GCond cond;
+    gboolean active;    /* Between READY_TO_PAUSED and PAUSED_TO_READY */
+    gboolean flushing;
+    gboolean eos;
+    gboolean need_stream_start;
+    GHashTable *streams;
+    guint packets_since_feedback;
+    gint64 last_feedback_time;
+};
+
+struct _GstScreamRxClass {
+    GstElementClass parent_class;
+
+    void (*gst_scream_rx_on_feedback)(GstScreamRx *self, guint ssrc, guint timestamp,
+        guint highest_seq, guint n_loss, guint n_ecn, gboolean qbit);
+};
+
+GType gst_scream_rx_get_type(void);
+
+G_END_DECLS
+
+#endif /* gstscreamrx_h */
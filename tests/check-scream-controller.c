@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2015, Ericsson AB. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstscreamcontroller.h"
+
+#include <gst/gst.h>
+
+/* The controller logs to the queue's category */
+GST_DEBUG_CATEGORY(gst_scream_queue_debug_category);
+
+#define TIME_US (10 * G_USEC_PER_SEC)
+#define STREAM_A 1
+#define STREAM_B 2
+
+/* Stands in for a queue that always has another packet of the same size waiting */
+typedef struct {
+    GstScreamController *controller;
+    guint sizes[3];
+    GArray *approved;
+} Queue;
+
+static void on_bitrate(guint bitrate, guint stream_id, gpointer user_data)
+{
+    (void)bitrate;
+    (void)stream_id;
+    (void)user_data;
+}
+
+static void on_approve_transmit(guint stream_id, Queue *queue)
+{
+    g_array_append_val(queue->approved, stream_id);
+    gst_scream_controller_set_next_packet_size(queue->controller, stream_id,
+        queue->sizes[stream_id]);
+}
+
+static void on_clear_queue(guint stream_id, gpointer user_data)
+{
+    (void)stream_id;
+    (void)user_data;
+}
+
+static gboolean on_send_probe(guint stream_id, guint size, gpointer user_data)
+{
+    (void)stream_id;
+    (void)size;
+    (void)user_data;
+    return FALSE;
+}
+
+static void setup_queue(Queue *queue, guint32 controller_id)
+{
+    queue->controller = gst_scream_controller_get(controller_id);
+    queue->approved = g_array_new(FALSE, FALSE, sizeof(guint));
+}
+
+static void add_stream(Queue *queue, guint stream_id, gfloat priority, guint size)
+{
+    g_assert_true(gst_scream_controller_register_new_stream(queue->controller, stream_id,
+        priority, 64000, 1000000, on_bitrate, (GstScreamQueueApproveTransmitCb)on_approve_transmit,
+        on_clear_queue, on_send_probe, queue));
+    queue->sizes[stream_id] = size;
+    gst_scream_controller_set_next_packet_size(queue->controller, stream_id, size);
+}
+
+/* No packet is reported as transmitted, so neither pacing nor the congestion window
+ * hold back approvals and only the schedule decides */
+static void approve(Queue *queue, guint n)
+{
+    guint i;
+
+    for (i = 0; i < n; i++)
+        gst_scream_controller_approve_transmits(queue->controller, TIME_US);
+}
+
+static guint count_approved(Queue *queue, guint from, guint stream_id)
+{
+    guint i, n = 0;
+
+    for (i = from; i < queue->approved->len; i++)
+        n += g_array_index(queue->approved, guint, i) == stream_id;
+    return n;
+}
+
+static void teardown_queue(Queue *queue)
+{
+    g_array_free(queue->approved, TRUE);
+    g_object_unref(queue->controller);
+}
+
+static void test_priority_share(void)
+{
+    Queue queue;
+
+    setup_queue(&queue, 1);
+    add_stream(&queue, STREAM_A, 1.0f, 1000);
+    add_stream(&queue, STREAM_B, 0.25f, 1000);
+
+    approve(&queue, 100);
+    g_assert_cmpuint(queue.approved->len, ==, 100);
+    g_assert_cmpuint(count_approved(&queue, 0, STREAM_A), >=, 79);
+    g_assert_cmpuint(count_approved(&queue, 0, STREAM_A), <=, 81);
+
+    teardown_queue(&queue);
+}
+
+/* Shares are in bytes, so a stream of small packets is served more often */
+static void test_byte_share(void)
+{
+    Queue queue;
+
+    setup_queue(&queue, 2);
+    add_stream(&queue, STREAM_A, 1.0f, 1200);
+    add_stream(&queue, STREAM_B, 1.0f, 300);
+
+    approve(&queue, 100);
+    g_assert_cmpuint(count_approved(&queue, 0, STREAM_B), >=, 79);
+    g_assert_cmpuint(count_approved(&queue, 0, STREAM_B), <=, 81);
+
+    teardown_queue(&queue);
+}
+
+/* A stream that was idle must not catch up on the turns it did not use */
+static void test_idle_stream_gets_no_credit(void)
+{
+    Queue queue;
+
+    setup_queue(&queue, 3);
+    add_stream(&queue, STREAM_A, 1.0f, 1000);
+    approve(&queue, 50);
+    g_assert_cmpuint(count_approved(&queue, 0, STREAM_A), ==, 50);
+
+    add_stream(&queue, STREAM_B, 1.0f, 1000);
+    approve(&queue, 10);
+    g_assert_cmpuint(count_approved(&queue, 50, STREAM_A), >=, 4);
+    g_assert_cmpuint(count_approved(&queue, 50, STREAM_B), >=, 4);
+
+    teardown_queue(&queue);
+}
+
+/* A priority change applies to the packet that is already waiting */
+static void test_priority_change_resorts(void)
+{
+    Queue queue;
+
+    setup_queue(&queue, 4);
+    add_stream(&queue, STREAM_A, 1.0f, 1000);
+    add_stream(&queue, STREAM_B, 1.0f, 1100);
+
+    g_assert_true(gst_scream_controller_update_stream(queue.controller, STREAM_B, 2.0f, 64000,
+        1000000));
+    approve(&queue, 1);
+    g_assert_cmpuint(g_array_index(queue.approved, guint, 0), ==, STREAM_B);
+
+    teardown_queue(&queue);
+}
+
+/* A stream without a packet waiting is not scheduled */
+static void test_empty_stream_leaves_schedule(void)
+{
+    Queue queue;
+
+    setup_queue(&queue, 5);
+    add_stream(&queue, STREAM_A, 1.0f, 1000);
+    add_stream(&queue, STREAM_B, 4.0f, 1000);
+    gst_scream_controller_set_next_packet_size(queue.controller, STREAM_B, 0);
+
+    approve(&queue, 10);
+    g_assert_cmpuint(count_approved(&queue, 0, STREAM_A), ==, 10);
+
+    teardown_queue(&queue);
+}
+
+/* A released stream leaves the schedule at once, and its id can be registered again */
+static void test_unregistered_stream_leaves_schedule(void)
+{
+    Queue queue;
+
+    setup_queue(&queue, 7);
+    add_stream(&queue, STREAM_A, 1.0f, 1000);
+    add_stream(&queue, STREAM_B, 4.0f, 1000);
+    gst_scream_controller_unregister_stream(queue.controller, STREAM_B);
+
+    approve(&queue, 10);
+    g_assert_cmpuint(count_approved(&queue, 0, STREAM_A), ==, 10);
+
+    add_stream(&queue, STREAM_B, 1.0f, 1000);
+    approve(&queue, 10);
+    g_assert_cmpuint(count_approved(&queue, 10, STREAM_B), >=, 4);
+    g_assert_cmpuint(count_approved(&queue, 10, STREAM_B), <=, 6);
+
+    teardown_queue(&queue);
+}
+
+/* Queues of one session stamp from a single transport-wide sequence */
+static void test_transport_seq_shared(void)
+{
+    GstScreamController *first, *second;
+
+    first = gst_scream_controller_get(6);
+    second = gst_scream_controller_get(6);
+    g_assert_true(first == second);
+
+    g_assert_cmpuint(gst_scream_controller_next_transport_seq(first), ==, 0);
+    g_assert_cmpuint(gst_scream_controller_next_transport_seq(second), ==, 1);
+    g_assert_cmpuint(gst_scream_controller_next_transport_seq(first), ==, 2);
+
+    g_object_unref(second);
+    g_object_unref(first);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    gst_init(&argc, &argv);
+    GST_DEBUG_CATEGORY_INIT(gst_scream_queue_debug_category, "screamqueue", 0, "scream queue");
+
+    g_test_add_func("/scream/controller/priority-share", test_priority_share);
+    g_test_add_func("/scream/controller/byte-share", test_byte_share);
+    g_test_add_func("/scream/controller/idle-stream-gets-no-credit",
+        test_idle_stream_gets_no_credit);
+    g_test_add_func("/scream/controller/priority-change-resorts", test_priority_change_resorts);
+    g_test_add_func("/scream/controller/empty-stream-leaves-schedule",
+        test_empty_stream_leaves_schedule);
+    g_test_add_func("/scream/controller/unregistered-stream-leaves-schedule",
+        test_unregistered_stream_leaves_schedule);
+    g_test_add_func("/scream/controller/transport-seq-shared", test_transport_seq_shared);
+
+    return g_test_run();
+}
@@ -0,0 +1,223 @@
+/*
+* Copyright (c) 2015, Ericsson AB. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice, this
+* list of conditions and the following disclaimer in the documentation and/or other
+* materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+* INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+* PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+* OF SUCH DAMAGE.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstscreamrtpext.h"
+
+#include <string.h>
+
+static const guint8 rtp_header[] = {
+    0x80, 0x60, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x03
+};
+static const guint8 rtp_payload[] = { 0xaa, 0xbb, 0xcc, 0xdd };
+
+/* A buffer with the header and the payload in separate memories, as rtp payloaders make them */
+static GstBuffer *create_rtp_buffer(const guint8 *header, gsize header_size)
+{
+    GstBuffer *buffer = gst_buffer_new();
+
+    gst_buffer_append_memory(buffer, gst_memory_new_wrapped(0, g_memdup(header, header_size),
+        header_size, 0, header_size, NULL, NULL));
+    gst_buffer_append_memory(buffer, gst_memory_new_wrapped(GST_MEMORY_FLAG_READONLY,
+        (gpointer)rtp_payload, sizeof(rtp_payload), 0, sizeof(rtp_payload), NULL, NULL));
+    return buffer;
+}
+
+static void assert_header(GstBuffer *buffer, const guint8 *expected, gsize expected_size)
+{
+    GstMapInfo map;
+
+    g_assert_cmpuint(gst_buffer_n_memory(buffer), ==, 2);
+    g_assert_true(gst_memory_map(gst_buffer_peek_memory(buffer, 0), &map, GST_MAP_READ));
+    g_assert_cmpuint(map.size, ==, expected_size);
+    g_assert_true(!memcmp(map.data, expected, expected_size));
+    gst_memory_unmap(gst_buffer_peek_memory(buffer, 0), &map);
+}
+
+static void test_add_extensions(void)
+{
+    static const guint8 expected[] = {
+        0x90, 0x60, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x03,
+        0xbe, 0xde, 0x00, 0x02, 0x32, 0x01, 0x02, 0x03, 0x51, 0x04, 0x05, 0x00
+    };
+    static const guint8 abs_send_time[] = { 0x01, 0x02, 0x03 };
+    static const guint8 transport_seq[] = { 0x04, 0x05 };
+    GstScreamRtpExtension extensions[] = {
+        { 3, abs_send_time, sizeof(abs_send_time) },
+        { 5, transport_seq, sizeof(transport_seq) }
+    };
+    GstBuffer *buffer = create_rtp_buffer(rtp_header, sizeof(rtp_header));
+    GstMemory *payload = gst_buffer_peek_memory(buffer, 1);
+
+    g_assert_true(gst_scream_rtp_write_extensions(buffer, extensions, 2));
+    assert_header(buffer, expected, sizeof(expected));
+    /* The payload is never copied */
+    g_assert_true(gst_buffer_peek_memory(buffer, 1) == payload);
+
+    gst_buffer_unref(buffer);
+}
+
+static void test_overwrite_in_place(void)
+{
+    static const guint8 expected[] = {
+        0x90, 0x60, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x03,
+        0xbe, 0xde, 0x00, 0x02, 0x32, 0x01, 0x02, 0x03, 0x51, 0x04, 0x06, 0x00
+    };
+    static const guint8 abs_send_time[] = { 0x01, 0x02, 0x03 };
+    guint8 transport_seq[] = { 0x04, 0x05 };
+    GstScreamRtpExtension extensions[] = {
+        { 3, abs_send_time, sizeof(abs_send_time) },
+        { 5, transport_seq, sizeof(transport_seq) }
+    };
+    GstBuffer *buffer = create_rtp_buffer(rtp_header, sizeof(rtp_header));
+    GstMemory *header;
+
+    g_assert_true(gst_scream_rtp_write_extensions(buffer, extensions, 2));
+    header = gst_buffer_peek_memory(buffer, 0);
+
+    /* Stamping a retransmission again keeps the layout and the header memory */
+    transport_seq[1] = 0x06;
+    g_assert_true(gst_scream_rtp_write_extensions(buffer, &extensions[1], 1));
+    assert_header(buffer, expected, sizeof(expected));
+    g_assert_true(gst_buffer_peek_memory(buffer, 0) == header);
+
+    gst_buffer_unref(buffer);
+}
+
+static void test_resize_keeps_other_elements(void)
+{
+    static const guint8 expected[] = {
+        0x90, 0x60, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x03,
+        0xbe, 0xde, 0x00, 0x02, 0x32, 0x01, 0x02, 0x03, 0x52, 0x07, 0x08, 0x09
+    };
+    static const guint8 abs_send_time[] = { 0x01, 0x02, 0x03 };
+    static const guint8 transport_seq[] = { 0x04, 0x05 };
+    static const guint8 resized[] = { 0x07, 0x08, 0x09 };
+    GstScreamRtpExtension extensions[] = {
+        { 3, abs_send_time, sizeof(abs_send_time) },
+        { 5, transport_seq, sizeof(transport_seq) }
+    };
+    GstScreamRtpExtension resize = { 5, resized, sizeof(resized) };
+    GstBuffer *buffer = create_rtp_buffer(rtp_header, sizeof(rtp_header));
+
+    g_assert_true(gst_scream_rtp_write_extensions(buffer, extensions, 2));
+    g_assert_true(gst_scream_rtp_write_extensions(buffer, &resize, 1));
+    assert_header(buffer, expected, sizeof(expected));
+
+    gst_buffer_unref(buffer);
+}
+
+static void test_csrcs(void)
+{
+    static const guint8 header[] = {
+        0x81, 0x60, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x03,
+        0x11, 0x22, 0x33, 0x44
+    };
+    static const guint8 expected[] = {
+        0x91, 0x60, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x03,
+        0x11, 0x22, 0x33, 0x44, 0xbe, 0xde, 0x00, 0x01, 0x32, 0x01, 0x02, 0x03
+    };
+    static const guint8 abs_send_time[] = { 0x01, 0x02, 0x03 };
+    GstScreamRtpExtension extension = { 3, abs_send_time, sizeof(abs_send_time) };
+    GstBuffer *buffer = create_rtp_buffer(header, sizeof(header));
+
+    g_assert_true(gst_scream_rtp_write_extensions(buffer, &extension, 1));
+    assert_header(buffer, expected, sizeof(expected));
+
+    gst_buffer_unref(buffer);
+}
+
+static void test_unsupported_headers(void)
+{
+    static const guint8 two_byte_header[] = {
+        0x90, 0x60, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x03,
+        0x10, 0x00, 0x00, 0x01, 0x03, 0x01, 0xff, 0x00
+    };
+    static const guint8 abs_send_time[] = { 0x01, 0x02, 0x03 };
+    GstScreamRtpExtension extension = { 3, abs_send_time, sizeof(abs_send_time) };
+    GstBuffer *buffer;
+
+    /* Two-byte extension blocks are left alone */
+    buffer = create_rtp_buffer(two_byte_header, sizeof(two_byte_header));
+    g_assert_false(gst_scream_rtp_write_extensions(buffer, &extension, 1));
+    assert_header(buffer, two_byte_header, sizeof(two_byte_header));
+    gst_buffer_unref(buffer);
+
+    /* So are headers split over several memories */
+    buffer = create_rtp_buffer(rtp_header, 8);
+    g_assert_false(gst_scream_rtp_write_extensions(buffer, &extension, 1));
+    g_assert_false(gst_scream_rtp_set_seq_timestamp(buffer, 1, 1));
+    assert_header(buffer, rtp_header, 8);
+    gst_buffer_unref(buffer);
+}
+
+static void test_seq_timestamp(void)
+{
+    static const guint8 expected[] = {
+        0x80, 0x60, 0x12, 0x34, 0xde, 0xad, 0xbe, 0xef, 0x00, 0x00, 0x00, 0x03
+    };
+    GstBuffer *buffer = create_rtp_buffer(rtp_header, sizeof(rtp_header));
+    GstMemory *payload = gst_buffer_peek_memory(buffer, 1);
+
+    g_assert_true(gst_scream_rtp_set_seq_timestamp(buffer, 0x1234, 0xdeadbeef));
+    assert_header(buffer, expected, sizeof(expected));
+    g_assert_true(gst_buffer_peek_memory(buffer, 1) == payload);
+
+    gst_buffer_unref(buffer);
+}
+
+static void test_abs_send_time(void)
+{
+    g_assert_cmphex(gst_scream_rtp_abs_send_time(0), ==, 0);
+    g_assert_cmphex(gst_scream_rtp_abs_send_time(250000), ==, 0x010000);
+    g_assert_cmphex(gst_scream_rtp_abs_send_time(G_USEC_PER_SEC), ==, 0x040000);
+    g_assert_cmphex(gst_scream_rtp_abs_send_time(64 * G_USEC_PER_SEC - 1), ==, 0xffffff);
+    /* Wraps every 64 seconds */
+    g_assert_cmphex(gst_scream_rtp_abs_send_time(64 * G_USEC_PER_SEC), ==, 0);
+    g_assert_cmphex(gst_scream_rtp_abs_send_time(64500000), ==, 0x020000);
+    /* Large clock values must not overflow the fixed point conversion */
+    g_assert_cmphex(gst_scream_rtp_abs_send_time(G_GUINT64_CONSTANT(1000000000) * 64 *
+        G_USEC_PER_SEC + G_USEC_PER_SEC), ==, 0x040000);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    gst_init(&argc, &argv);
+
+    g_test_add_func("/scream/rtpext/add-extensions", test_add_extensions);
+    g_test_add_func("/scream/rtpext/overwrite-in-place", test_overwrite_in_place);
+    g_test_add_func("/scream/rtpext/resize-keeps-other-elements",
+        test_resize_keeps_other_elements);
+    g_test_add_func("/scream/rtpext/csrcs", test_csrcs);
+    g_test_add_func("/scream/rtpext/unsupported-headers", test_unsupported_headers);
+    g_test_add_func("/scream/rtpext/seq-timestamp", test_seq_timestamp);
+    g_test_add_func("/scream/rtpext/abs-send-time", test_abs_send_time);
+
+    return g_test_run();
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2015, Ericsson AB. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "sctpcrc32c.h"
+
+#include <string.h>
+
+static const GstSctpCrc32cImpl implementations[] = {
+    GST_SCTP_CRC32C_IMPL_AUTO,
+    GST_SCTP_CRC32C_IMPL_SOFTWARE,
+    GST_SCTP_CRC32C_IMPL_SSE42,
+    GST_SCTP_CRC32C_IMPL_ARMV8
+};
+
+static void check_known_answer(GstSctpCrc32cImpl impl, const guint8 *data, gsize length,
+    guint32 expected)
+{
+    guint32 crc = 0;
+
+    if (!gst_sctp_crc32c_compute(impl, data, length, &crc))
+        return;
+    g_assert_cmphex(crc, ==, expected);
+}
+
+static void test_known_answers(gconstpointer user_data)
+{
+    GstSctpCrc32cImpl impl = GPOINTER_TO_INT(user_data);
+    guint8 data[32];
+    guint32 crc;
+    guint i;
+
+    if (!gst_sctp_crc32c_compute(impl, (const guint8 *)"", 0, &crc)) {
+        g_test_skip("Implementation not available on this CPU");
+        return;
+    }
+    g_assert_cmphex(crc, ==, 0);
+
+    check_known_answer(impl, (const guint8 *)"123456789", 9, 0xe3069283);
+
+    /* RFC 3720 appendix B.4 */
+    memset(data, 0, sizeof(data));
+    check_known_answer(impl, data, sizeof(data), 0x8a9136aa);
+    memset(data, 0xff, sizeof(data));
+    check_known_answer(impl, data, sizeof(data), 0x62a8ab43);
+    for (i = 0; i < sizeof(data); i++)
+        data[i] = i;
+    check_known_answer(impl, data, sizeof(data), 0x46dd794e);
+    for (i = 0; i < sizeof(data); i++)
+        data[i] = 31 - i;
+    check_known_answer(impl, data, sizeof(data), 0x113fdb5c);
+}
+
+/* Every length around the 8 byte blocks, at every alignment, against slicing-by-8 */
+static void test_implementations_agree(gconstpointer user_data)
+{
+    GstSctpCrc32cImpl impl = GPOINTER_TO_INT(user_data);
+    guint8 buffer[300 + 8];
+    guint32 crc, expected;
+    gsize offset, length;
+    guint i;
+
+    for (i = 0; i < sizeof(buffer); i++)
+        buffer[i] = g_test_rand_int_range(0, 256);
+
+    if (!gst_sctp_crc32c_compute(impl, buffer, 0, &crc)) {
+        g_test_skip("Implementation not available on this CPU");
+        return;
+    }
+
+    for (offset = 0; offset < 8; offset++) {
+        for (length = 0; length <= 300; length++) {
+            g_assert_true(gst_sctp_crc32c_compute(GST_SCTP_CRC32C_IMPL_SOFTWARE,
+                buffer + offset, length, &expected));
+            g_assert_true(gst_sctp_crc32c_compute(impl, buffer + offset, length, &crc));
+            g_assert_cmphex(crc, ==, expected);
+        }
+    }
+}
+
+static void test_packet(void)
+{
+    guint8 packet[12 + 64], zeroed[12 + 64];
+    guint32 crc;
+    guint i;
+
+    for (i = 0; i < sizeof(packet); i++)
+        packet[i] = i * 7 + 3;
+    memcpy(zeroed, packet, sizeof(packet));
+    memset(zeroed + 8, 0, 4);
+
+    g_assert_true(gst_sctp_crc32c_compute(GST_SCTP_CRC32C_IMPL_SOFTWARE, zeroed,
+        sizeof(zeroed), &crc));
+
+    /* The checksum field is ignored and the result is in wire (little endian) order */
+    g_assert_cmphex(gst_sctp_crc32c_packet(packet, sizeof(packet)), ==, GUINT32_TO_LE(crc));
+    g_assert_cmphex(gst_sctp_crc32c_packet(zeroed, sizeof(zeroed)), ==, GUINT32_TO_LE(crc));
+}
+
+int main(int argc, char **argv)
+{
+    static const gchar *names[] = { "auto", "software", "sse42", "armv8" };
+    gchar *path;
+    guint i;
+
+    g_test_init(&argc, &argv, NULL);
+
+    for (i = 0; i < G_N_ELEMENTS(implementations); i++) {
+        path = g_strdup_printf("/sctp/crc32c/%s/known-answers", names[i]);
+        g_test_add_data_func(path, GINT_TO_POINTER(implementations[i]), test_known_answers);
+        g_free(path);
+        path = g_strdup_printf("/sctp/crc32c/%s/agrees-with-software", names[i]);
+        g_test_add_data_func(path, GINT_TO_POINTER(implementations[i]),
+            test_implementations_agree);
+        g_free(path);
+    }
+    g_test_add_func("/sctp/crc32c/packet", test_packet);
+
+    return g_test_run();
+}
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2015, Collabora Ltd.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+
+/*
+ * Prerolls more sctpdec source pads than it has worker threads. A prerolling sink blocks
+ * the push that delivered its buffer until PLAYING, so every stream needs a thread of
+ * its own until then.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+
+#define N_STREAMS 4
+#define TIMEOUT (10 * G_TIME_SPAN_SECOND)
+
+typedef struct {
+    GstElement *pipeline;
+    GMutex lock;
+    GCond cond;
+    gboolean established;
+    guint n_prerolled;
+} Test;
+
+static void on_established(GstElement *sctpenc, gboolean established, Test *test)
+{
+    (void)sctpenc;
+
+    g_mutex_lock(&test->lock);
+    test->established = established;
+    g_cond_signal(&test->cond);
+    g_mutex_unlock(&test->lock);
+}
+
+static void on_preroll_handoff(GstElement *sink, GstBuffer *buffer, GstPad *pad, Test *test)
+{
+    (void)sink;
+    (void)buffer;
+    (void)pad;
+
+    g_mutex_lock(&test->lock);
+    test->n_prerolled++;
+    g_cond_signal(&test->cond);
+    g_mutex_unlock(&test->lock);
+}
+
+static void on_pad_added(GstElement *sctpdec, GstPad *pad, Test *test)
+{
+    GstElement *sink = gst_element_factory_make("fakesink", NULL);
+    GstPad *sink_pad;
+
+    (void)sctpdec;
+
+    g_object_set(sink, "sync", TRUE, "signal-handoffs", TRUE, NULL);
+    g_signal_connect(sink, "preroll-handoff", G_CALLBACK(on_preroll_handoff), test);
+    gst_bin_add(GST_BIN(test->pipeline), sink);
+
+    sink_pad = gst_element_get_static_pad(sink, "sink");
+    g_assert_cmpint(gst_pad_link(pad, sink_pad), ==, GST_PAD_LINK_OK);
+    gst_object_unref(sink_pad);
+    gst_element_sync_state_with_parent(sink);
+}
+
+static void add_source(Test *test, GstElement *sctpenc, guint stream_id)
+{
+    GstElement *src = gst_element_factory_make("fakesrc", NULL);
+    GstPad *src_pad, *sink_pad;
+    gchar *name;
+
+    g_object_set(src, "num-buffers", 4, "sizemax", 64, NULL);
+    gst_util_set_object_arg(G_OBJECT(src), "sizetype", "fixed");
+    gst_bin_add(GST_BIN(test->pipeline), src);
+
+    name = g_strdup_printf("sink_%u", stream_id);
+    sink_pad = gst_element_get_request_pad(sctpenc, name);
+    g_free(name);
+    g_assert_true(sink_pad != NULL);
+    src_pad = gst_element_get_static_pad(src, "src");
+    g_assert_cmpint(gst_pad_link(src_pad, sink_pad), ==, GST_PAD_LINK_OK);
+    gst_object_unref(src_pad);
+    gst_object_unref(sink_pad);
+    gst_element_sync_state_with_parent(src);
+}
+
+static gboolean wait_for_established(Test *test)
+{
+    gint64 deadline = g_get_monotonic_time() + TIMEOUT;
+    gboolean established;
+
+    g_mutex_lock(&test->lock);
+    while (!test->established && g_cond_wait_until(&test->cond, &test->lock, deadline));
+    established = test->established;
+    g_mutex_unlock(&test->lock);
+    return established;
+}
+
+static guint wait_for_prerolled(Test *test, guint n_prerolled)
+{
+    gint64 deadline = g_get_monotonic_time() + TIMEOUT;
+    guint ret;
+
+    g_mutex_lock(&test->lock);
+    while (test->n_prerolled < n_prerolled
+        && g_cond_wait_until(&test->cond, &test->lock, deadline));
+    ret = test->n_prerolled;
+    g_mutex_unlock(&test->lock);
+    return ret;
+}
+
+static void test_preroll_more_streams_than_workers(void)
+{
+    Test test;
+    GstElement *sctpenc, *sctpdec;
+    GError *error = NULL;
+    guint i;
+
+    g_mutex_init(&test.lock);
+    g_cond_init(&test.cond);
+    test.established = FALSE;
+    test.n_prerolled = 0;
+
+    /* Two associations looped back to back, data flows from enc to dec */
+    test.pipeline = gst_parse_launch(
+        "sctpenc name=enc sctp-association-id=101 remote-sctp-port=5000 "
+        "! sctpdec name=dec sctp-association-id=102 local-sctp-port=5000 worker-threads=1 "
+        "sctpenc sctp-association-id=102 remote-sctp-port=5000 "
+        "! sctpdec sctp-association-id=101 local-sctp-port=5000", &error);
+    g_assert_no_error(error);
+
+    sctpenc = gst_bin_get_by_name(GST_BIN(test.pipeline), "enc");
+    sctpdec = gst_bin_get_by_name(GST_BIN(test.pipeline), "dec");
+    g_signal_connect(sctpenc, "sctp-association-established", G_CALLBACK(on_established), &test);
+    g_signal_connect(sctpdec, "pad-added", G_CALLBACK(on_pad_added), &test);
+
+    gst_element_set_state(test.pipeline, GST_STATE_PAUSED);
+    g_assert_true(wait_for_established(&test));
+
+    for (i = 0; i < N_STREAMS; i++)
+        add_source(&test, sctpenc, i);
+
+    g_assert_cmpuint(wait_for_prerolled(&test, N_STREAMS), ==, N_STREAMS);
+    g_assert_cmpint(gst_element_get_state(test.pipeline, NULL, NULL, TIMEOUT * GST_USECOND),
+        ==, GST_STATE_CHANGE_SUCCESS);
+
+    gst_element_set_state(test.pipeline, GST_STATE_NULL);
+    gst_object_unref(sctpdec);
+    gst_object_unref(sctpenc);
+    gst_object_unref(test.pipeline);
+    g_cond_clear(&test.cond);
+    g_mutex_clear(&test.lock);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    gst_init(&argc, &argv);
+
+    g_test_add_func("/sctp/dec/preroll-more-streams-than-workers",
+        test_preroll_more_streams_than_workers);
+
+    return g_test_run();
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2015, Ericsson AB. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "sctppmtuprobe.h"
+
+#include <string.h>
+
+#define HEARTBEAT_LENGTH 20
+
+static void test_build(void)
+{
+    static const guint8 expected[] = {
+        0x13, 0x88, 0x13, 0x89, 0x01, 0x02, 0x03, 0x04, 0x00, 0x00, 0x00, 0x00,
+        /* HEARTBEAT with the heartbeat info holding magic, size and sequence */
+        0x04, 0x00, 0x00, 0x14, 0x00, 0x01, 0x00, 0x10,
+        0x47, 0x53, 0x54, 0x50, 0x00, 0x00, 0x00, 0x24, 0x00, 0x00, 0x00, 0x07,
+        /* Empty PAD */
+        0x84, 0x00, 0x00, 0x04
+    };
+    guint8 packet[sizeof(expected)];
+
+    memset(packet, 0xff, sizeof(packet));
+    gst_sctp_pmtu_probe_build(packet, sizeof(packet), 5000, 5001, 0x01020304, 7);
+    g_assert_true(!memcmp(packet, expected, sizeof(expected)));
+}
+
+static void test_build_padding(void)
+{
+    guint8 packet[1200];
+    guint i;
+
+    memset(packet, 0xff, sizeof(packet));
+    gst_sctp_pmtu_probe_build(packet, sizeof(packet), 5000, 5000, 1, 1);
+
+    /* The PAD chunk fills the rest of the packet with zeroes */
+    g_assert_cmpuint(packet[32], ==, 0x84);
+    g_assert_cmpuint((packet[34] << 8) | packet[35], ==, sizeof(packet) - 32);
+    for (i = 36; i < sizeof(packet); i++)
+        g_assert_cmpuint(packet[i], ==, 0);
+}
+
+/* What the peer sends back: the heartbeat info echoed in a HEARTBEAT-ACK, here bundled after
+ * a chunk whose length is not a multiple of 4 */
+static gsize build_ack(guint8 *ack, guint size, guint32 seq)
+{
+    guint8 probe[GST_SCTP_PMTU_PROBE_MIN_SIZE];
+    guint8 *chunk = ack + 12;
+
+    gst_sctp_pmtu_probe_build(probe, sizeof(probe), 5000, 5001, 0x01020304, seq);
+    /* The size field is the one in the heartbeat info */
+    probe[24] = (guint8)(size >> 24);
+    probe[25] = (guint8)(size >> 16);
+    probe[26] = (guint8)(size >> 8);
+    probe[27] = (guint8)size;
+
+    memcpy(ack, probe, 12);
+    memset(chunk, 0, 8);
+    chunk[0] = 0x80;
+    chunk[3] = 5;
+    chunk += 8;
+    memcpy(chunk, probe + 12, HEARTBEAT_LENGTH);
+    chunk[0] = 5;
+    return 12 + 8 + HEARTBEAT_LENGTH;
+}
+
+static void test_find_ack(void)
+{
+    guint8 packet[64];
+    guint32 seq = 0;
+    gsize length = build_ack(packet, 1400, 0xdeadbeef);
+
+    g_assert_cmpuint(gst_sctp_pmtu_probe_find_ack(packet, length, &seq), ==, 1400);
+    g_assert_cmphex(seq, ==, 0xdeadbeef);
+}
+
+static void test_ignores_other_packets(void)
+{
+    guint8 probe[GST_SCTP_PMTU_PROBE_MIN_SIZE], packet[64];
+    guint32 seq = 0;
+    gsize length;
+
+    /* The probe itself is a HEARTBEAT, not an ack */
+    gst_sctp_pmtu_probe_build(probe, sizeof(probe), 5000, 5001, 1, 1);
+    g_assert_cmpuint(gst_sctp_pmtu_probe_find_ack(probe, sizeof(probe), &seq), ==, 0);
+
+    /* Ordinary heartbeats carry usrsctp's own heartbeat info */
+    length = build_ack(packet, 1400, 1);
+    packet[12 + 8 + 8] ^= 0xff;
+    g_assert_cmpuint(gst_sctp_pmtu_probe_find_ack(packet, length, &seq), ==, 0);
+
+    /* Truncated packets and chunks */
+    length = build_ack(packet, 1400, 1);
+    g_assert_cmpuint(gst_sctp_pmtu_probe_find_ack(packet, length - 1, &seq), ==, 0);
+    g_assert_cmpuint(gst_sctp_pmtu_probe_find_ack(packet, 8, &seq), ==, 0);
+
+    /* Chunk lengths below the chunk header end the walk */
+    packet[12 + 3] = 0;
+    g_assert_cmpuint(gst_sctp_pmtu_probe_find_ack(packet, length, &seq), ==, 0);
+    g_assert_cmphex(seq, ==, 0);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/sctp/pmtu-probe/build", test_build);
+    g_test_add_func("/sctp/pmtu-probe/build-padding", test_build_padding);
+    g_test_add_func("/sctp/pmtu-probe/find-ack", test_find_ack);
+    g_test_add_func("/sctp/pmtu-probe/ignores-other-packets", test_ignores_other_packets);
+
+    return g_test_run();
+}
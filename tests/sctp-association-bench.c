@@ -0,0 +1,368 @@
+/*
+ * Copyright (c) 2015, Collabora Ltd.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+
+/*
+ * Loopback benchmark for many concurrent SCTP associations. Pairs of associations
+ * in this process are connected back to back. Their packets are handed over by a
+ * few delivery threads, and sender threads push messages through every pair at
+ * once. It reports how long the pairs take to connect and the aggregate message
+ * rate, so the cost of contention between associations shows as the count grows.
+ *
+ *   sctp-association-bench --associations 1000 --messages 100 --message-size 1024
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "sctpassociation.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define BENCH_SCTP_PORT 5000
+#define BENCH_PPID 51
+#define BENCH_TIMEOUT (60 * G_TIME_SPAN_SECOND)
+
+typedef struct _BenchPair BenchPair;
+
+typedef struct {
+    GstSctpAssociation *association;
+    GstSctpAssociation *peer;
+    BenchPair *pair;
+    GAsyncQueue *delivery_queue;
+} BenchEnd;
+
+struct _BenchPair {
+    BenchEnd ends[2];
+    gint messages_received;
+};
+
+typedef struct {
+    GstSctpAssociation *destination;
+    gsize length;
+    guint8 data[];
+} BenchPacket;
+
+typedef struct {
+    guint n_pairs;
+    guint n_messages;
+    guint message_size;
+    guint n_threads;
+
+    BenchPair *pairs;
+    GAsyncQueue **delivery_queues;
+    GThread **delivery_threads;
+
+    GMutex lock;
+    GCond cond;
+    guint n_connected;
+    guint n_done;
+    guint64 send_retries;
+} Bench;
+
+typedef struct {
+    Bench *bench;
+    guint index;
+} BenchSender;
+
+static BenchPacket stop_packet;
+
+static void on_packet_out(GstSctpAssociation *association, const guint8 *data, gsize length,
+    BenchEnd *end)
+{
+    BenchPacket *packet;
+
+    (void)association;
+
+    /* usrsctp must not be re-entered from its output callback, so the packet is queued */
+    packet = g_malloc(sizeof(BenchPacket) + length);
+    packet->destination = g_object_ref(end->peer);
+    packet->length = length;
+    memcpy(packet->data, data, length);
+    g_async_queue_push(end->delivery_queue, packet);
+}
+
+static gpointer deliver_packets(GAsyncQueue *queue)
+{
+    BenchPacket *packet;
+
+    while ((packet = g_async_queue_pop(queue)) != &stop_packet) {
+        gst_sctp_association_incoming_packet(packet->destination, packet->data,
+            (guint32)packet->length);
+        g_object_unref(packet->destination);
+        g_free(packet);
+    }
+    return NULL;
+}
+
+static void on_packet_received(GstSctpAssociation *association, guint8 *data, gsize length,
+    guint16 stream_id, guint ppid, GstSctpAssociationMessageFlags flags, BenchEnd *end)
+{
+    Bench *bench = g_object_get_data(G_OBJECT(association), "bench");
+
+    (void)length;
+    (void)stream_id;
+    (void)ppid;
+    g_free(data);
+
+    if (!(flags & GST_SCTP_ASSOCIATION_MESSAGE_END))
+        return;
+
+    if (g_atomic_int_add(&end->pair->messages_received, 1) + 1 == (gint)bench->n_messages) {
+        g_mutex_lock(&bench->lock);
+        bench->n_done++;
+        g_cond_signal(&bench->cond);
+        g_mutex_unlock(&bench->lock);
+    }
+}
+
+static void on_state_changed(GstSctpAssociation *association, GParamSpec *pspec, Bench *bench)
+{
+    GstSctpAssociationState state;
+
+    (void)pspec;
+
+    g_object_get(association, "state", &state, NULL);
+    if (state == GST_SCTP_ASSOCIATION_STATE_CONNECTED) {
+        g_mutex_lock(&bench->lock);
+        bench->n_connected++;
+        g_cond_signal(&bench->cond);
+        g_mutex_unlock(&bench->lock);
+    } else if (state == GST_SCTP_ASSOCIATION_STATE_ERROR) {
+        g_printerr("Association %p failed\n", (gpointer)association);
+    }
+}
+
+static gboolean wait_for(Bench *bench, guint *counter, guint target)
+{
+    gint64 deadline = g_get_monotonic_time() + BENCH_TIMEOUT;
+    gboolean ret = TRUE;
+
+    g_mutex_lock(&bench->lock);
+    while (*counter < target && ret)
+        ret = g_cond_wait_until(&bench->cond, &bench->lock, deadline);
+    ret = *counter >= target;
+    g_mutex_unlock(&bench->lock);
+    return ret;
+}
+
+static void send_message(Bench *bench, GstSctpAssociation *association, const guint8 *message)
+{
+    GstSctpAssociationSendResult result;
+    guint32 offset = 0, bytes_sent;
+    guint64 retries = 0;
+
+    while (offset < bench->message_size) {
+        bytes_sent = 0;
+        result = gst_sctp_association_send_data(association, message + offset,
+            bench->message_size - offset, 0, BENCH_PPID, TRUE,
+            GST_SCTP_ASSOCIATION_PARTIAL_RELIABILITY_NONE, 0, TRUE, &bytes_sent);
+        if (result == GST_SCTP_ASSOCIATION_SEND_ERROR) {
+            g_printerr("Failed to send on association %p\n", (gpointer)association);
+            break;
+        }
+        offset += bytes_sent;
+        if (result == GST_SCTP_ASSOCIATION_SEND_WOULD_BLOCK) {
+            /* The send buffer drains as the delivery threads run */
+            retries++;
+            g_usleep(100);
+        }
+    }
+
+    if (retries) {
+        g_mutex_lock(&bench->lock);
+        bench->send_retries += retries;
+        g_mutex_unlock(&bench->lock);
+    }
+}
+
+/* Each sender owns every n_threads'th pair and interleaves messages over them */
+static gpointer send_messages(BenchSender *sender)
+{
+    Bench *bench = sender->bench;
+    guint8 *message = g_malloc(bench->message_size);
+    guint i, j;
+
+    memset(message, 0x5a, bench->message_size);
+    for (i = 0; i < bench->n_messages; i++) {
+        for (j = sender->index; j < bench->n_pairs; j += bench->n_threads)
+            send_message(bench, bench->pairs[j].ends[0].association, message);
+    }
+    g_free(message);
+    return NULL;
+}
+
+static void setup_end(Bench *bench, BenchPair *pair, guint side, guint32 association_id)
+{
+    BenchEnd *end = &pair->ends[side];
+
+    end->association = gst_sctp_association_get(association_id);
+    end->pair = pair;
+    g_object_set_data(G_OBJECT(end->association), "bench", bench);
+    g_signal_connect(end->association, "notify::state", G_CALLBACK(on_state_changed), bench);
+    gst_sctp_association_set_on_packet_received(end->association,
+        (GstSctpAssociationPacketReceivedCb)on_packet_received, end);
+    gst_sctp_association_set_on_packet_out(end->association,
+        (GstSctpAssociationPacketOutCb)on_packet_out, end);
+}
+
+int main(int argc, char **argv)
+{
+    Bench bench;
+    BenchSender *senders;
+    GThread **sender_threads;
+    GOptionContext *context;
+    GError *error = NULL;
+    gint64 start, connected, done;
+    gdouble transfer_s;
+    guint n_associations = 1000, n_messages = 100, message_size = 1024;
+    guint n_threads = g_get_num_processors();
+    guint i, side;
+    gint ret = 0;
+    GOptionEntry entries[] = {
+        { "associations", 'a', 0, G_OPTION_ARG_INT, &n_associations,
+            "Number of associations, connected in pairs", "N" },
+        { "messages", 'm', 0, G_OPTION_ARG_INT, &n_messages,
+            "Messages sent on every pair", "N" },
+        { "message-size", 's', 0, G_OPTION_ARG_INT, &message_size,
+            "Size of every message in bytes", "BYTES" },
+        { "threads", 't', 0, G_OPTION_ARG_INT, &n_threads,
+            "Number of sender and of delivery threads", "N" },
+        { NULL, 0, 0, 0, NULL, NULL, NULL }
+    };
+
+    context = g_option_context_new("- SCTP association scaling benchmark");
+    g_option_context_add_main_entries(context, entries, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        g_clear_error(&error);
+        g_option_context_free(context);
+        return 1;
+    }
+    g_option_context_free(context);
+
+    /* Association ids are 16 bit */
+    if (n_associations < 2 || n_associations > G_MAXUINT16 || !n_messages || !message_size ||
+        !n_threads) {
+        g_printerr("Invalid arguments\n");
+        return 1;
+    }
+
+    memset(&bench, 0, sizeof(bench));
+    bench.n_pairs = n_associations / 2;
+    bench.n_messages = n_messages;
+    bench.message_size = message_size;
+    bench.n_threads = MIN(n_threads, bench.n_pairs);
+    g_mutex_init(&bench.lock);
+    g_cond_init(&bench.cond);
+
+    bench.delivery_queues = g_new0(GAsyncQueue *, bench.n_threads);
+    bench.delivery_threads = g_new0(GThread *, bench.n_threads);
+    for (i = 0; i < bench.n_threads; i++) {
+        bench.delivery_queues[i] = g_async_queue_new();
+        bench.delivery_threads[i] = g_thread_new("bench-delivery",
+            (GThreadFunc)deliver_packets, bench.delivery_queues[i]);
+    }
+
+    bench.pairs = g_new0(BenchPair, bench.n_pairs);
+    for (i = 0; i < bench.n_pairs; i++) {
+        for (side = 0; side < 2; side++) {
+            bench.pairs[i].ends[side].delivery_queue =
+                bench.delivery_queues[i % bench.n_threads];
+            setup_end(&bench, &bench.pairs[i], side, 2 * i + side + 1);
+        }
+        bench.pairs[i].ends[0].peer = bench.pairs[i].ends[1].association;
+        bench.pairs[i].ends[1].peer = bench.pairs[i].ends[0].association;
+    }
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < bench.n_pairs; i++) {
+        for (side = 0; side < 2; side++) {
+            g_object_set(bench.pairs[i].ends[side].association, "local-port", BENCH_SCTP_PORT,
+                "remote-port", BENCH_SCTP_PORT, NULL);
+            gst_sctp_association_start(bench.pairs[i].ends[side].association);
+        }
+    }
+
+    if (!wait_for(&bench, &bench.n_connected, 2 * bench.n_pairs)) {
+        g_printerr("Only %u of %u associations connected\n", bench.n_connected,
+            2 * bench.n_pairs);
+        ret = 1;
+        goto cleanup;
+    }
+    connected = g_get_monotonic_time();
+
+    senders = g_new0(BenchSender, bench.n_threads);
+    sender_threads = g_new0(GThread *, bench.n_threads);
+    for (i = 0; i < bench.n_threads; i++) {
+        senders[i].bench = &bench;
+        senders[i].index = i;
+        sender_threads[i] = g_thread_new("bench-sender", (GThreadFunc)send_messages, &senders[i]);
+    }
+    for (i = 0; i < bench.n_threads; i++)
+        g_thread_join(sender_threads[i]);
+    g_free(sender_threads);
+    g_free(senders);
+
+    if (!wait_for(&bench, &bench.n_done, bench.n_pairs)) {
+        g_printerr("Only %u of %u pairs received every message\n", bench.n_done, bench.n_pairs);
+        ret = 1;
+        goto cleanup;
+    }
+    done = g_get_monotonic_time();
+
+    transfer_s = (done - connected) / (gdouble)G_USEC_PER_SEC;
+    g_print("associations: %u, threads: %u, messages: %u x %u bytes per pair\n",
+        2 * bench.n_pairs, bench.n_threads, bench.n_messages, bench.message_size);
+    g_print("connect: %.3f s\n", (connected - start) / (gdouble)G_USEC_PER_SEC);
+    g_print("transfer: %.3f s, %.0f messages/s, %.2f MB/s, %" G_GUINT64_FORMAT " send retries\n",
+        transfer_s, bench.n_pairs * (gdouble)bench.n_messages / transfer_s,
+        bench.n_pairs * (gdouble)bench.n_messages * bench.message_size / transfer_s / 1e6,
+        bench.send_retries);
+
+cleanup:
+    for (i = 0; i < bench.n_pairs; i++) {
+        for (side = 0; side < 2; side++) {
+            g_signal_handlers_disconnect_by_data(bench.pairs[i].ends[side].association, &bench);
+            gst_sctp_association_force_close(bench.pairs[i].ends[side].association);
+        }
+    }
+    for (i = 0; i < bench.n_threads; i++) {
+        g_async_queue_push(bench.delivery_queues[i], &stop_packet);
+        g_thread_join(bench.delivery_threads[i]);
+        g_async_queue_unref(bench.delivery_queues[i]);
+    }
+    for (i = 0; i < bench.n_pairs; i++) {
+        for (side = 0; side < 2; side++)
+            g_object_unref(bench.pairs[i].ends[side].association);
+    }
+    g_free(bench.pairs);
+    g_free(bench.delivery_threads);
+    g_free(bench.delivery_queues);
+    g_mutex_clear(&bench.lock);
+    g_cond_clear(&bench.cond);
+
+    return ret;
+}